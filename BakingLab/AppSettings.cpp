@@ -187,6 +187,20 @@ static const char* SolveModesLabels[5] =
     "Running Average Non-Negative",
 };
 
+static const char* CoarseBakeModesLabels[3] =
+{
+    "Disabled",
+    "Half Resolution",
+    "Quarter Resolution",
+};
+
+static const char* DistributedBakeModesLabels[3] =
+{
+    "Disabled",
+    "Coordinator",
+    "Worker",
+};
+
 static const char* ScenesLabels[3] =
 {
     "Box",
@@ -269,6 +283,27 @@ namespace AppSettings
     BakeModesSetting BakeMode;
     SolveModesSetting SolveMode;
     BoolSetting WorldSpaceBake;
+    BoolSetting StreamingSGSolve;
+    BoolSetting CompositeBake;
+    BoolSetting DenoiseLightMap;
+    IntSetting DenoiserIterations;
+    FloatSetting DenoiserPositionSigma;
+    FloatSetting DenoiserNormalPower;
+    Button RunDenoiser;
+    BoolSetting EnableRadianceCache;
+    FloatSetting RadianceCacheTolerance;
+    FloatSetting RadianceCacheCellSize;
+    IntSetting LightMapFeedbackBounces;
+    IntSetting LightMapFeedbackSamples;
+    BoolSetting EnableBakeCheckpoints;
+    IntSetting BakeCheckpointInterval;
+    BoolSetting EnableBakeResultCache;
+    IntSetting BakeResultCacheSize;
+    BoolSetting PrioritizeVisibleTexels;
+    CoarseBakeModesSetting CoarseBakeMode;
+    BoolSetting OutOfCoreBake;
+    DistributedBakeModesSetting DistributedBakeMode;
+    IntSetting DistributedBakePort;
     ScenesSetting CurrentScene;
     BoolSetting EnableDiffuse;
     BoolSetting EnableSpecular;
@@ -300,6 +335,7 @@ namespace AppSettings
     Button SaveLightSettings;
     Button LoadLightSettings;
     Button SaveEXRScreenshot;
+    Button ExportLightMap;
     BoolSetting ShowSunIntensity;
 
     ConstantBuffer<AppSettingsCBuffer> CBuffer;
@@ -514,7 +550,7 @@ namespace AppSettings
         SHSpecularMode.Initialize(tweakBar, "SHSpecularMode", "SH Settings", "SH Specular Mode", "", SHSpecularModes::Convolution, 4, SHSpecularModesLabels);
         Settings.AddSetting(&SHSpecularMode);
 
-        LightMapResolution.Initialize(tweakBar, "LightMapResolution", "Baking", "Light Map Resolution", "The texture resolution of the light map", 256, 64, 4096);
+        LightMapResolution.Initialize(tweakBar, "LightMapResolution", "Baking", "Light Map Resolution", "The texture resolution of the light map. Light maps bigger than 4096 are always baked out-of-core, and are displayed at a reduced resolution.", 256, 64, 16384);
         Settings.AddSetting(&LightMapResolution);
 
         NumBakeSamples.Initialize(tweakBar, "NumBakeSamples", "Baking", "Sqrt Num Samples", "The square root of the number of sample rays to use for baking GI", 25, 1, 100);
@@ -541,6 +577,69 @@ namespace AppSettings
         WorldSpaceBake.Initialize(tweakBar, "WorldSpaceBake", "Baking", "World Space Bake", "If true, the sample points are baked in a world-space orientation instead of tangent space (SH and SG bake modes only)", false);
         Settings.AddSetting(&WorldSpaceBake);
 
+        StreamingSGSolve.Initialize(tweakBar, "StreamingSGSolve", "Baking", "Streaming SG Solve", "If true, the least squares SG solve modes accumulate the normal equations as samples are traced instead of storing every sample, which keeps memory constant at high sample counts. This solves the normal equations, so it loses precision compared to the regular solve when the SG lobes are badly conditioned", false);
+        Settings.AddSetting(&StreamingSGSolve);
+
+        CompositeBake.Initialize(tweakBar, "CompositeBake", "Baking", "Composite Bake", "If true, every path sample is also projected onto the HL2, SH and H-basis bake modes so that switching to one of those modes after the bake finishes doesn't require re-baking (not supported by the Diffuse bake mode)", false);
+        Settings.AddSetting(&CompositeBake);
+
+        DenoiseLightMap.Initialize(tweakBar, "DenoiseLightMap", "Baking", "Denoise Light Map", "If true, an edge-aware filter is run over the light map once the bake has finished", false);
+        Settings.AddSetting(&DenoiseLightMap);
+
+        DenoiserIterations.Initialize(tweakBar, "DenoiserIterations", "Baking", "Denoiser Iterations", "The number of a-trous filter passes used by the light map denoiser, each one doubling the filter footprint", 4, 1, 8);
+        Settings.AddSetting(&DenoiserIterations);
+
+        DenoiserPositionSigma.Initialize(tweakBar, "DenoiserPositionSigma", "Baking", "Denoiser Position Sigma", "Scales how far apart two texels can be in world space (relative to the texel size) before the denoiser stops blending them", 1.0000f, 0.0100f, 10.0000f, 0.0100f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&DenoiserPositionSigma);
+
+        DenoiserNormalPower.Initialize(tweakBar, "DenoiserNormalPower", "Baking", "Denoiser Normal Power", "Exponent applied to the dot product of two texel normals when computing the denoiser weights, higher values preserve creases better", 64.0000f, 1.0000f, 256.0000f, 0.0100f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&DenoiserNormalPower);
+
+        RunDenoiser.Initialize(tweakBar, "RunDenoiser", "Baking", "Denoise Light Map Now", "Runs the light map denoiser on the current bake results, even if the bake hasn't finished");
+        Settings.AddSetting(&RunDenoiser);
+
+        EnableRadianceCache.Initialize(tweakBar, "EnableRadianceCache", "Baking", "Enable Radiance Cache", "If true, bake paths are terminated past their first bounce using a world-space cache of outgoing radiance, once the cached estimate is accurate enough", false);
+        Settings.AddSetting(&EnableRadianceCache);
+
+        RadianceCacheTolerance.Initialize(tweakBar, "RadianceCacheTolerance", "Baking", "Radiance Cache Tolerance", "The maximum relative standard error of a radiance cache cell before it's used to terminate paths. Lower values are more accurate, but trace more full paths", 0.0500f, 0.0010f, 1.0000f, 0.0010f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&RadianceCacheTolerance);
+
+        RadianceCacheCellSize.Initialize(tweakBar, "RadianceCacheCellSize", "Baking", "Radiance Cache Cell Size", "The world-space size of a radiance cache cell", 0.1000f, 0.0010f, 10.0000f, 0.0100f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&RadianceCacheCellSize);
+
+        LightMapFeedbackBounces.Initialize(tweakBar, "LightMapFeedbackBounces", "Baking", "Light Map Feedback Bounces", "If greater than 0, bake paths end at their first hit and are shaded using a light map containing this many bounces, which is computed up front by repeatedly tracing a single segment from every texel (0 disables)", 0, 0, 16);
+        Settings.AddSetting(&LightMapFeedbackBounces);
+
+        LightMapFeedbackSamples.Initialize(tweakBar, "LightMapFeedbackSamples", "Baking", "Light Map Feedback Samples", "The number of rays traced from every texel for each light map feedback bounce", 64, 1, 4096);
+        Settings.AddSetting(&LightMapFeedbackSamples);
+
+        EnableBakeCheckpoints.Initialize(tweakBar, "EnableBakeCheckpoints", "Baking", "Enable Bake Checkpoints", "If true, the bake progress is periodically saved to a checkpoint file, and a bake with the same scene and settings resumes from its checkpoint instead of starting over", false);
+        Settings.AddSetting(&EnableBakeCheckpoints);
+
+        BakeCheckpointInterval.Initialize(tweakBar, "BakeCheckpointInterval", "Baking", "Bake Checkpoint Interval", "The number of seconds between bake checkpoints", 300, 10, 3600);
+        Settings.AddSetting(&BakeCheckpointInterval);
+
+        EnableBakeResultCache.Initialize(tweakBar, "EnableBakeResultCache", "Baking", "Enable Bake Result Cache", "If true, the results of every finished bake are saved to a cache on disk, and switching back to a scene and set of bake settings that was already baked loads the results instead of baking again", true);
+        Settings.AddSetting(&EnableBakeResultCache);
+
+        BakeResultCacheSize.Initialize(tweakBar, "BakeResultCacheSize", "Baking", "Bake Result Cache Size", "The maximum size of the bake result cache in megabytes. The least recently used results are deleted once the cache goes over this size.", 4096, 64, 65536);
+        Settings.AddSetting(&BakeResultCacheSize);
+
+        PrioritizeVisibleTexels.Initialize(tweakBar, "PrioritizeVisibleTexels", "Baking", "Prioritize Visible Texels", "If true, the parts of the light map that are visible from the camera are baked first, nearest first, and the order is updated as the camera moves. This has no effect on out-of-core bakes, which always go in light map order.", true);
+        Settings.AddSetting(&PrioritizeVisibleTexels);
+
+        CoarseBakeMode.Initialize(tweakBar, "CoarseBakeMode", "Baking", "Coarse-To-Fine Bake", "If enabled, progressive bakes start out by fully baking one texel from every 2x2 (or 4x4) block of texels and copying it to the rest of the block, which gives a usable preview early on. Only texels on the same surface share a preview texel. Each texel keeps showing its preview until it has baked as many samples of its own, and the final results don't include the preview.", CoarseBakeModes::Disabled, 3, CoarseBakeModesLabels);
+        Settings.AddSetting(&CoarseBakeMode);
+
+        OutOfCoreBake.Initialize(tweakBar, "OutOfCoreBake", "Baking", "Out-Of-Core Bake", "If true, the bake points and bake results are kept in temporary files that the OS pages in and out as needed instead of in memory, and the light map is baked in order from top to bottom so that only a small part of it is being worked on at once. The light map feedback is also kept on disk. This allows baking light maps that don't fit in memory, up to 16384.", false);
+        Settings.AddSetting(&OutOfCoreBake);
+
+        DistributedBakeMode.Initialize(tweakBar, "DistributedBakeMode", "Baking", "Distributed Bake", "Lets several processes (on this machine or others) bake the same light map. The coordinator bakes with its own threads, and hands out the rest of the light map in leases to any workers that connect to it. Workers pick up the coordinator's bake settings, and send back the results for each lease once it's done. Processes can also be started as workers with -bakeworker [host[:port]] on the command line.", DistributedBakeModes::Disabled, 3, DistributedBakeModesLabels);
+        Settings.AddSetting(&DistributedBakeMode);
+
+        DistributedBakePort.Initialize(tweakBar, "DistributedBakePort", "Baking", "Distributed Bake Port", "The TCP port that the coordinator listens on, and that workers connect to", 41500, 1024, 65535);
+        Settings.AddSetting(&DistributedBakePort);
+
         CurrentScene.Initialize(tweakBar, "CurrentScene", "Scene", "Current Scene", "", Scenes::Box, 3, ScenesLabels);
         Settings.AddSetting(&CurrentScene);
 
@@ -634,6 +733,9 @@ namespace AppSettings
         SaveEXRScreenshot.Initialize(tweakBar, "SaveEXRScreenshot", "Debug", "Save EXR Screenshot", "Captures the current screen image in EXR format");
         Settings.AddSetting(&SaveEXRScreenshot);
 
+        ExportLightMap.Initialize(tweakBar, "ExportLightMap", "Debug", "Export Light Map", "Saves every basis of the baked light map to a multi-part EXR file");
+        Settings.AddSetting(&ExportLightMap);
+
         ShowSunIntensity.Initialize(tweakBar, "ShowSunIntensity", "Debug", "Show Sun Intensity", "", false);
         Settings.AddSetting(&ShowSunIntensity);
 
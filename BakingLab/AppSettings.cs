@@ -303,6 +303,24 @@ enum SolveModes
     RunningAverageNN,
 }
 
+enum CoarseBakeModes
+{
+    Disabled = 0,
+
+    [EnumLabel("Half Resolution")]
+    HalfResolution,
+
+    [EnumLabel("Quarter Resolution")]
+    QuarterResolution,
+}
+
+enum DistributedBakeModes
+{
+    Disabled = 0,
+    Coordinator,
+    Worker,
+}
+
 enum SGDiffuseModes
 {
     InnerProduct = 0,
@@ -672,9 +690,9 @@ public class Settings
     public class Baking
     {
         [DisplayName("Light Map Resolution")]
-        [HelpText("The texture resolution of the light map")]
+        [HelpText("The texture resolution of the light map. Light maps bigger than 4096 are always baked out-of-core, and are displayed at a reduced resolution.")]
         [MinValue(64)]
-        [MaxValue(4096)]
+        [MaxValue(16384)]
         int LightMapResolution = 256;
 
         [HelpText("The square root of the number of sample rays to use for baking GI")]
@@ -715,6 +733,133 @@ public class Settings
 
         [HelpText("If true, the sample points are baked in a world-space orientation instead of tangent space (SH and SG bake modes only)")]
         bool WorldSpaceBake = false;
+
+        [HelpText("If true, the least squares SG solve modes accumulate the normal equations as samples are traced instead of storing every sample, which keeps memory constant at high sample counts. This solves the normal equations, so it loses precision compared to the regular solve when the SG lobes are badly conditioned")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Streaming SG Solve")]
+        bool StreamingSGSolve = false;
+
+        [HelpText("If true, every path sample is also projected onto the HL2, SH and H-basis bake modes so that switching to one of those modes after the bake finishes doesn't require re-baking (not supported by the Diffuse bake mode)")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Composite Bake")]
+        bool CompositeBake = false;
+
+        [HelpText("If true, an edge-aware filter is run over the light map once the bake has finished")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Denoise Light Map")]
+        bool DenoiseLightMap = false;
+
+        [HelpText("The number of a-trous filter passes used by the light map denoiser, each one doubling the filter footprint")]
+        [UseAsShaderConstant(false)]
+        [MinValue(1)]
+        [MaxValue(8)]
+        [DisplayName("Denoiser Iterations")]
+        int DenoiserIterations = 4;
+
+        [HelpText("Scales how far apart two texels can be in world space (relative to the texel size) before the denoiser stops blending them")]
+        [UseAsShaderConstant(false)]
+        [MinValue(0.01f)]
+        [MaxValue(10.0f)]
+        [StepSize(0.01f)]
+        [DisplayName("Denoiser Position Sigma")]
+        float DenoiserPositionSigma = 1.0f;
+
+        [HelpText("Exponent applied to the dot product of two texel normals when computing the denoiser weights, higher values preserve creases better")]
+        [UseAsShaderConstant(false)]
+        [MinValue(1.0f)]
+        [MaxValue(256.0f)]
+        [DisplayName("Denoiser Normal Power")]
+        float DenoiserNormalPower = 64.0f;
+
+        [DisplayName("Denoise Light Map Now")]
+        [HelpText("Runs the light map denoiser on the current bake results, even if the bake hasn't finished")]
+        Button RunDenoiser;
+
+        [HelpText("If true, bake paths are terminated past their first bounce using a world-space cache of outgoing radiance, once the cached estimate is accurate enough")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Enable Radiance Cache")]
+        bool EnableRadianceCache = false;
+
+        [HelpText("The maximum relative standard error of a radiance cache cell before it's used to terminate paths. Lower values are more accurate, but trace more full paths")]
+        [UseAsShaderConstant(false)]
+        [MinValue(0.001f)]
+        [MaxValue(1.0f)]
+        [StepSize(0.001f)]
+        [DisplayName("Radiance Cache Tolerance")]
+        float RadianceCacheTolerance = 0.05f;
+
+        [HelpText("The world-space size of a radiance cache cell")]
+        [UseAsShaderConstant(false)]
+        [MinValue(0.001f)]
+        [MaxValue(10.0f)]
+        [StepSize(0.01f)]
+        [DisplayName("Radiance Cache Cell Size")]
+        float RadianceCacheCellSize = 0.1f;
+
+        [HelpText("If greater than 0, bake paths end at their first hit and are shaded using a light map containing this many bounces, which is computed up front by repeatedly tracing a single segment from every texel (0 disables)")]
+        [UseAsShaderConstant(false)]
+        [MinValue(0)]
+        [MaxValue(16)]
+        [DisplayName("Light Map Feedback Bounces")]
+        int LightMapFeedbackBounces = 0;
+
+        [HelpText("The number of rays traced from every texel for each light map feedback bounce")]
+        [UseAsShaderConstant(false)]
+        [MinValue(1)]
+        [MaxValue(4096)]
+        [DisplayName("Light Map Feedback Samples")]
+        int LightMapFeedbackSamples = 64;
+
+        [HelpText("If true, the bake progress is periodically saved to a checkpoint file, and a bake with the same scene and settings resumes from its checkpoint instead of starting over")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Enable Bake Checkpoints")]
+        bool EnableBakeCheckpoints = false;
+
+        [HelpText("The number of seconds between bake checkpoints")]
+        [UseAsShaderConstant(false)]
+        [MinValue(10)]
+        [MaxValue(3600)]
+        [DisplayName("Bake Checkpoint Interval")]
+        int BakeCheckpointInterval = 300;
+
+        [HelpText("If true, the results of every finished bake are saved to a cache on disk, and switching back to a scene and set of bake settings that was already baked loads the results instead of baking again")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Enable Bake Result Cache")]
+        bool EnableBakeResultCache = true;
+
+        [HelpText("The maximum size of the bake result cache in megabytes. The least recently used results are deleted once the cache goes over this size.")]
+        [UseAsShaderConstant(false)]
+        [MinValue(64)]
+        [MaxValue(65536)]
+        [DisplayName("Bake Result Cache Size")]
+        int BakeResultCacheSize = 4096;
+
+        [HelpText("If true, the parts of the light map that are visible from the camera are baked first, nearest first, and the order is updated as the camera moves. This has no effect on out-of-core bakes, which always go in light map order.")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Prioritize Visible Texels")]
+        bool PrioritizeVisibleTexels = true;
+
+        [HelpText("If enabled, progressive bakes start out by fully baking one texel from every 2x2 (or 4x4) block of texels and copying it to the rest of the block, which gives a usable preview early on. Only texels on the same surface share a preview texel. Each texel keeps showing its preview until it has baked as many samples of its own, and the final results don't include the preview.")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Coarse-To-Fine Bake")]
+        CoarseBakeModes CoarseBakeMode = CoarseBakeModes.Disabled;
+
+        [HelpText("If true, the bake points and bake results are kept in temporary files that the OS pages in and out as needed instead of in memory, and the light map is baked in order from top to bottom so that only a small part of it is being worked on at once. The light map feedback is also kept on disk. This allows baking light maps that don't fit in memory, up to 16384.")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Out-Of-Core Bake")]
+        bool OutOfCoreBake = false;
+
+        [HelpText("Lets several processes (on this machine or others) bake the same light map. The coordinator bakes with its own threads, and hands out the rest of the light map in leases to any workers that connect to it. Workers pick up the coordinator's bake settings, and send back the results for each lease once it's done. Processes can also be started as workers with -bakeworker [host[:port]] on the command line.")]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Distributed Bake")]
+        DistributedBakeModes DistributedBakeMode = DistributedBakeModes.Disabled;
+
+        [HelpText("The TCP port that the coordinator listens on, and that workers connect to")]
+        [MinValue(1024)]
+        [MaxValue(65535)]
+        [UseAsShaderConstant(false)]
+        [DisplayName("Distributed Bake Port")]
+        int DistributedBakePort = 41500;
     }
 
     [ExpandGroup(false)]
@@ -877,6 +1022,10 @@ public class Settings
         [HelpText("Captures the current screen image in EXR format")]
         Button SaveEXRScreenshot;
 
+        [DisplayName("Export Light Map")]
+        [HelpText("Saves every basis of the baked light map to a multi-part EXR file")]
+        Button ExportLightMap;
+
         [UseAsShaderConstant(false)]
         bool ShowSunIntensity = false;
     }
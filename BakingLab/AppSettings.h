@@ -261,6 +261,28 @@ enum class SolveModes
 
 typedef EnumSettingT<SolveModes> SolveModesSetting;
 
+enum class CoarseBakeModes
+{
+    Disabled = 0,
+    HalfResolution = 1,
+    QuarterResolution = 2,
+
+    NumValues
+};
+
+typedef EnumSettingT<CoarseBakeModes> CoarseBakeModesSetting;
+
+enum class DistributedBakeModes
+{
+    Disabled = 0,
+    Coordinator = 1,
+    Worker = 2,
+
+    NumValues
+};
+
+typedef EnumSettingT<DistributedBakeModes> DistributedBakeModesSetting;
+
 enum class Scenes
 {
     Box = 0,
@@ -351,6 +373,27 @@ namespace AppSettings
     extern BakeModesSetting BakeMode;
     extern SolveModesSetting SolveMode;
     extern BoolSetting WorldSpaceBake;
+    extern BoolSetting StreamingSGSolve;
+    extern BoolSetting CompositeBake;
+    extern BoolSetting DenoiseLightMap;
+    extern IntSetting DenoiserIterations;
+    extern FloatSetting DenoiserPositionSigma;
+    extern FloatSetting DenoiserNormalPower;
+    extern Button RunDenoiser;
+    extern BoolSetting EnableRadianceCache;
+    extern FloatSetting RadianceCacheTolerance;
+    extern FloatSetting RadianceCacheCellSize;
+    extern IntSetting LightMapFeedbackBounces;
+    extern IntSetting LightMapFeedbackSamples;
+    extern BoolSetting EnableBakeCheckpoints;
+    extern IntSetting BakeCheckpointInterval;
+    extern BoolSetting EnableBakeResultCache;
+    extern IntSetting BakeResultCacheSize;
+    extern BoolSetting PrioritizeVisibleTexels;
+    extern CoarseBakeModesSetting CoarseBakeMode;
+    extern BoolSetting OutOfCoreBake;
+    extern DistributedBakeModesSetting DistributedBakeMode;
+    extern IntSetting DistributedBakePort;
     extern ScenesSetting CurrentScene;
     extern BoolSetting EnableDiffuse;
     extern BoolSetting EnableSpecular;
@@ -382,6 +425,7 @@ namespace AppSettings
     extern Button SaveLightSettings;
     extern Button LoadLightSettings;
     extern Button SaveEXRScreenshot;
+    extern Button ExportLightMap;
     extern BoolSetting ShowSunIntensity;
 
     struct AppSettingsCBuffer
@@ -0,0 +1,157 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "BVHBuilder.h"
+
+#include <Graphics/Model.h>
+#include <Utility.h>
+#include <Timer.h>
+
+#include "SceneCache.h"
+#include "BakeResultCache.h"
+
+// Builds the embree scene from the flattened geometry
+static void BuildEmbreeScene(BVHData& bvhData, RTCDevice device)
+{
+    if(bvhData.Scene != nullptr)
+    {
+        rtcDeleteScene(bvhData.Scene);
+        bvhData.Scene = nullptr;
+    }
+    bvhData.Scene = rtcDeviceNewScene(device, RTC_SCENE_DYNAMIC, RTC_INTERSECT1);
+    bvhData.Device = device;
+
+    const uint32 totalNumVertices = uint32(bvhData.Vertices.size());
+    const uint32 totalNumTriangles = uint32(bvhData.Triangles.size());
+    uint32 geoID = rtcNewTriangleMesh(bvhData.Scene, RTC_GEOMETRY_STATIC, totalNumTriangles, totalNumVertices);
+
+    Float4* meshVerts = reinterpret_cast<Float4*>(rtcMapBuffer(bvhData.Scene, geoID, RTC_VERTEX_BUFFER));
+    for(uint32 i = 0; i < totalNumVertices; ++i)
+        meshVerts[i] = Float4(bvhData.Vertices[i].Position, 0.0f);
+    rtcUnmapBuffer(bvhData.Scene, geoID, RTC_VERTEX_BUFFER);
+
+    Uint3* meshTriangles = reinterpret_cast<Uint3*>(rtcMapBuffer(bvhData.Scene, geoID, RTC_INDEX_BUFFER));
+    memcpy(meshTriangles, bvhData.Triangles.data(), totalNumTriangles * sizeof(Uint3));
+    rtcUnmapBuffer(bvhData.Scene, geoID, RTC_INDEX_BUFFER);
+
+    rtcCommit(bvhData.Scene);
+
+    RTCError embreeError = rtcDeviceGetError(device);
+    Assert_(embreeError == RTC_NO_ERROR);
+    if(embreeError != RTC_NO_ERROR)
+        throw Exception(L"Failed to build embree scene!");
+}
+
+void BuildBVH(const Model& model, const SceneCache* sceneCache, BVHData& bvhData,
+              ID3D11Device* d3dDevice, RTCDevice device)
+{
+    if(sceneCache == nullptr || sceneCache->LoadBVHInput(bvhData) == false)
+        ExtractBVHInput(model, d3dDevice, bvhData);
+
+    BuildEmbreeScene(bvhData, device);
+}
+
+BVHBuilder::~BVHBuilder()
+{
+    Wait();
+}
+
+void BVHBuilder::Start(const Model* newModel, const SceneCache* newSceneCache, RTCDevice newDevice)
+{
+    Assert_(newModel != nullptr);
+    Discard();
+
+    model = newModel;
+    sceneCache = newSceneCache;
+    device = newDevice;
+    thread = HANDLE(_beginthreadex(nullptr, 0, BuildThread, this, 0, nullptr));
+    if(thread == 0)
+    {
+        AssertFail_("Failed to create thread for building a BVH");
+        throw Exception(L"Failed to create thread for building a BVH");
+    }
+}
+
+void BVHBuilder::Discard()
+{
+    Wait();
+
+    BVHData emptyBVH;
+    bvhData.Swap(emptyBVH);
+    model = nullptr;
+    sceneCache = nullptr;
+    built = false;
+}
+
+bool BVHBuilder::Busy() const
+{
+    return thread != nullptr && WaitForSingleObject(thread, 0) == WAIT_TIMEOUT;
+}
+
+void BVHBuilder::Finish(BVHData& dstBVHData, Hash& dstSceneHash, ID3D11Device* d3dDevice)
+{
+    Assert_(model != nullptr);
+    Wait();
+
+    // The build thread can only use the scene cache, so anything else is done here
+    if(built == false)
+    {
+        BVHData emptyBVH;
+        bvhData.Swap(emptyBVH);
+        BuildBVH(*model, nullptr, bvhData, d3dDevice, device);
+        sceneHash = ComputeBakeSceneHash(bvhData);
+    }
+
+    dstBVHData.Swap(bvhData);
+    dstSceneHash = sceneHash;
+
+    Discard();
+}
+
+void BVHBuilder::Wait()
+{
+    if(thread == nullptr)
+        return;
+
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    thread = nullptr;
+}
+
+uint32 __stdcall BVHBuilder::BuildThread(void* context)
+{
+    BVHBuilder& builder = *reinterpret_cast<BVHBuilder*>(context);
+
+    try
+    {
+        Timer timer;
+        if(builder.sceneCache != nullptr && builder.sceneCache->LoadBVHInput(builder.bvhData))
+        {
+            BuildEmbreeScene(builder.bvhData, builder.device);
+            builder.sceneHash = ComputeBakeSceneHash(builder.bvhData);
+            builder.built = true;
+
+            timer.Update();
+            PrintString("Built BVH in the background (%fs)", timer.DeltaSecondsF());
+        }
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to build BVH in the background: %ls", e.GetMessage().c_str());
+
+        BVHData emptyBVH;
+        builder.bvhData.Swap(emptyBVH);
+        builder.built = false;
+    }
+
+    return 0;
+}
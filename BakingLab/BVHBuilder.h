@@ -0,0 +1,73 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <MurmurHash.h>
+
+#include "PathTracer.h"
+
+namespace SampleFramework11
+{
+    class Model;
+}
+
+using namespace SampleFramework11;
+
+class SceneCache;
+
+// Loads the flattened geometry and material texels for a model from its scene cache (or extracts
+// them from the model if they're not cached), and builds the embree scene. Extracting goes
+// through the immediate context, so this needs to be called from the thread that renders.
+void BuildBVH(const Model& model, const SceneCache* sceneCache, BVHData& bvhData,
+              ID3D11Device* d3dDevice, RTCDevice device);
+
+// Builds the BVH for a new scene on a background thread, so that the current scene can keep
+// rendering and baking while the scene cache is read and the embree scene gets committed. The
+// finished BVH is handed over with Finish(), which is the only point where the bake and render
+// threads need to be stopped.
+class BVHBuilder
+{
+
+public:
+
+    ~BVHBuilder();
+
+    // The model and scene cache need to stay alive until the build is finished or discarded
+    void Start(const Model* model, const SceneCache* sceneCache, RTCDevice device);
+
+    // Waits for the build thread, and throws away whatever it built
+    void Discard();
+
+    // Returns the model being built, or null if there's no build in progress
+    const Model* PendingModel() const { return model; }
+
+    // Returns true while the build thread is still running
+    bool Busy() const;
+
+    // Swaps the finished BVH into bvhData, and destroys the old one. If the scene cache didn't
+    // have the BVH input, it gets extracted from the model here instead of on the build thread.
+    void Finish(BVHData& bvhData, Hash& sceneHash, ID3D11Device* d3dDevice);
+
+private:
+
+    void Wait();
+
+    static uint32 __stdcall BuildThread(void* context);
+
+    const Model* model = nullptr;
+    const SceneCache* sceneCache = nullptr;
+    RTCDevice device = nullptr;
+    BVHData bvhData;
+    Hash sceneHash;
+    bool built = false;
+    HANDLE thread = nullptr;
+};
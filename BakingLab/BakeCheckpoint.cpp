@@ -0,0 +1,557 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "BakeCheckpoint.h"
+
+#include <FileIO.h>
+#include <Serialization.h>
+#include <Utility.h>
+
+#include "AppSettings.h"
+
+static const uint32 CheckpointMagic = 0x50434C42;   // "BLCP"
+static const uint32 CheckpointVersion = 2;
+static const wchar* CheckpointDirectory = L"BakeCheckpoints";
+
+// Data is hashed in blocks of this size, since MurmurHash takes an int for the length
+static const uint64 MaxHashBlockSize = 256 * 1024 * 1024;
+
+// Every setting that changes the bake results when it's modified, which is the same set of
+// settings that restarts the bake in MeshBaker::Update()
+static Setting* BakeSettings[] =
+{
+    &AppSettings::LightMapResolution,
+    &AppSettings::NumBakeSamples,
+    &AppSettings::BakeSampleMode,
+    &AppSettings::MaxBakePathLength,
+    &AppSettings::BakeRussianRouletteDepth,
+    &AppSettings::BakeRussianRouletteProbability,
+    &AppSettings::BakeMode,
+    &AppSettings::SolveMode,
+    &AppSettings::WorldSpaceBake,
+    &AppSettings::StreamingSGSolve,
+    &AppSettings::CompositeBake,
+    &AppSettings::CoarseBakeMode,
+    &AppSettings::EnableRadianceCache,
+    &AppSettings::RadianceCacheTolerance,
+    &AppSettings::RadianceCacheCellSize,
+    &AppSettings::LightMapFeedbackBounces,
+    &AppSettings::LightMapFeedbackSamples,
+    &AppSettings::CurrentScene,
+    &AppSettings::EnableSun,
+    &AppSettings::BakeDirectSunLight,
+    &AppSettings::BakeDirectAreaLight,
+    &AppSettings::SunTintColor,
+    &AppSettings::SunIntensityScale,
+    &AppSettings::SunSize,
+    &AppSettings::NormalizeSunIntensity,
+    &AppSettings::SunDirType,
+    &AppSettings::SunDirection,
+    &AppSettings::SunAzimuth,
+    &AppSettings::SunElevation,
+    &AppSettings::SkyMode,
+    &AppSettings::SkyColor,
+    &AppSettings::Turbidity,
+    &AppSettings::GroundAlbedo,
+    &AppSettings::EnableAreaLight,
+    &AppSettings::EnableAreaLightShadows,
+    &AppSettings::AreaLightColor,
+    &AppSettings::AreaLightSize,
+    &AppSettings::AreaLightX,
+    &AppSettings::AreaLightY,
+    &AppSettings::AreaLightZ,
+    &AppSettings::DiffuseAlbedoScale,
+    &AppSettings::EnableAlbedoMaps,
+    &AppSettings::MetallicOffset,
+};
+
+// Sizes of everything stored in the checkpoint, which is written at the start of the file so
+// that a checkpoint can be validated before anything gets loaded from it
+struct BakeCheckpointHeader
+{
+    uint32 Magic = CheckpointMagic;
+    uint32 Version = CheckpointVersion;
+    Hash Identity;
+    uint64 NumBakeBatches = 0;
+    uint64 NumBakeGroups = 0;
+    uint64 LightMapSize = 0;
+    uint64 BasisCount = 0;
+    uint64 CompositeBasisCount = 0;
+    uint64 HasAccumulators = 0;
+    uint64 CompositeHasAccumulators = 0;
+    uint64 NumSampleSets = 0;
+    uint64 SampleSetPixels = 0;
+    uint64 SampleSetTypes = 0;
+    uint64 SampleSetSamples = 0;
+    uint64 NumFeedbackTexels = 0;
+
+    uint64 SampleSetSize() const
+    {
+        return SampleSetPixels * SampleSetTypes * SampleSetSamples;
+    }
+
+    // Size of the results for a single bake group
+    uint64 TileDataSize() const
+    {
+        const uint64 basisSize = sizeof(Half4) + (HasAccumulators ? sizeof(Float4) : 0);
+        const uint64 compositeBasisSize = sizeof(Half4) + (CompositeHasAccumulators ? sizeof(Float4) : 0);
+        return BakeResultStore::TileSize * (BasisCount * basisSize + CompositeBasisCount * compositeBasisSize);
+    }
+
+    uint64 FileSize() const
+    {
+        return sizeof(BakeCheckpointHeader) + NumSampleSets * SampleSetSize() * sizeof(Float2) +
+               NumFeedbackTexels * sizeof(Float4) + NumBakeGroups * (sizeof(int64) + TileDataSize()) +
+               sizeof(uint32);
+    }
+};
+
+static BakeCheckpointHeader MakeHeader(const BakeCheckpointData& data)
+{
+    const BakeResultStore& bakeResults = *data.BakeResults;
+    const std::vector<IntegrationSamples>& samples = *data.Samples;
+    Assert_(samples.size() > 0);
+
+    BakeCheckpointHeader header;
+    header.Identity = data.Identity;
+    header.NumBakeBatches = data.NumBakeBatches;
+    header.NumBakeGroups = data.GroupSchedule->size();
+    header.LightMapSize = bakeResults.LightMapSize();
+    header.BasisCount = bakeResults.BasisCount();
+    header.CompositeBasisCount = data.CompositeResults ? data.CompositeResults->BasisCount() : 0;
+    header.HasAccumulators = bakeResults.HasAccumulators() ? 1 : 0;
+    header.CompositeHasAccumulators = data.CompositeResults && data.CompositeResults->HasAccumulators() ? 1 : 0;
+    header.NumSampleSets = samples.size();
+    header.SampleSetPixels = samples[0].NumPixels;
+    header.SampleSetTypes = samples[0].NumTypes;
+    header.SampleSetSamples = samples[0].NumSamples;
+    header.NumFeedbackTexels = data.FeedbackIrradiance->Size();
+
+    return header;
+}
+
+// Checks everything in the header except for the number of sample sets, which depends on how
+// many threads the machine that wrote the checkpoint had. There always needs to be at least two,
+// since coarse-to-fine bakes use separate sample sets for the coarse and fine passes.
+static bool HeadersMatch(const BakeCheckpointHeader& header, const BakeCheckpointHeader& expected)
+{
+    return header.Magic == expected.Magic && header.Version == expected.Version &&
+           header.Identity.A == expected.Identity.A && header.Identity.B == expected.Identity.B &&
+           header.NumBakeBatches == expected.NumBakeBatches && header.NumBakeGroups == expected.NumBakeGroups &&
+           header.LightMapSize == expected.LightMapSize && header.BasisCount == expected.BasisCount &&
+           header.CompositeBasisCount == expected.CompositeBasisCount && header.HasAccumulators == expected.HasAccumulators &&
+           header.CompositeHasAccumulators == expected.CompositeHasAccumulators &&
+           header.NumSampleSets > 1 && header.SampleSetPixels == expected.SampleSetPixels &&
+           header.SampleSetTypes == expected.SampleSetTypes && header.SampleSetSamples == expected.SampleSetSamples &&
+           header.NumFeedbackTexels == expected.NumFeedbackTexels;
+}
+
+// Reads the blocks of a group's results from a checkpoint, straight into the result stores
+struct TileBlockReader
+{
+    FileReadSerializer& Serializer;
+
+    template<typename T> void operator()(T* blockData, uint64 count)
+    {
+        SerializeRawArray(Serializer, blockData, count);
+    }
+};
+
+// Copies the blocks of a group's results into a contiguous buffer
+struct TileBlockCopier
+{
+    uint8* Dst;
+
+    template<typename T> void operator()(const T* blockData, uint64 count)
+    {
+        memcpy(Dst, blockData, count * sizeof(T));
+        Dst += count * sizeof(T);
+    }
+};
+
+// Copies the blocks of a group's results back out of a contiguous buffer
+struct TileBlockStorer
+{
+    const uint8* Src;
+
+    template<typename T> void operator()(T* blockData, uint64 count)
+    {
+        memcpy(blockData, Src, count * sizeof(T));
+        Src += count * sizeof(T);
+    }
+};
+
+// Adds up the size of the blocks of a group's results
+struct TileBlockSizer
+{
+    uint64 Size;
+
+    template<typename T> void operator()(const T* blockData, uint64 count)
+    {
+        Size += count * sizeof(T);
+    }
+};
+
+// Calls func(data, count) for every block of a group's results, in the order that they're stored
+// in the checkpoint
+template<typename TFunc> static void ForEachTileBlock(const BakeCheckpointData& data, uint64 scheduleIdx, TFunc& func)
+{
+    BakeResultStore& bakeResults = *data.BakeResults;
+    const uint64 groupIdx = (*data.GroupSchedule)[scheduleIdx];
+    const uint64 tileOffset = bakeResults.TileOffset(groupIdx % bakeResults.NumTilesX(), groupIdx / bakeResults.NumTilesX());
+
+    for(uint64 basisIdx = 0; basisIdx < bakeResults.BasisCount(); ++basisIdx)
+    {
+        func(bakeResults.BasisData(basisIdx) + tileOffset, BakeResultStore::TileSize);
+        if(bakeResults.HasAccumulators())
+            func(bakeResults.AccumulatorData(basisIdx) + tileOffset, BakeResultStore::TileSize);
+    }
+
+    if(data.CompositeResults != nullptr)
+    {
+        BakeResultStore& compositeResults = *data.CompositeResults;
+        for(uint64 basisIdx = 0; basisIdx < compositeResults.BasisCount(); ++basisIdx)
+        {
+            func(compositeResults.BasisData(basisIdx) + tileOffset, BakeResultStore::TileSize);
+            if(compositeResults.HasAccumulators())
+                func(compositeResults.AccumulatorData(basisIdx) + tileOffset, BakeResultStore::TileSize);
+        }
+    }
+}
+
+Hash GenerateLargeHash(const void* data, uint64 size, uint32 seed)
+{
+    // The first piece is hashed on its own, so that smaller blocks keep the same hash
+    const uint8* bytes = reinterpret_cast<const uint8*>(data);
+    Hash result = GenerateHash(bytes, int(std::min(size, MaxHashBlockSize)), seed);
+    for(uint64 offset = MaxHashBlockSize; offset < size; offset += MaxHashBlockSize)
+    {
+        const uint64 blockSize = std::min(size - offset, MaxHashBlockSize);
+        const Hash hashes[2] = { result, GenerateHash(bytes + offset, int(blockSize), seed) };
+        result = GenerateHash(hashes, int(sizeof(hashes)), seed);
+    }
+
+    return result;
+}
+
+Hash ComputeBakeSettingsHash(uint32 seed)
+{
+    ByteArraySerializer serializer;
+    for(uint64 i = 0; i < ArraySize_(BakeSettings); ++i)
+        BakeSettings[i]->SerializeValue(serializer);
+
+    return GenerateHash(serializer.Bytes.data(), int(serializer.Bytes.size()), seed);
+}
+
+Hash ComputeBakeCheckpointIdentity(const PagedArray<BakePoint>& bakePoints)
+{
+    const Hash settingsHash = ComputeBakeSettingsHash(CheckpointVersion);
+
+    const Hash bakePointsHash = GenerateLargeHash(bakePoints.Data(), bakePoints.Size() * sizeof(BakePoint), uint32(settingsHash.A));
+    return Hash(bakePointsHash.A, bakePointsHash.B ^ settingsHash.B);
+}
+
+std::wstring BakeCheckpointPath(const Hash& identity)
+{
+    return std::wstring(CheckpointDirectory) + L"\\" + identity.ToString() + L".bcp";
+}
+
+std::vector<uint8> SerializeBakeSettings()
+{
+    ByteArraySerializer serializer;
+    for(uint64 i = 0; i < ArraySize_(BakeSettings); ++i)
+        BakeSettings[i]->SerializeValue(serializer);
+
+    return serializer.Bytes;
+}
+
+void DeserializeBakeSettings(const uint8* data, uint64 size)
+{
+    uint64 expectedSize = 0;
+    for(uint64 i = 0; i < ArraySize_(BakeSettings); ++i)
+        expectedSize += BakeSettings[i]->SerializedValueSize();
+    if(size != expectedSize)
+        throw Exception(L"Serialized bake settings don't match the current set of settings");
+
+    MemoryReadSerializer serializer(data, size);
+    for(uint64 i = 0; i < ArraySize_(BakeSettings); ++i)
+        BakeSettings[i]->SerializeValue(serializer);
+}
+
+uint64 BakeGroupDataSize(const BakeCheckpointData& data)
+{
+    Assert_(data.GroupSchedule->size() > 0);
+    TileBlockSizer sizer = { 0 };
+    ForEachTileBlock(data, 0, sizer);
+    return sizer.Size;
+}
+
+void CopyBakeGroupData(const BakeCheckpointData& data, uint64 scheduleIdx, uint8* dst)
+{
+    TileBlockCopier copier = { dst };
+    ForEachTileBlock(data, scheduleIdx, copier);
+}
+
+void StoreBakeGroupData(const BakeCheckpointData& data, uint64 scheduleIdx, const uint8* src)
+{
+    TileBlockStorer storer = { src };
+    ForEachTileBlock(data, scheduleIdx, storer);
+}
+
+int64 BakeBatchesPerGroup(const BakeCheckpointData& data)
+{
+    const uint64 numBakeGroups = data.GroupSchedule->size();
+    Assert_(numBakeGroups > 0 && data.NumBakeBatches % numBakeGroups == 0);
+    return int64(data.NumBakeBatches / numBakeGroups);
+}
+
+void ResetBakeGroupProgress(const BakeCheckpointData& data, bool complete)
+{
+    const uint64 numBakeGroups = data.GroupSchedule->size();
+    if(numBakeGroups == 0)
+        return;
+
+    const int64 groupBatches = complete ? BakeBatchesPerGroup(data) : 0;
+    for(uint64 i = 0; i < numBakeGroups; ++i)
+    {
+        BakeGroupProgress& progress = data.GroupProgress[i];
+        progress.ClaimedBatches = groupBatches;
+        progress.StartedBatches = groupBatches;
+        progress.FinishedBatches = groupBatches;
+        progress.RemoteBatches = 0;
+    }
+}
+
+int64 LoadBakeCheckpoint(const BakeCheckpointData& data)
+{
+    const std::wstring filePath = BakeCheckpointPath(data.Identity);
+    if(FileExists(filePath.c_str()) == false)
+        return -1;
+
+    const uint64 numBakeGroups = data.GroupSchedule->size();
+    if(numBakeGroups == 0)
+        return -1;
+
+    bool loadingResults = false;
+    try
+    {
+        FileReadSerializer serializer(filePath.c_str());
+        const uint64 fileSize = serializer.Size();
+        if(fileSize < sizeof(BakeCheckpointHeader))
+            return -1;
+
+        BakeCheckpointHeader header;
+        SerializeRawArray(serializer, &header, 1);
+        if(HeadersMatch(header, MakeHeader(data)) == false || header.FileSize() != fileSize)
+        {
+            PrintString("Ignoring out-of-date bake checkpoint");
+            return -1;
+        }
+
+        std::vector<IntegrationSamples> samples(header.NumSampleSets);
+        for(uint64 i = 0; i < header.NumSampleSets; ++i)
+        {
+            samples[i].Init(header.SampleSetPixels, header.SampleSetTypes, header.SampleSetSamples);
+            SerializeRawArray(serializer, samples[i].Samples.data(), header.SampleSetSize());
+        }
+
+        PagedArray<Float4> feedbackIrradiance;
+        if(header.NumFeedbackTexels > 0)
+        {
+            feedbackIrradiance.Init(header.NumFeedbackTexels, data.FeedbackIrradiance->OnDisk());
+            SerializeRawArray(serializer, feedbackIrradiance.Data(), header.NumFeedbackTexels);
+        }
+
+        loadingResults = true;
+        TileBlockReader reader = { serializer };
+        const int64 batchesPerGroup = BakeBatchesPerGroup(data);
+        int64 resumeBatch = 0;
+        for(uint64 i = 0; i < numBakeGroups; ++i)
+        {
+            int64 groupBatches = 0;
+            SerializeItem(serializer, groupBatches);
+            if(groupBatches < 0 || groupBatches > batchesPerGroup)
+                throw Exception(L"Bake checkpoint has an invalid batch count");
+
+            // The bake threads pick up each group from the first batch that isn't in the checkpoint
+            BakeGroupProgress& progress = data.GroupProgress[i];
+            progress.ClaimedBatches = groupBatches;
+            progress.StartedBatches = groupBatches;
+            progress.FinishedBatches = groupBatches;
+            progress.RemoteBatches = 0;
+            resumeBatch += groupBatches;
+
+            ForEachTileBlock(data, i, reader);
+        }
+
+        uint32 endMagic = 0;
+        SerializeItem(serializer, endMagic);
+        if(endMagic != CheckpointMagic)
+            throw Exception(L"Bake checkpoint is truncated");
+
+        data.Samples->swap(samples);
+        if(header.NumFeedbackTexels > 0)
+            data.FeedbackIrradiance->Swap(feedbackIrradiance);
+
+        PrintString("Resuming bake from checkpoint at batch %lld of %llu", resumeBatch, data.NumBakeBatches);
+
+        return resumeBatch;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to load bake checkpoint: %ls", e.GetMessage().c_str());
+
+        // A partially-loaded set of results can't be trusted, so the bake needs to start over
+        if(loadingResults == false)
+            return -1;
+
+        data.BakeResults->Init(data.BakeResults->LightMapSize(), data.BakeResults->BasisCount(), data.BakeResults->HasAccumulators(),
+                               data.BakeResults->OutOfCore());
+        if(data.CompositeResults != nullptr)
+            data.CompositeResults->Init(data.CompositeResults->LightMapSize(), data.CompositeResults->BasisCount(),
+                                        data.CompositeResults->HasAccumulators(), data.CompositeResults->OutOfCore());
+        ResetBakeGroupProgress(data, false);
+        return 0;
+    }
+}
+
+// Writes out everything except for the header. Returns false if the bake was restarted while
+// the checkpoint was being written.
+static bool WriteCheckpoint(FileWriteSerializer& serializer, const BakeCheckpointData& data)
+{
+    BakeCheckpointHeader header = MakeHeader(data);
+    SerializeRawArray(serializer, &header, 1);
+
+    const std::vector<IntegrationSamples>& samples = *data.Samples;
+    for(uint64 i = 0; i < samples.size(); ++i)
+    {
+        Assert_(samples[i].Samples.size() == header.SampleSetSize());
+        SerializeRawArray(serializer, const_cast<Float2*>(samples[i].Samples.data()), header.SampleSetSize());
+    }
+
+    if(header.NumFeedbackTexels > 0)
+        SerializeRawArray(serializer, data.FeedbackIrradiance->Data(), header.NumFeedbackTexels);
+
+    const uint64 numBakeGroups = header.NumBakeGroups;
+    const int64 batchesPerGroup = BakeBatchesPerGroup(data);
+    std::vector<uint8> tileData(header.TileDataSize());
+    for(uint64 i = 0; i < numBakeGroups; ++i)
+    {
+        BakeGroupProgress& progress = data.GroupProgress[i];
+
+        // Wait until every batch that's been claimed for this group has finished, and then
+        // make sure that no new batch started while the results were being copied. Batches that
+        // were leased to another process are left out, since they could take a long time to come
+        // back. A leased group is only ever leased whole and before any of its batches were
+        // claimed here, so it's written out with no batches and its results are still empty.
+        // RemoteBatches is only raised after ClaimedBatches and lowered before it, and it's read
+        // first here, so a lease that's being granted, merged or released can only show up as a
+        // batch count that StartedBatches and FinishedBatches don't match yet.
+        int64 groupBatches = 0;
+        while(true)
+        {
+            if(*data.CurrBakeTag != data.BakeTag)
+                return false;
+
+            const int64 remoteBatches = progress.RemoteBatches;
+            MemoryBarrier();
+            groupBatches = std::min(int64(progress.ClaimedBatches) - remoteBatches, batchesPerGroup);
+            const int64 startedBatches = progress.StartedBatches;
+            const int64 finishedBatches = progress.FinishedBatches;
+            if(startedBatches == groupBatches && finishedBatches == groupBatches)
+            {
+                TileBlockCopier copier = { tileData.data() };
+                ForEachTileBlock(data, i, copier);
+
+                MemoryBarrier();
+                if(progress.StartedBatches == startedBatches)
+                    break;
+            }
+
+            Sleep(0);
+        }
+
+        SerializeItem(serializer, groupBatches);
+        SerializeRawArray(serializer, tileData.data(), tileData.size());
+    }
+
+    uint32 endMagic = CheckpointMagic;
+    SerializeItem(serializer, endMagic);
+
+    return true;
+}
+
+BakeCheckpointWriter::~BakeCheckpointWriter()
+{
+    Wait();
+}
+
+void BakeCheckpointWriter::Start(const BakeCheckpointData& newData)
+{
+    Wait();
+
+    data = newData;
+    thread = HANDLE(_beginthreadex(nullptr, 0, WriterThread, &data, 0, nullptr));
+    if(thread == 0)
+    {
+        AssertFail_("Failed to create thread for writing a bake checkpoint");
+        throw Exception(L"Failed to create thread for writing a bake checkpoint");
+    }
+}
+
+void BakeCheckpointWriter::Wait()
+{
+    if(thread == nullptr)
+        return;
+
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    thread = nullptr;
+}
+
+bool BakeCheckpointWriter::Busy() const
+{
+    return thread != nullptr && WaitForSingleObject(thread, 0) == WAIT_TIMEOUT;
+}
+
+uint32 __stdcall BakeCheckpointWriter::WriterThread(void* context)
+{
+    const BakeCheckpointData& data = *reinterpret_cast<const BakeCheckpointData*>(context);
+
+    const std::wstring filePath = BakeCheckpointPath(data.Identity);
+    const std::wstring tempPath = filePath + L".tmp";
+
+    try
+    {
+        if(DirectoryExists(CheckpointDirectory) == false)
+            Win32Call(CreateDirectory(CheckpointDirectory, nullptr));
+
+        bool completed = false;
+        {
+            FileWriteSerializer serializer(tempPath.c_str());
+            completed = WriteCheckpoint(serializer, data);
+            serializer.Close();
+        }
+
+        if(completed)
+            Win32Call(MoveFileEx(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING));
+        else
+            DeleteFile(tempPath.c_str());
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to write bake checkpoint: %ls", e.GetMessage().c_str());
+        DeleteFile(tempPath.c_str());
+    }
+
+    return 0;
+}
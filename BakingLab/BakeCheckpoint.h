@@ -0,0 +1,152 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+#include <MurmurHash.h>
+
+#include "PathTracer.h"
+#include "BakeResultStore.h"
+#include "SharedConstants.h"
+
+using namespace SampleFramework11;
+
+// Progress counters for a single bake group, indexed by the group's position in the bake schedule.
+// Bake threads claim the group's batches in order by bumping ClaimedBatches, but only while
+// FinishedBatches matches it, so that no more than one batch of a group is ever in flight. They
+// then bump StartedBatches before they touch the group's results and FinishedBatches once they're
+// done with them, which lets the checkpoint writer find a moment where a group's results are
+// consistent without ever pausing the bake threads. Batches that were leased out to another process in a
+// distributed bake are included in ClaimedBatches, and also counted in RemoteBatches until their
+// results are merged back in, so that the checkpoint writer doesn't wait around for them.
+// RemoteBatches is never more than ClaimedBatches: it's raised after ClaimedBatches when a lease
+// is granted, and lowered before ClaimedBatches when a lease is released.
+struct BakeGroupProgress
+{
+    volatile int64 ClaimedBatches = 0;
+    volatile int64 StartedBatches = 0;
+    volatile int64 FinishedBatches = 0;
+    volatile int64 RemoteBatches = 0;
+};
+
+// Marks a group's results as being modified for the lifetime of the scope
+class BakeGroupWriteScope
+{
+
+public:
+
+    explicit BakeGroupWriteScope(BakeGroupProgress& progress_) : progress(progress_)
+    {
+        InterlockedIncrement64(&progress.StartedBatches);
+    }
+
+    ~BakeGroupWriteScope()
+    {
+        InterlockedIncrement64(&progress.FinishedBatches);
+    }
+
+private:
+
+    BakeGroupWriteScope(const BakeGroupWriteScope&);
+    BakeGroupWriteScope& operator=(const BakeGroupWriteScope&);
+
+    BakeGroupProgress& progress;
+};
+
+// Everything that goes into (or comes out of) a bake checkpoint
+struct BakeCheckpointData
+{
+    Hash Identity;
+    uint64 NumBakeBatches = 0;
+    const std::vector<uint32>* GroupSchedule = nullptr;
+    BakeGroupProgress* GroupProgress = nullptr;
+    BakeResultStore* BakeResults = nullptr;
+    BakeResultStore* CompositeResults = nullptr;            // null if this isn't a composite bake
+    std::vector<IntegrationSamples>* Samples = nullptr;
+    PagedArray<Float4>* FeedbackIrradiance = nullptr;
+
+    // The checkpoint writer gives up as soon as this no longer matches BakeTag
+    const volatile int64* CurrBakeTag = nullptr;
+    int64 BakeTag = 0;
+};
+
+// Computes a hash of the values of every setting that affects the bake results
+Hash ComputeBakeSettingsHash(uint32 seed);
+
+// Computes a hash of the bake points and every setting that affects the bake results. Only a
+// checkpoint with a matching identity can be resumed from.
+Hash ComputeBakeCheckpointIdentity(const PagedArray<BakePoint>& bakePoints);
+
+std::wstring BakeCheckpointPath(const Hash& identity);
+
+// Serializes the values of every setting that affects the bake results, so that they can be
+// applied in another process
+std::vector<uint8> SerializeBakeSettings();
+
+// Applies settings that were serialized with SerializeBakeSettings(), and throws if they came from
+// a build with a different set of settings
+void DeserializeBakeSettings(const uint8* data, uint64 size);
+
+// Hashes a block of data of any size. MurmurHash takes an int for the length, so anything bigger
+// than 256MB is hashed in pieces, and each piece's hash is chained onto the hash of the ones
+// before it. Anything smaller gets the same hash as GenerateHash().
+Hash GenerateLargeHash(const void* data, uint64 size, uint32 seed);
+
+// Returns the size of the results for a single bake group, which are laid out the same way as in
+// a checkpoint
+uint64 BakeGroupDataSize(const BakeCheckpointData& data);
+
+// Copies a group's results out to (or in from) a buffer of BakeGroupDataSize() bytes
+void CopyBakeGroupData(const BakeCheckpointData& data, uint64 scheduleIdx, uint8* dst);
+void StoreBakeGroupData(const BakeCheckpointData& data, uint64 scheduleIdx, const uint8* src);
+
+// Returns the number of batches that the bake threads hand out for each group
+int64 BakeBatchesPerGroup(const BakeCheckpointData& data);
+
+// Sets up the group progress counters for a bake that's either starting from scratch or already
+// complete, with nothing loaded from a checkpoint. This can only be called while the bake threads
+// are stopped.
+void ResetBakeGroupProgress(const BakeCheckpointData& data, bool complete);
+
+// Loads the results, integration samples and feedback light map from the checkpoint matching the
+// data's identity, and sets up the group progress counters so that the bake threads skip any
+// batches already contained in the checkpoint. Returns the total number of batches contained in
+// the checkpoint, or -1 if there's no usable checkpoint. This can only be called while the bake
+// threads are stopped.
+int64 LoadBakeCheckpoint(const BakeCheckpointData& data);
+
+// Writes checkpoints on a background thread while the bake threads keep running. Each group's
+// results are copied once its progress counters show that every batch claimed for it has finished,
+// and the number of batches that the copy contains is stored alongside it. The file is written under
+// a temporary name and then renamed, so a crash in the middle of a write leaves the previous
+// checkpoint intact.
+class BakeCheckpointWriter
+{
+
+public:
+
+    ~BakeCheckpointWriter();
+
+    // Everything referenced by the data needs to stay alive until Wait() returns
+    void Start(const BakeCheckpointData& data);
+    void Wait();
+
+    bool Busy() const;
+
+private:
+
+    static uint32 __stdcall WriterThread(void* context);
+
+    BakeCheckpointData data;
+    HANDLE thread = nullptr;
+};
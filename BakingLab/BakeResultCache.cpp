@@ -0,0 +1,311 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "BakeResultCache.h"
+
+#include <FileIO.h>
+#include <Serialization.h>
+#include <Utility.h>
+
+#include "AppSettings.h"
+#include "BakeCheckpoint.h"
+
+static const uint32 CacheMagic = 0x43524C42;        // "BLRC"
+static const uint32 CacheVersion = 2;
+static const wchar* CacheDirectory = L"BakeResultCache";
+static const wchar* CacheExtension = L".bakecache";
+
+// Sizes of everything stored in a cache entry, which is written at the start of the file so that
+// an entry can be validated before anything gets loaded from it
+struct BakeResultCacheHeader
+{
+    uint32 Magic = CacheMagic;
+    uint32 Version = CacheVersion;
+    Hash Key;
+    uint64 LightMapSize = 0;
+    uint64 BasisCount = 0;
+    uint64 CompositeBasisCount = 0;
+    uint64 SGCount = 0;
+    uint64 PlaneSize = 0;
+
+    uint64 FileSize() const
+    {
+        return sizeof(BakeResultCacheHeader) + sizeof(float) + SGCount * sizeof(Float3) +
+               PlaneSize * (BasisCount + CompositeBasisCount) * sizeof(Half4) + sizeof(uint32);
+    }
+};
+
+// Hashes everything that gets serialized, by chaining together the hashes of each block of data
+class HashSerializer
+{
+
+public:
+
+    Hash Result;
+
+    template<typename T> void SerializeItem(const T& data)
+    {
+        SerializeData(sizeof(T), &data);
+    }
+
+    void SerializeData(uint64 size, const void* data)
+    {
+        if(size == 0)
+            return;
+
+        const Hash hashes[2] = { Result, GenerateLargeHash(data, size, CacheVersion) };
+        Result = GenerateHash(hashes, int(sizeof(hashes)), CacheVersion);
+    }
+
+    static bool IsReadSerializer() { return false; }
+    static bool IsWriteSerializer() { return true; }
+};
+
+struct CacheEntryInfo
+{
+    std::wstring FilePath;
+    uint64 Size = 0;
+    uint64 LastUsed = 0;
+
+    bool operator<(const CacheEntryInfo& other) const
+    {
+        return LastUsed > other.LastUsed;
+    }
+};
+
+static std::wstring CacheEntryPath(const Hash& key)
+{
+    return std::wstring(CacheDirectory) + L"\\" + key.ToString() + CacheExtension;
+}
+
+static BakeResultCacheHeader MakeHeader(const Hash& key, const BakeResultCacheData& data)
+{
+    const BakeResultStore& bakeResults = *data.BakeResults;
+
+    BakeResultCacheHeader header;
+    header.Key = key;
+    header.LightMapSize = bakeResults.LightMapSize();
+    header.BasisCount = bakeResults.BasisCount();
+    header.CompositeBasisCount = data.CompositeResults ? data.CompositeResults->BasisCount() : 0;
+    header.SGCount = data.SGCount;
+    header.PlaneSize = bakeResults.PlaneSize();
+
+    return header;
+}
+
+static bool HeadersMatch(const BakeResultCacheHeader& header, const BakeResultCacheHeader& expected)
+{
+    return header.Magic == expected.Magic && header.Version == expected.Version &&
+           header.Key.A == expected.Key.A && header.Key.B == expected.Key.B &&
+           header.LightMapSize == expected.LightMapSize && header.BasisCount == expected.BasisCount &&
+           header.CompositeBasisCount == expected.CompositeBasisCount &&
+           header.SGCount == expected.SGCount && header.PlaneSize == expected.PlaneSize;
+}
+
+// Bumps the last write time of an entry, which is what the eviction order is based on. Last
+// access times aren't used, since they're often not updated by the file system.
+static void MarkEntryUsed(const std::wstring& filePath)
+{
+    HANDLE fileHandle = CreateFile(filePath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(fileHandle == INVALID_HANDLE_VALUE)
+        return;
+
+    SYSTEMTIME systemTime;
+    GetSystemTime(&systemTime);
+    FILETIME fileTime;
+    if(SystemTimeToFileTime(&systemTime, &fileTime))
+        SetFileTime(fileHandle, nullptr, nullptr, &fileTime);
+
+    CloseHandle(fileHandle);
+}
+
+// Deletes the least recently used entries until the cache fits within the budget. The entry that
+// was just written is always kept, even if it's bigger than the whole budget.
+static void EvictCacheEntries(const std::wstring& keepPath, uint64 maxCacheSize)
+{
+    std::vector<CacheEntryInfo> entries;
+
+    const std::wstring searchPath = std::wstring(CacheDirectory) + L"\\*" + CacheExtension;
+    WIN32_FIND_DATA findData;
+    HANDLE findHandle = FindFirstFile(searchPath.c_str(), &findData);
+    if(findHandle == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        if(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+        CacheEntryInfo entry;
+        entry.FilePath = std::wstring(CacheDirectory) + L"\\" + findData.cFileName;
+        entry.Size = findData.nFileSizeLow | (uint64(findData.nFileSizeHigh) << 32);
+        entry.LastUsed = findData.ftLastWriteTime.dwLowDateTime | (uint64(findData.ftLastWriteTime.dwHighDateTime) << 32);
+        entries.push_back(entry);
+    } while(FindNextFile(findHandle, &findData));
+
+    FindClose(findHandle);
+
+    std::sort(entries.begin(), entries.end());
+
+    uint64 totalSize = 0;
+    for(uint64 i = 0; i < entries.size(); ++i)
+    {
+        const CacheEntryInfo& entry = entries[i];
+        if(entry.FilePath == keepPath || totalSize + entry.Size <= maxCacheSize)
+        {
+            totalSize += entry.Size;
+            continue;
+        }
+
+        if(DeleteFile(entry.FilePath.c_str()))
+            PrintStringW(L"Evicted bake result cache entry %ls", entry.FilePath.c_str());
+        else
+            totalSize += entry.Size;
+    }
+}
+
+Hash ComputeBakeSceneHash(BVHData& bvhData)
+{
+    HashSerializer serializer;
+    bvhData.SerializeInput(serializer);
+    return serializer.Result;
+}
+
+Hash ComputeBakeResultCacheKey(const Hash& sceneHash)
+{
+    const Hash hashes[2] = { sceneHash, ComputeBakeSettingsHash(CacheVersion) };
+    return GenerateHash(hashes, int(sizeof(hashes)), CacheVersion);
+}
+
+bool BakeResultCacheContains(const Hash& key)
+{
+    return FileExists(CacheEntryPath(key).c_str());
+}
+
+bool LoadCachedBakeResults(const Hash& key, const BakeResultCacheData& data)
+{
+    const std::wstring filePath = CacheEntryPath(key);
+    if(FileExists(filePath.c_str()) == false)
+        return false;
+
+    BakeResultStore& bakeResults = *data.BakeResults;
+    bool loadingResults = false;
+    try
+    {
+        const BakeResultCacheHeader expected = MakeHeader(key, data);
+
+        {
+            FileReadSerializer serializer(filePath.c_str());
+            if(serializer.Size() != expected.FileSize())
+                throw Exception(L"Bake result cache entry has the wrong size");
+
+            BakeResultCacheHeader header;
+            SerializeRawArray(serializer, &header, 1);
+            if(HeadersMatch(header, expected) == false)
+                throw Exception(L"Bake result cache entry doesn't match the current bake");
+
+            // The SG lobes only change once the results are known to be good
+            float sgSharpness = 0.0f;
+            Float3 sgDirections[AppSettings::MaxSGCount];
+            Assert_(header.SGCount <= AppSettings::MaxSGCount);
+            SerializeItem(serializer, sgSharpness);
+            SerializeRawArray(serializer, sgDirections, header.SGCount);
+
+            loadingResults = true;
+            for(uint64 basisIdx = 0; basisIdx < header.BasisCount; ++basisIdx)
+                SerializeRawArray(serializer, bakeResults.BasisData(basisIdx), header.PlaneSize);
+
+            for(uint64 basisIdx = 0; basisIdx < header.CompositeBasisCount; ++basisIdx)
+                SerializeRawArray(serializer, data.CompositeResults->BasisData(basisIdx), header.PlaneSize);
+
+            uint32 endMagic = 0;
+            SerializeItem(serializer, endMagic);
+            if(endMagic != CacheMagic)
+                throw Exception(L"Bake result cache entry is truncated");
+
+            // Only the finished FP16 results are cached
+            bakeResults.ResetAccumulators();
+            if(data.CompositeResults != nullptr)
+                data.CompositeResults->ResetAccumulators();
+
+            *data.SGSharpness = sgSharpness;
+            for(uint64 i = 0; i < header.SGCount; ++i)
+                data.SGDirections[i] = sgDirections[i];
+        }
+
+        MarkEntryUsed(filePath);
+
+        PrintStringW(L"Loaded bake results from cache entry %ls", filePath.c_str());
+
+        return true;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to load bake result cache entry: %ls", e.GetMessage().c_str());
+        DeleteFile(filePath.c_str());
+
+        if(loadingResults)
+        {
+            bakeResults.Init(bakeResults.LightMapSize(), bakeResults.BasisCount(), bakeResults.HasAccumulators(), bakeResults.OutOfCore());
+            if(data.CompositeResults != nullptr)
+                data.CompositeResults->Init(data.CompositeResults->LightMapSize(), data.CompositeResults->BasisCount(),
+                                            data.CompositeResults->HasAccumulators(), data.CompositeResults->OutOfCore());
+        }
+
+        return false;
+    }
+}
+
+void StoreCachedBakeResults(const Hash& key, const BakeResultCacheData& data, uint64 maxCacheSize)
+{
+    const std::wstring filePath = CacheEntryPath(key);
+    const std::wstring tempPath = filePath + L".tmp";
+
+    try
+    {
+        if(DirectoryExists(CacheDirectory) == false)
+            Win32Call(CreateDirectory(CacheDirectory, nullptr));
+
+        {
+            BakeResultStore& bakeResults = *data.BakeResults;
+            BakeResultCacheHeader header = MakeHeader(key, data);
+
+            FileWriteSerializer serializer(tempPath.c_str());
+            SerializeRawArray(serializer, &header, 1);
+
+            float sgSharpness = *data.SGSharpness;
+            SerializeItem(serializer, sgSharpness);
+            SerializeRawArray(serializer, data.SGDirections, header.SGCount);
+
+            for(uint64 basisIdx = 0; basisIdx < header.BasisCount; ++basisIdx)
+                SerializeRawArray(serializer, bakeResults.BasisData(basisIdx), header.PlaneSize);
+
+            for(uint64 basisIdx = 0; basisIdx < header.CompositeBasisCount; ++basisIdx)
+                SerializeRawArray(serializer, data.CompositeResults->BasisData(basisIdx), header.PlaneSize);
+
+            uint32 endMagic = CacheMagic;
+            SerializeItem(serializer, endMagic);
+
+            serializer.Close();
+        }
+
+        Win32Call(MoveFileEx(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING));
+
+        EvictCacheEntries(filePath, maxCacheSize);
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to write bake result cache entry: %ls", e.GetMessage().c_str());
+        DeleteFile(tempPath.c_str());
+    }
+}
@@ -0,0 +1,50 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <MurmurHash.h>
+
+#include "PathTracer.h"
+#include "BakeResultStore.h"
+
+using namespace SampleFramework11;
+
+// Everything that goes into (or comes out of) a bake result cache entry. The result stores need
+// to be initialized with the size and basis count of the current bake before loading.
+struct BakeResultCacheData
+{
+    BakeResultStore* BakeResults = nullptr;
+    BakeResultStore* CompositeResults = nullptr;            // null if this isn't a composite bake
+    Float3* SGDirections = nullptr;
+    float* SGSharpness = nullptr;
+    uint64 SGCount = 0;
+};
+
+// Computes a hash of the flattened geometry and material texels that the BVH was built from, so
+// that cache entries follow the contents of a scene rather than its file name
+Hash ComputeBakeSceneHash(BVHData& bvhData);
+
+// Combines the scene hash with the values of every setting that affects the bake results
+Hash ComputeBakeResultCacheKey(const Hash& sceneHash);
+
+bool BakeResultCacheContains(const Hash& key);
+
+// Loads the results of a finished bake from the cache entry matching the key, and marks the entry
+// as the most recently used one. Returns false if there's no usable entry. An entry that fails to
+// load is deleted, and any results that were partially loaded from it are cleared.
+bool LoadCachedBakeResults(const Hash& key, const BakeResultCacheData& data);
+
+// Writes the results of a finished bake to the cache, and then deletes the least recently used
+// entries until the cache fits within the size budget. The entry is written under a temporary
+// name and then renamed, so that a crash in the middle of a write can't leave a truncated entry.
+void StoreCachedBakeResults(const Hash& key, const BakeResultCacheData& data, uint64 maxCacheSize);
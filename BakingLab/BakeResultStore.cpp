@@ -0,0 +1,102 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "BakeResultStore.h"
+
+void BakeResultStore::Init(uint64 newLightMapSize, uint64 newBasisCount, bool accumulate, bool outOfCore)
+{
+    Assert_(newLightMapSize > 0);
+    Assert_(newBasisCount > 0);
+
+    lightMapSize = newLightMapSize;
+    basisCount = newBasisCount;
+
+    // Partial tiles along the right and bottom edges are padded out to a full tile
+    numTilesX = (lightMapSize + (TileSizeX - 1)) / TileSizeX;
+    numTilesY = (lightMapSize + (TileSizeY - 1)) / TileSizeY;
+    planeSize = numTilesX * numTilesY * TileSize;
+
+    // The planes start out zeroed, which is a zero Half4 and a zero Float4
+    coefficients.Init(planeSize * basisCount, outOfCore);
+    if(accumulate)
+        accumulators.Init(planeSize * basisCount, outOfCore);
+    else
+        accumulators.Shutdown();
+
+    dirtyTiles.Init(numTilesX * numTilesY, 0);
+}
+
+void BakeResultStore::Shutdown()
+{
+    coefficients.Shutdown();
+    accumulators.Shutdown();
+    dirtyTiles.Shutdown();
+    lightMapSize = 0;
+    basisCount = 0;
+    numTilesX = 0;
+    numTilesY = 0;
+    planeSize = 0;
+}
+
+void BakeResultStore::CopyBasis(uint64 dstBasisIdx, const BakeResultStore& src, uint64 srcBasisIdx)
+{
+    Assert_(src.lightMapSize == lightMapSize);
+    memcpy(BasisData(dstBasisIdx), src.BasisData(srcBasisIdx), planeSize * sizeof(Half4));
+
+    if(HasAccumulators())
+    {
+        Float4* dstAccumulators = AccumulatorData(dstBasisIdx);
+        if(src.HasAccumulators())
+        {
+            memcpy(dstAccumulators, src.accumulators.Data() + srcBasisIdx * planeSize, planeSize * sizeof(Float4));
+        }
+        else
+        {
+            const Half4* srcData = src.BasisData(srcBasisIdx);
+            for(uint64 i = 0; i < planeSize; ++i)
+                dstAccumulators[i] = srcData[i].ToFloat4();
+        }
+    }
+}
+
+void BakeResultStore::ResetAccumulators()
+{
+    for(uint64 basisIdx = 0; basisIdx < basisCount && HasAccumulators(); ++basisIdx)
+    {
+        const Half4* srcData = BasisData(basisIdx);
+        Float4* dstAccumulators = AccumulatorData(basisIdx);
+        for(uint64 i = 0; i < planeSize; ++i)
+            dstAccumulators[i] = srcData[i].ToFloat4();
+    }
+}
+
+void BakeResultStore::CopyTileRows(uint64 basisIdx, uint64 tileX, uint64 tileY, uint64 runLength,
+                                   Half4* dst, uint64 dstRowPitch) const
+{
+    Assert_(tileX + runLength <= numTilesX && tileY < numTilesY);
+
+    const Half4* src = BasisData(basisIdx);
+    const uint64 startX = tileX * TileSizeX;
+    const uint64 startY = tileY * TileSizeY;
+    const uint64 numRows = std::min(TileSizeY, lightMapSize - startY);
+    for(uint64 row = 0; row < numRows; ++row)
+    {
+        const uint64 rowOffset = row * TileSizeX;
+        uint8* dstRow = reinterpret_cast<uint8*>(dst) + row * dstRowPitch;
+        for(uint64 i = 0; i < runLength; ++i)
+        {
+            const uint64 x = (tileX + i) * TileSizeX;
+            const uint64 numTexels = std::min(TileSizeX, lightMapSize - x);
+            memcpy(dstRow + (x - startX) * sizeof(Half4), src + TileOffset(tileX + i, tileY) + rowOffset, numTexels * sizeof(Half4));
+        }
+    }
+}
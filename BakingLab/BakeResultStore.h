@@ -0,0 +1,144 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+
+#include "PagedArray.h"
+
+using namespace SampleFramework11;
+
+// Compact storage for the baked light map results. Every basis is stored as FP16 in its own
+// plane, with the texels of each plane laid out in 8x8 tiles that line up with the bake groups.
+// This way a bake thread working on a group only touches a small contiguous block of each plane.
+// Progressive bakes keep updating a running mean for every texel, and late in the bake each
+// update moves the mean by less than an FP16 ulp. Those get a full FP32 accumulation plane per
+// basis that Load() and Store() work with, and the FP16 planes just hold a copy of it for
+// uploading and saving the finished results.
+// Each tile also has a dirty flag, so that only the tiles that changed need to be uploaded.
+// For light maps that don't fit in memory, the planes can be kept in paging files on disk instead.
+// Since each tile is contiguous, only the tiles that are being baked need to stay resident.
+class BakeResultStore
+{
+
+public:
+
+    static const uint64 TileSizeX = 8;
+    static const uint64 TileSizeY = 8;
+    static const uint64 TileSize = TileSizeX * TileSizeY;
+
+    void Init(uint64 lightMapSize, uint64 basisCount, bool accumulate, bool outOfCore = false);
+    void Shutdown();
+
+    bool Initialized() const { return basisCount > 0; }
+    bool HasAccumulators() const { return accumulators.Size() > 0; }
+    bool OutOfCore() const { return coefficients.OnDisk(); }
+    uint64 LightMapSize() const { return lightMapSize; }
+    uint64 BasisCount() const { return basisCount; }
+    uint64 NumTilesX() const { return numTilesX; }
+    uint64 NumTilesY() const { return numTilesY; }
+    uint64 NumTiles() const { return numTilesX * numTilesY; }
+    uint64 PlaneSize() const { return planeSize; }
+    uint64 MemorySize() const { return coefficients.Size() * sizeof(Half4) + accumulators.Size() * sizeof(Float4); }
+
+    // Returns the offset of the first texel in a tile, with the tiles in row-major order
+    uint64 TileOffset(uint64 tileX, uint64 tileY) const
+    {
+        return (tileY * numTilesX + tileX) * TileSize;
+    }
+
+    // Returns the offset of a texel within a basis plane
+    uint64 TexelOffset(uint64 x, uint64 y) const
+    {
+        Assert_(x < lightMapSize && y < lightMapSize);
+        return TileOffset(x / TileSizeX, y / TileSizeY) + (y % TileSizeY) * TileSizeX + (x % TileSizeX);
+    }
+
+    Half4* BasisData(uint64 basisIdx)
+    {
+        Assert_(basisIdx < basisCount);
+        return coefficients.Data() + basisIdx * planeSize;
+    }
+
+    const Half4* BasisData(uint64 basisIdx) const
+    {
+        Assert_(basisIdx < basisCount);
+        return coefficients.Data() + basisIdx * planeSize;
+    }
+
+    // Returns null if the store doesn't have accumulation planes
+    Float4* AccumulatorData(uint64 basisIdx)
+    {
+        Assert_(basisIdx < basisCount);
+        return HasAccumulators() ? accumulators.Data() + basisIdx * planeSize : nullptr;
+    }
+
+    // Loads a texel at full precision if there's an accumulation plane
+    Float4 Load(uint64 basisIdx, uint64 texelOffset) const
+    {
+        if(HasAccumulators())
+            return accumulators[basisIdx * planeSize + texelOffset];
+        return BasisData(basisIdx)[texelOffset].ToFloat4();
+    }
+
+    void Store(uint64 basisIdx, uint64 texelOffset, const Float4& value)
+    {
+        BasisData(basisIdx)[texelOffset] = Half4(value);
+        if(HasAccumulators())
+            accumulators[basisIdx * planeSize + texelOffset] = value;
+    }
+
+    // Updates the accumulation plane without touching the FP16 copy
+    void StoreAccumulator(uint64 basisIdx, uint64 texelOffset, const Float4& value)
+    {
+        Assert_(HasAccumulators());
+        accumulators[basisIdx * planeSize + texelOffset] = value;
+    }
+
+    // Copies a basis plane from another store with the same light map size
+    void CopyBasis(uint64 dstBasisIdx, const BakeResultStore& src, uint64 srcBasisIdx);
+
+    // Refills the accumulation planes from the FP16 planes, for when only those were loaded
+    void ResetAccumulators();
+
+    // Writes a horizontal run of tiles from a basis plane out in row-major order, which is what
+    // the light map textures expect. Texels past the edge of the light map are skipped.
+    void CopyTileRows(uint64 basisIdx, uint64 tileX, uint64 tileY, uint64 runLength,
+                      Half4* dst, uint64 dstRowPitch) const;
+
+    // Called by the bake threads once they're done writing to a tile
+    void MarkTileDirty(uint64 tileIdx)
+    {
+        Assert_(tileIdx < NumTiles());
+        reinterpret_cast<volatile int64*>(dirtyTiles.Data())[tileIdx] = 1;
+    }
+
+    // Clears a tile's dirty flag, and returns whether it was set. The flag is cleared before the
+    // tile gets read, so a bake thread that writes to the tile in the meantime will set it again.
+    bool ClearTileDirty(uint64 tileIdx)
+    {
+        Assert_(tileIdx < NumTiles());
+        return InterlockedExchange64(reinterpret_cast<volatile int64*>(dirtyTiles.Data()) + tileIdx, 0) != 0;
+    }
+
+private:
+
+    uint64 lightMapSize = 0;
+    uint64 basisCount = 0;
+    uint64 numTilesX = 0;
+    uint64 numTilesY = 0;
+    uint64 planeSize = 0;
+    PagedArray<Half4> coefficients;
+    PagedArray<Float4> accumulators;
+    FixedArray<int64> dirtyTiles;
+};
@@ -137,7 +137,6 @@ static void LoadLightSettings(HWND parentWindow)
             std::vector<SettingInfo> settingInfo;
             SerializeItem(serializer, settingInfo);
 
-            uint8 dummyBuffer[1024] = { 0 };
             for(uint64 i = 0; i < settingInfo.size(); ++i)
             {
                 const SettingInfo& info = settingInfo[i];
@@ -145,9 +144,7 @@ static void LoadLightSettings(HWND parentWindow)
                 if(setting == nullptr || setting->SerializedValueSize() != info.DataSize)
                 {
                     // Skip the data for this setting, it's out-of-date
-                    Assert_(info.DataSize <= sizeof(dummyBuffer));
-                    if(info.DataSize > 0)
-                        serializer.SerializeData(info.DataSize, dummyBuffer);
+                    serializer.Seek(serializer.Offset() + info.DataSize);
                     continue;
                 }
 
@@ -208,6 +205,8 @@ static void SaveLightSettings(HWND parentWindow)
 
             for(uint64 i = 0; i < NumLightSettings; ++i)
                 LightSettings[i]->SerializeValue(serializer);
+
+            serializer.Close();
         }
         catch(Exception e)
         {
@@ -272,6 +271,51 @@ static void SaveEXRScreenshot(HWND parentWindow, ID3D11ShaderResourceView* scree
     }
 }
 
+// Save every basis of the light map to a single multi-part EXR file
+static void ExportLightMap(HWND parentWindow, ID3D11ShaderResourceView* lightMapSRV, MeshBaker& meshBaker)
+{
+    if(lightMapSRV == nullptr)
+    {
+        MessageBox(parentWindow, L"There's no baked light map to export", L"Error", MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    wchar currDirectory[MAX_PATH] = { 0 };
+    GetCurrentDirectory(ArraySize_(currDirectory), currDirectory);
+
+    wchar filePath[MAX_PATH] = { 0 };
+
+    OPENFILENAME ofn;
+    ZeroMemory(&ofn , sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = parentWindow;
+    ofn.lpstrFile = filePath;
+    ofn.nMaxFile = ArraySize_(filePath);
+    ofn.lpstrFilter = L"All Files (*.*)\0*.*\0EXR Files (*.exr)\0*.exr\0";
+    ofn.nFilterIndex = 2;
+    ofn.lpstrFileTitle = nullptr;
+    ofn.nMaxFileTitle = 0;
+    ofn.lpstrInitialDir = nullptr;
+    ofn.lpstrTitle = L"Export Light Map As..";
+    ofn.lpstrDefExt = L"exr";
+    ofn.Flags = OFN_OVERWRITEPROMPT;
+    bool succeeded = GetSaveFileName(&ofn) != 0;
+    SetCurrentDirectory(currDirectory);
+
+    if(succeeded)
+    {
+        try
+        {
+            meshBaker.ExportLightMap(filePath);
+        }
+        catch(Exception e)
+        {
+            std::wstring errorString = L"Error occured while exporting the light map:\n" + e.GetMessage();
+            MessageBox(parentWindow, errorString.c_str(), L"Error", MB_OK | MB_ICONERROR);
+        }
+    }
+}
+
 // Bakes lookup textures for computing environment specular from radiance encoded as spherical harmonics.
 static void GenerateSHSpecularLookupTextures(ID3D11Device* device)
 {
@@ -514,11 +558,12 @@ void BakingLab::Initialize()
         if(GetFileExtension(ScenePaths[i]) == L"meshdata")
             sceneModels[i].CreateFromMeshData(device, ScenePaths[i], true);
         else
-            sceneModels[i].CreateWithAssimp(device, ScenePaths[i], true);
+            sceneCaches[i].Initialize(device, ScenePaths[i], sceneModels[i], true);
     }
 
     Model& currentModel = sceneModels[AppSettings::CurrentScene.Value()];
     meshRenderer.Initialize(device, deviceManager.ImmediateContext(), &currentModel);
+    displayedScene = uint64(AppSettings::CurrentScene.Value());
 
     camera.SetPosition(Float3(0.0f, 2.5f, -15.0f));
 
@@ -548,11 +593,22 @@ void BakingLab::Initialize()
 
     BakeInputData bakeInput;
     bakeInput.SceneModel = &currentModel;
+    bakeInput.SceneModelCache = &sceneCaches[AppSettings::CurrentScene.Value()];
     bakeInput.Device = device;
     for(uint64 i = 0; i < AppSettings::NumCubeMaps; ++i)
         bakeInput.EnvMaps[i] = envMaps[i];
     meshBaker.Initialize(bakeInput);
 
+    // "-bakeworker [host[:port]]" starts the app up as a distributed bake worker
+    const BakeWorkerArgs workerArgs = ParseBakeWorkerArgs(GetCommandLine());
+    if(workerArgs.Enabled)
+    {
+        meshBaker.bakeCoordinatorHost = workerArgs.CoordinatorHost;
+        if(workerArgs.Port != 0)
+            AppSettings::DistributedBakePort.SetValue(int32(workerArgs.Port));
+        AppSettings::DistributedBakeMode.SetValue(DistributedBakeModes::Worker);
+    }
+
     // Camera setup
     AppSettings::UpdateHorizontalCoords();
 }
@@ -587,9 +643,12 @@ void BakingLab::Update(const Timer& timer)
     if(AppSettings::SaveLightSettings)
         SaveLightSettings(window.GetHwnd());
 
-    if(AppSettings::CurrentScene.Changed())
+    // A newly-selected scene only gets displayed once the baker has swapped in its BVH, so that
+    // the old scene and its light map stay on screen while the BVH is being built
+    const uint64 currSceneIdx = uint64(meshBaker.input.SceneModel - sceneModels);
+    if(currSceneIdx != displayedScene)
     {
-        uint64 currSceneIdx = uint64(AppSettings::CurrentScene);
+        displayedScene = currSceneIdx;
         meshRenderer.SetModel(&sceneModels[currSceneIdx]);
         camera.SetPosition(SceneCameraPositions[currSceneIdx]);
         camera.SetXRotation(SceneCameraRotations[currSceneIdx].x);
@@ -689,7 +748,8 @@ void BakingLab::Render(const Timer& timer)
     ID3D11DeviceContextPtr context = deviceManager.ImmediateContext();
 
     MeshBakerStatus status = meshBaker.Update(unJitteredCamera, colorTargetMSAA.Width, colorTargetMSAA.Height,
-                                              context, &sceneModels[AppSettings::CurrentScene]);
+                                              context, &sceneModels[AppSettings::CurrentScene],
+                                              &sceneCaches[AppSettings::CurrentScene]);
 
     if(AppSettings::ShowGroundTruth)
     {
@@ -719,6 +779,9 @@ void BakingLab::Render(const Timer& timer)
     if(AppSettings::SaveEXRScreenshot)
         SaveEXRScreenshot(window.GetHwnd(), colorResolveTarget.SRView);
 
+    if(AppSettings::ExportLightMap)
+        ExportLightMap(window.GetHwnd(), status.LightMap, meshBaker);
+
     {
         // Kick off post-processing
         PIXEvent ppEvent(L"Post Processing");
@@ -955,7 +1018,9 @@ void BakingLab::RenderHUD(const Timer& timer, float groundTruthProgress, float b
 
         if(AppSettings::ShowGroundTruth)
         {
-            texel = meshBaker.renderBuffer[mouseState.Y * colorTargetMSAA.Width + mouseState.X];
+            const RenderResultStore& renderResults = meshBaker.renderResults;
+            if(uint64(mouseState.X) < renderResults.Width() && uint64(mouseState.Y) < renderResults.Height())
+                texel = renderResults.Resolve(mouseState.X, mouseState.Y);
         }
         else
         {
@@ -25,6 +25,7 @@
 #include "PostProcessor.h"
 #include "MeshRenderer.h"
 #include "MeshBaker.h"
+#include "SceneCache.h"
 
 using namespace SampleFramework11;
 
@@ -50,8 +51,10 @@ protected:
 
     // Model
     Model sceneModels[uint64(Scenes::NumValues)];
+    SceneCache sceneCaches[uint64(Scenes::NumValues)];
     MeshRenderer meshRenderer;
     MeshBaker meshBaker;
+    uint64 displayedScene = 0;
 
     MouseState mouseState;
 
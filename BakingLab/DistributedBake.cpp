@@ -0,0 +1,965 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "DistributedBake.h"
+
+#include <ws2tcpip.h>
+#include <shellapi.h>
+
+#include <Exceptions.h>
+#include <Serialization.h>
+#include <Utility.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+static const uint32 MessageMagic = 0x4D44424C;          // "LBDM"
+static const uint64 ProtocolVersion = 2;
+
+// Messages bigger than this are assumed to be garbage
+static const uint64 MaxMessageSize = 256 * 1024 * 1024;
+
+// Number of bake groups in a single lease
+static const uint64 LeaseSize = 64;
+
+// Each worker gets a second lease to start on while the results of the first one are on their way back
+static const uint64 MaxLeasesPerWorker = 2;
+
+// Milliseconds between attempts to connect to the coordinator
+static const uint64 ReconnectInterval = 2000;
+
+// Both ends send a heartbeat whenever they haven't sent anything else for a while, and drop the
+// connection once nothing at all has arrived for much longer than that. TCP keep-alives take
+// hours to notice a machine that went away, and never notice a process that hung.
+static const uint64 HeartbeatInterval = 5000;
+static const uint64 ConnectionTimeout = 60000;
+
+static const uint64 MaxSendSize = 1024 * 1024;
+static const uint64 ReceiveChunkSize = 64 * 1024;
+
+enum class BakeMessageType : uint32
+{
+    Settings = 0,               // coordinator -> worker: serialized bake settings
+    Hello = 1,                  // worker -> coordinator: BakeWorkerHello, sent whenever its bake restarts
+    Lease = 2,                  // coordinator -> worker: BakeLeaseHeader + light map group indices
+    LeaseResults = 3,           // worker -> coordinator: BakeLeaseHeader + light map group indices + group data
+    Heartbeat = 4,              // either way: nothing, only keeps the connection from timing out
+};
+
+// Messages are serialized one field at a time rather than copied as structs, so that their
+// layout doesn't depend on how the compiler packs them. Every field is a fixed-size little-endian
+// integer, which is the byte order of everything that BakingLab runs on.
+struct BakeMessageHeader
+{
+    uint32 Magic = MessageMagic;
+    uint32 Type = 0;
+    uint64 Size = 0;
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, Magic);
+        SerializeItem(serializer, Type);
+        SerializeItem(serializer, Size);
+    }
+};
+
+static const uint64 MessageHeaderSize = sizeof(uint32) * 2 + sizeof(uint64);
+
+// The protocol version always comes first, so that it can be checked before anything else is read
+struct BakeWorkerHello
+{
+    uint64 ProtocolVersion = ::ProtocolVersion;
+    uint64 HelloID = 0;
+    Hash Key;
+    uint64 NumBakeGroups = 0;
+    int64 BatchesPerGroup = 0;
+    uint64 GroupDataSize = 0;
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, ProtocolVersion);
+        if(ProtocolVersion != ::ProtocolVersion)
+            return;
+
+        SerializeItem(serializer, HelloID);
+        SerializeItem(serializer, Key.A);
+        SerializeItem(serializer, Key.B);
+        SerializeItem(serializer, NumBakeGroups);
+        SerializeItem(serializer, BatchesPerGroup);
+        SerializeItem(serializer, GroupDataSize);
+    }
+};
+
+// Leases are tagged with the worker's last hello, so that a worker can tell which leases were
+// sent before the coordinator found out that its bake restarted
+struct BakeLeaseHeader
+{
+    uint64 LeaseID = 0;
+    uint64 HelloID = 0;
+    uint64 NumGroups = 0;
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, LeaseID);
+        SerializeItem(serializer, HelloID);
+        SerializeItem(serializer, NumGroups);
+    }
+};
+
+static bool HashesMatch(const Hash& a, const Hash& b)
+{
+    return a.A == b.A && a.B == b.B;
+}
+
+// Builds the mapping from light map group index to schedule index
+static void BuildGroupScheduleIndices(const DistributedBakeData& data, std::vector<uint32>& groupScheduleIndices)
+{
+    const std::vector<uint32>& groupSchedule = *data.Bake.GroupSchedule;
+    groupScheduleIndices.assign(data.Bake.BakeResults->NumTiles(), uint32(-1));
+    for(uint64 i = 0; i < groupSchedule.size(); ++i)
+        groupScheduleIndices[groupSchedule[i]] = uint32(i);
+}
+
+BakeWorkerArgs ParseBakeWorkerArgs(const wchar* commandLine)
+{
+    BakeWorkerArgs args;
+
+    int numArgs = 0;
+    wchar** argv = CommandLineToArgvW(commandLine, &numArgs);
+    if(argv == nullptr)
+        return args;
+
+    for(int i = 1; i < numArgs; ++i)
+    {
+        if(_wcsicmp(argv[i], L"-bakeworker") != 0)
+            continue;
+
+        args.Enabled = true;
+        if(i + 1 < numArgs && argv[i + 1][0] != L'-')
+        {
+            std::string address = WStringToAnsi(argv[i + 1]);
+            const size_t portStart = address.rfind(':');
+            if(portStart != std::string::npos)
+            {
+                args.Port = uint32(atoi(address.c_str() + portStart + 1));
+                address.resize(portStart);
+            }
+
+            if(address.empty() == false)
+                args.CoordinatorHost = address;
+        }
+
+        break;
+    }
+
+    LocalFree(argv);
+
+    return args;
+}
+
+// == BakeConnection ==============================================================================
+
+void BakeConnection::Open(SOCKET newSocket)
+{
+    Close();
+    socket = newSocket;
+    lastSendTime = GetTickCount64();
+    lastReceiveTime = lastSendTime;
+
+    u_long nonBlocking = 1;
+    ioctlsocket(socket, FIONBIO, &nonBlocking);
+
+    // Leases are tiny, and shouldn't be held back waiting for more data to go along with them
+    BOOL noDelay = TRUE;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+    // Lets the connection time out if the machine on the other end goes away without closing it
+    BOOL keepAlive = TRUE;
+    setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&keepAlive), sizeof(keepAlive));
+}
+
+void BakeConnection::Connect(const std::string& host, uint32 port)
+{
+    Close();
+
+    // The coordinator only listens on IPv4
+    addrinfo hints = { };
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* addresses = nullptr;
+    const std::string portString = MakeAnsiString("%u", port);
+    const int resolveError = getaddrinfo(host.c_str(), portString.c_str(), &hints, &addresses);
+    if(resolveError != 0)
+    {
+        std::wstring errPrefix = L"Failed to resolve " + AnsiToWString(host.c_str()) + L":\n";
+        throw Win32Exception(resolveError, errPrefix.c_str());
+    }
+
+    SOCKET newSocket = ::socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if(newSocket == INVALID_SOCKET)
+    {
+        const int errorCode = WSAGetLastError();
+        freeaddrinfo(addresses);
+        throw Win32Exception(errorCode, L"Failed to create a socket:\n");
+    }
+
+    Open(newSocket);
+
+    const int result = connect(socket, addresses->ai_addr, int(addresses->ai_addrlen));
+    const int errorCode = WSAGetLastError();
+    freeaddrinfo(addresses);
+    if(result == SOCKET_ERROR && errorCode != WSAEWOULDBLOCK)
+    {
+        Close();
+        throw Win32Exception(errorCode, L"Failed to connect to the bake coordinator:\n");
+    }
+
+    connecting = true;
+}
+
+void BakeConnection::Close()
+{
+    if(socket != INVALID_SOCKET)
+        closesocket(socket);
+
+    socket = INVALID_SOCKET;
+    connecting = false;
+    sendBuffer.clear();
+    sendOffset = 0;
+    receiveBuffer.clear();
+    receiveOffset = 0;
+}
+
+void BakeConnection::Send(uint32 type, const void* data, uint64 size)
+{
+    Assert_(size <= MaxMessageSize);
+
+    BakeMessageHeader header;
+    header.Type = type;
+    header.Size = size;
+
+    ByteArraySerializer serializer;
+    SerializeItem(serializer, header);
+    Assert_(serializer.Bytes.size() == MessageHeaderSize);
+
+    const uint8* dataBytes = reinterpret_cast<const uint8*>(data);
+    sendBuffer.insert(sendBuffer.end(), serializer.Bytes.begin(), serializer.Bytes.end());
+    sendBuffer.insert(sendBuffer.end(), dataBytes, dataBytes + size);
+    lastSendTime = GetTickCount64();
+}
+
+bool BakeConnection::Pump()
+{
+    if(socket == INVALID_SOCKET)
+        return false;
+
+    if(connecting)
+    {
+        fd_set writeSet;
+        fd_set errorSet;
+        FD_ZERO(&writeSet);
+        FD_ZERO(&errorSet);
+        FD_SET(socket, &writeSet);
+        FD_SET(socket, &errorSet);
+
+        timeval timeout = { 0, 0 };
+        if(select(0, nullptr, &writeSet, &errorSet, &timeout) == SOCKET_ERROR || FD_ISSET(socket, &errorSet))
+            return false;
+
+        if(FD_ISSET(socket, &writeSet) == false)
+            return true;
+
+        connecting = false;
+        lastSendTime = GetTickCount64();
+        lastReceiveTime = lastSendTime;
+    }
+
+    const uint64 currTime = GetTickCount64();
+    if(currTime - lastReceiveTime >= ConnectionTimeout)
+        throw Exception(L"The connection timed out");
+    if(currTime - lastSendTime >= HeartbeatInterval)
+        Send(uint32(BakeMessageType::Heartbeat), nullptr, 0);
+
+    while(sendOffset < sendBuffer.size())
+    {
+        const int sendSize = int(std::min<uint64>(sendBuffer.size() - sendOffset, MaxSendSize));
+        const int sent = send(socket, reinterpret_cast<const char*>(sendBuffer.data() + sendOffset), sendSize, 0);
+        if(sent == SOCKET_ERROR)
+        {
+            if(WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+            return false;
+        }
+
+        sendOffset += sent;
+    }
+
+    // Throw away the part that was sent once it's taking up most of the buffer
+    if(sendOffset > 0 && sendOffset * 2 >= sendBuffer.size())
+    {
+        sendBuffer.erase(sendBuffer.begin(), sendBuffer.begin() + sendOffset);
+        sendOffset = 0;
+    }
+
+    uint8 chunk[ReceiveChunkSize];
+    while(true)
+    {
+        const int received = recv(socket, reinterpret_cast<char*>(chunk), int(sizeof(chunk)), 0);
+        if(received == 0)
+            return false;
+
+        if(received == SOCKET_ERROR)
+        {
+            if(WSAGetLastError() == WSAEWOULDBLOCK)
+                break;
+            return false;
+        }
+
+        receiveBuffer.insert(receiveBuffer.end(), chunk, chunk + received);
+        lastReceiveTime = GetTickCount64();
+    }
+
+    return true;
+}
+
+bool BakeConnection::Receive(uint32& type, std::vector<uint8>& payload)
+{
+    do
+    {
+        if(ReceiveMessage(type, payload) == false)
+            return false;
+    }
+    while(type == uint32(BakeMessageType::Heartbeat));
+
+    return true;
+}
+
+bool BakeConnection::ReceiveMessage(uint32& type, std::vector<uint8>& payload)
+{
+    const uint64 available = receiveBuffer.size() - receiveOffset;
+    if(available < MessageHeaderSize)
+        return false;
+
+    BakeMessageHeader header;
+    MemoryReadSerializer serializer(receiveBuffer.data() + receiveOffset, MessageHeaderSize);
+    SerializeItem(serializer, header);
+    if(header.Magic != MessageMagic || header.Size > MaxMessageSize)
+        throw Exception(L"Received an invalid message");
+
+    if(available - MessageHeaderSize < header.Size)
+        return false;
+
+    const uint8* payloadStart = receiveBuffer.data() + receiveOffset + MessageHeaderSize;
+    payload.assign(payloadStart, payloadStart + header.Size);
+    type = header.Type;
+
+    receiveOffset += MessageHeaderSize + header.Size;
+    if(receiveOffset * 2 >= receiveBuffer.size())
+    {
+        receiveBuffer.erase(receiveBuffer.begin(), receiveBuffer.begin() + receiveOffset);
+        receiveOffset = 0;
+    }
+
+    return true;
+}
+
+// == BakeCoordinator =============================================================================
+
+BakeCoordinator::~BakeCoordinator()
+{
+    Shutdown();
+}
+
+void BakeCoordinator::Start(uint32 port)
+{
+    Shutdown();
+
+    WSADATA wsaData;
+    const int startupError = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if(startupError != 0)
+        throw Win32Exception(startupError, L"Failed to initialize Winsock:\n");
+
+    SOCKET newSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(newSocket == INVALID_SOCKET)
+    {
+        const int errorCode = WSAGetLastError();
+        WSACleanup();
+        throw Win32Exception(errorCode, L"Failed to create a socket:\n");
+    }
+
+    sockaddr_in address = { };
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(u_short(port));
+
+    u_long nonBlocking = 1;
+    if(bind(newSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+       listen(newSocket, SOMAXCONN) == SOCKET_ERROR || ioctlsocket(newSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+    {
+        const int errorCode = WSAGetLastError();
+        closesocket(newSocket);
+        WSACleanup();
+        std::wstring errPrefix = MakeString(L"Failed to listen for bake workers on port %u:\n", port);
+        throw Win32Exception(errorCode, errPrefix.c_str());
+    }
+
+    listenSocket = newSocket;
+    bakeTag = -1;
+    bakeKey = Hash();
+    settingsData.clear();
+
+    PrintString("Listening for bake workers on port %u", port);
+}
+
+// Leases that are still out don't get released here, so the bake needs to restart afterwards
+void BakeCoordinator::Shutdown()
+{
+    if(Running() == false)
+        return;
+
+    for(uint64 i = 0; i < workers.size(); ++i)
+        workers[i].Connection.Close();
+    workers.clear();
+
+    closesocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+    WSACleanup();
+}
+
+void BakeCoordinator::Update(const DistributedBakeData* data)
+{
+    if(Running() == false)
+        return;
+
+    if(data != nullptr && data->Bake.BakeTag != bakeTag)
+    {
+        // The group progress counters were reset along with the bake, so the old leases are gone
+        bakeTag = data->Bake.BakeTag;
+        for(uint64 i = 0; i < workers.size(); ++i)
+            workers[i].Leases.clear();
+
+        BuildGroupScheduleIndices(*data, groupScheduleIndices);
+        numBakeGroups = data->Bake.GroupSchedule->size();
+        groupDataSize = BakeGroupDataSize(data->Bake);
+        batchesPerGroup = BakeBatchesPerGroup(data->Bake);
+        groupOrderVersion = data->GroupOrderVersion;
+        leaseCursor = data->GroupOrder->size();
+
+        // Workers have to restart with the new settings before they get any more leases
+        if(HashesMatch(data->Key, bakeKey) == false)
+        {
+            bakeKey = data->Key;
+            settingsData = SerializeBakeSettings();
+            for(uint64 i = 0; i < workers.size(); ++i)
+                workers[i].Connection.Send(uint32(BakeMessageType::Settings), settingsData.data(), settingsData.size());
+        }
+    }
+
+    if(data != nullptr && data->GroupOrderVersion != groupOrderVersion)
+    {
+        groupOrderVersion = data->GroupOrderVersion;
+        leaseCursor = data->GroupOrder->size();
+    }
+
+    AcceptWorkers();
+
+    for(uint64 workerIdx = 0; workerIdx < workers.size();)
+    {
+        RemoteWorker& worker = workers[workerIdx];
+
+        bool connected = false;
+        try
+        {
+            connected = worker.Connection.Pump();
+
+            // Messages that arrived before the connection was closed are still handled
+            uint32 type = 0;
+            std::vector<uint8> payload;
+            while(worker.Connection.Receive(type, payload))
+                ProcessMessage(worker, type, payload, data);
+
+            if(connected && data != nullptr && WorkerMatchesBake(worker))
+            {
+                while(worker.Leases.size() < MaxLeasesPerWorker && GrantLease(worker, *data))
+                    continue;
+            }
+
+            if(connected)
+                connected = worker.Connection.Pump();
+        }
+        catch(Exception e)
+        {
+            PrintStringW(L"Dropping bake worker %ls: %ls", AnsiToWString(worker.Name.c_str()).c_str(), e.GetMessage().c_str());
+            connected = false;
+        }
+
+        if(connected)
+        {
+            ++workerIdx;
+            continue;
+        }
+
+        PrintString("Bake worker %s disconnected", worker.Name.c_str());
+        ReleaseLeases(worker, data);
+        worker.Connection.Close();
+        workers.erase(workers.begin() + workerIdx);
+    }
+}
+
+void BakeCoordinator::AcceptWorkers()
+{
+    while(true)
+    {
+        sockaddr_storage address = { };
+        int addressSize = sizeof(address);
+        SOCKET workerSocket = accept(listenSocket, reinterpret_cast<sockaddr*>(&address), &addressSize);
+        if(workerSocket == INVALID_SOCKET)
+            break;
+
+        char host[NI_MAXHOST] = { };
+        char service[NI_MAXSERV] = { };
+        getnameinfo(reinterpret_cast<const sockaddr*>(&address), addressSize, host, NI_MAXHOST,
+                    service, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
+
+        workers.push_back(RemoteWorker());
+        RemoteWorker& worker = workers.back();
+        worker.Name = MakeAnsiString("%s:%s", host, service);
+        worker.Connection.Open(workerSocket);
+        if(settingsData.size() > 0)
+            worker.Connection.Send(uint32(BakeMessageType::Settings), settingsData.data(), settingsData.size());
+
+        PrintString("Bake worker %s connected", worker.Name.c_str());
+    }
+}
+
+bool BakeCoordinator::WorkerMatchesBake(const RemoteWorker& worker) const
+{
+    return worker.HasHello && bakeTag >= 0 && HashesMatch(worker.Key, bakeKey) &&
+           worker.NumBakeGroups == numBakeGroups && worker.BatchesPerGroup == batchesPerGroup &&
+           worker.GroupDataSize == groupDataSize;
+}
+
+void BakeCoordinator::ProcessMessage(RemoteWorker& worker, uint32 type, const std::vector<uint8>& payload,
+                                     const DistributedBakeData* data)
+{
+    if(type == uint32(BakeMessageType::Hello))
+    {
+        BakeWorkerHello hello;
+        MemoryReadSerializer serializer(payload.data(), payload.size());
+        SerializeItem(serializer, hello);
+        if(hello.ProtocolVersion != ProtocolVersion)
+            throw Exception(L"Bake worker is using a different protocol version");
+        if(serializer.Offset() != payload.size())
+            throw Exception(L"Received a malformed hello");
+
+        // A worker says hello whenever its bake restarts, which throws away whatever it was baking
+        ReleaseLeases(worker, data);
+
+        worker.HasHello = true;
+        worker.HelloID = hello.HelloID;
+        worker.Key = hello.Key;
+        worker.NumBakeGroups = hello.NumBakeGroups;
+        worker.BatchesPerGroup = hello.BatchesPerGroup;
+        worker.GroupDataSize = hello.GroupDataSize;
+
+        if(bakeTag >= 0 && WorkerMatchesBake(worker) == false)
+        {
+            PrintString("Bake worker %s doesn't match the current bake, sending it the bake settings", worker.Name.c_str());
+            worker.Connection.Send(uint32(BakeMessageType::Settings), settingsData.data(), settingsData.size());
+        }
+    }
+    else if(type == uint32(BakeMessageType::LeaseResults))
+    {
+        if(data != nullptr)
+            MergeLeaseResults(worker, payload, *data);
+    }
+    else
+    {
+        throw Exception(L"Received an unexpected message from a bake worker");
+    }
+}
+
+// Priority groups are never leased out, since the bake threads keep count of how many of their
+// batches are left to hand out
+bool BakeCoordinator::GrantLease(RemoteWorker& worker, const DistributedBakeData& data)
+{
+    const std::vector<uint32>& groupOrder = *data.GroupOrder;
+    const std::vector<uint32>& groupSchedule = *data.Bake.GroupSchedule;
+
+    BakeLease lease;
+    while(leaseCursor > data.NumPriorityGroups && lease.Groups.size() < LeaseSize)
+    {
+        --leaseCursor;
+        const uint32 scheduleIdx = groupOrder[leaseCursor];
+
+        // Only groups that the bake threads haven't started on can be leased
+        BakeGroupProgress& progress = data.Bake.GroupProgress[scheduleIdx];
+        if(progress.ClaimedBatches != 0)
+            continue;
+        if(InterlockedCompareExchange64(&progress.ClaimedBatches, batchesPerGroup, 0) != 0)
+            continue;
+
+        // RemoteBatches always goes up after ClaimedBatches (see WriteCheckpoint)
+        InterlockedExchange64(&progress.RemoteBatches, batchesPerGroup);
+        lease.Groups.push_back(scheduleIdx);
+    }
+
+    if(lease.Groups.empty())
+        return false;
+
+    lease.ID = nextLeaseID++;
+
+    BakeLeaseHeader header;
+    header.LeaseID = lease.ID;
+    header.HelloID = worker.HelloID;
+    header.NumGroups = lease.Groups.size();
+
+    ByteArraySerializer serializer;
+    SerializeItem(serializer, header);
+    for(uint64 i = 0; i < header.NumGroups; ++i)
+    {
+        uint32 groupIdx = groupSchedule[lease.Groups[i]];
+        SerializeItem(serializer, groupIdx);
+    }
+
+    worker.Connection.Send(uint32(BakeMessageType::Lease), serializer.Bytes.data(), serializer.Bytes.size());
+    worker.Leases.push_back(lease);
+
+    return true;
+}
+
+// Copies the results for a finished lease into the bake results. Everything gets validated up
+// front, so that a bad message doesn't leave half of a lease merged.
+void BakeCoordinator::MergeLeaseResults(RemoteWorker& worker, const std::vector<uint8>& payload,
+                                        const DistributedBakeData& data)
+{
+    BakeLeaseHeader header;
+    MemoryReadSerializer serializer(payload.data(), payload.size());
+    SerializeItem(serializer, header);
+
+    // Results for a lease from before the bake restarted (or that was already released) are stale
+    uint64 leaseIdx = 0;
+    while(leaseIdx < worker.Leases.size() && worker.Leases[leaseIdx].ID != header.LeaseID)
+        ++leaseIdx;
+    if(leaseIdx == worker.Leases.size())
+        return;
+
+    const BakeLease& lease = worker.Leases[leaseIdx];
+    const uint64 numGroups = lease.Groups.size();
+    if(header.NumGroups != numGroups ||
+       payload.size() - serializer.Offset() != numGroups * (sizeof(uint32) + groupDataSize))
+        throw Exception(L"Received malformed lease results");
+
+    const std::vector<uint32>& groupSchedule = *data.Bake.GroupSchedule;
+    std::vector<uint32> groupIndices(numGroups);
+    for(uint64 i = 0; i < numGroups; ++i)
+    {
+        SerializeItem(serializer, groupIndices[i]);
+        if(groupIndices[i] != groupSchedule[lease.Groups[i]])
+            throw Exception(L"Lease results don't match the lease");
+    }
+
+    const uint8* groupData = payload.data() + serializer.Offset();
+    for(uint64 i = 0; i < numGroups; ++i)
+    {
+        const uint64 scheduleIdx = lease.Groups[i];
+        BakeGroupProgress& progress = data.Bake.GroupProgress[scheduleIdx];
+
+        // This keeps the checkpoint writer off of the group until it's been copied in. The group
+        // stays claimed, so dropping RemoteBatches at the end hands it back to the writer as fully baked.
+        InterlockedAdd64(&progress.StartedBatches, batchesPerGroup);
+        StoreBakeGroupData(data.Bake, scheduleIdx, groupData + i * groupDataSize);
+        InterlockedAdd64(&progress.FinishedBatches, batchesPerGroup);
+        InterlockedExchange64(&progress.RemoteBatches, 0);
+
+        data.Bake.BakeResults->MarkTileDirty(groupIndices[i]);
+    }
+
+    InterlockedAdd64(data.CurrBakeBatch, int64(numGroups) * batchesPerGroup);
+    worker.Leases.erase(worker.Leases.begin() + leaseIdx);
+}
+
+// Hands a worker's leased groups back to the bake threads. Without any data, the bake is in the
+// middle of restarting and the group progress counters are about to be reset anyway.
+void BakeCoordinator::ReleaseLeases(RemoteWorker& worker, const DistributedBakeData* data)
+{
+    if(data != nullptr && worker.Leases.size() > 0)
+    {
+        uint64 numReleased = 0;
+        for(uint64 leaseIdx = 0; leaseIdx < worker.Leases.size(); ++leaseIdx)
+        {
+            const BakeLease& lease = worker.Leases[leaseIdx];
+            for(uint64 i = 0; i < lease.Groups.size(); ++i)
+            {
+                // RemoteBatches always goes down before ClaimedBatches (see WriteCheckpoint)
+                BakeGroupProgress& progress = data->Bake.GroupProgress[lease.Groups[i]];
+                InterlockedExchange64(&progress.RemoteBatches, 0);
+                InterlockedExchange64(&progress.ClaimedBatches, 0);
+            }
+
+            numReleased += lease.Groups.size();
+        }
+
+        // The bake threads' claim window and the lease cursor may have already moved past them
+        InterlockedExchange64(data->WindowStart, 0);
+        leaseCursor = data->GroupOrder->size();
+
+        PrintString("Released %llu leased groups from bake worker %s", numReleased, worker.Name.c_str());
+    }
+
+    worker.Leases.clear();
+}
+
+// == BakeWorker ==================================================================================
+
+BakeWorker::~BakeWorker()
+{
+    Shutdown();
+}
+
+void BakeWorker::Start(const std::string& newCoordinatorHost, uint32 port)
+{
+    Shutdown();
+
+    WSADATA wsaData;
+    const int startupError = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if(startupError != 0)
+        throw Win32Exception(startupError, L"Failed to initialize Winsock:\n");
+
+    running = true;
+    coordinatorHost = newCoordinatorHost;
+    coordinatorPort = port;
+    lastConnectTime = 0;
+    bakeTag = -1;
+
+    PrintString("Baking as a worker for %s:%u", coordinatorHost.c_str(), coordinatorPort);
+}
+
+// Leased groups that were still being baked are left as they are, so the bake needs to restart afterwards
+void BakeWorker::Shutdown()
+{
+    if(running == false)
+        return;
+
+    connection.Close();
+    leases.clear();
+    sentHello = false;
+    running = false;
+    WSACleanup();
+}
+
+void BakeWorker::Update(const DistributedBakeData* data)
+{
+    if(running == false)
+        return;
+
+    if(data != nullptr && data->Bake.BakeTag != bakeTag)
+    {
+        // The restart marked every group as finished, so whatever was leased before is gone
+        bakeTag = data->Bake.BakeTag;
+        leases.clear();
+        sentHello = false;
+
+        BuildGroupScheduleIndices(*data, groupScheduleIndices);
+        groupDataSize = BakeGroupDataSize(data->Bake);
+        batchesPerGroup = BakeBatchesPerGroup(data->Bake);
+    }
+
+    try
+    {
+        if(connection.IsOpen() == false)
+        {
+            if(GetTickCount64() - lastConnectTime < ReconnectInterval)
+                return;
+
+            lastConnectTime = GetTickCount64();
+            connection.Connect(coordinatorHost, coordinatorPort);
+        }
+
+        const bool wasConnected = connection.IsConnected();
+        bool connected = connection.Pump();
+        if(connected && wasConnected == false && connection.IsConnected())
+            PrintString("Connected to bake coordinator %s:%u", coordinatorHost.c_str(), coordinatorPort);
+
+        uint32 type = 0;
+        std::vector<uint8> payload;
+        while(connection.Receive(type, payload))
+            ProcessMessage(type, payload, data);
+
+        if(connected && connection.IsConnected() && data != nullptr)
+        {
+            if(sentHello == false)
+            {
+                BakeWorkerHello hello;
+                hello.HelloID = ++helloID;
+                hello.Key = data->Key;
+                hello.NumBakeGroups = data->Bake.GroupSchedule->size();
+                hello.BatchesPerGroup = batchesPerGroup;
+                hello.GroupDataSize = groupDataSize;
+
+                ByteArraySerializer serializer;
+                SerializeItem(serializer, hello);
+                connection.Send(uint32(BakeMessageType::Hello), serializer.Bytes.data(), serializer.Bytes.size());
+                sentHello = true;
+            }
+
+            SendFinishedLeases(*data);
+            connected = connection.Pump();
+        }
+
+        if(connected == false)
+            Disconnect();
+    }
+    catch(Exception e)
+    {
+        if(connection.IsConnected())
+            PrintStringW(L"Lost the connection to the bake coordinator: %ls", e.GetMessage().c_str());
+        else
+            PrintStringW(L"Failed to connect to the bake coordinator: %ls", e.GetMessage().c_str());
+        Disconnect();
+    }
+}
+
+void BakeWorker::ProcessMessage(uint32 type, const std::vector<uint8>& payload, const DistributedBakeData* data)
+{
+    if(type == uint32(BakeMessageType::Settings))
+    {
+        // Any setting that changes restarts the bake on the next frame, which sends a new hello
+        DeserializeBakeSettings(payload.data(), payload.size());
+    }
+    else if(type == uint32(BakeMessageType::Lease))
+    {
+        // Without any data the bake is restarting, and the lease will be released after the next hello
+        if(data != nullptr)
+            StartLease(payload, *data);
+    }
+    else
+    {
+        throw Exception(L"Received an unexpected message from the bake coordinator");
+    }
+}
+
+// Hands the leased groups to the bake threads by resetting their progress counters. A group
+// that's still being baked for an older lease just keeps going.
+void BakeWorker::StartLease(const std::vector<uint8>& payload, const DistributedBakeData& data)
+{
+    BakeLeaseHeader header;
+    MemoryReadSerializer serializer(payload.data(), payload.size());
+    SerializeItem(serializer, header);
+
+    // Leases sent before the coordinator got the last hello were already released
+    if(header.HelloID != helloID)
+        return;
+
+    if(header.NumGroups == 0 || header.NumGroups > groupScheduleIndices.size() ||
+       payload.size() - serializer.Offset() != header.NumGroups * sizeof(uint32))
+        throw Exception(L"Received a malformed lease");
+
+    std::vector<uint32> groupIndices(header.NumGroups);
+    for(uint64 i = 0; i < groupIndices.size(); ++i)
+        SerializeItem(serializer, groupIndices[i]);
+
+    BakeLease lease;
+    lease.ID = header.LeaseID;
+    for(uint64 i = 0; i < groupIndices.size(); ++i)
+    {
+        if(groupIndices[i] >= groupScheduleIndices.size() || groupScheduleIndices[groupIndices[i]] == uint32(-1))
+            throw Exception(L"Received a lease for a group that isn't in the bake");
+        lease.Groups.push_back(groupScheduleIndices[groupIndices[i]]);
+    }
+
+    // Groups that were already baked for an older lease have their results cleared, since the
+    // first batches of a group build on whatever is already in there. Dropping StartedBatches
+    // first keeps the checkpoint writer off of the group, and the bake threads can't claim it
+    // until ClaimedBatches is reset at the end.
+    const std::vector<uint8> emptyGroupData(groupDataSize, 0);
+    int64 numBatches = 0;
+    for(uint64 i = 0; i < lease.Groups.size(); ++i)
+    {
+        const uint64 scheduleIdx = lease.Groups[i];
+        BakeGroupProgress& progress = data.Bake.GroupProgress[scheduleIdx];
+        if(progress.FinishedBatches < batchesPerGroup)
+            continue;
+
+        InterlockedExchange64(&progress.StartedBatches, 0);
+        StoreBakeGroupData(data.Bake, scheduleIdx, emptyGroupData.data());
+        data.Bake.BakeResults->MarkTileDirty(groupIndices[i]);
+
+        InterlockedExchange64(&progress.FinishedBatches, 0);
+        InterlockedExchange64(&progress.ClaimedBatches, 0);
+        numBatches += batchesPerGroup;
+    }
+
+    // The bake threads' claim window may have already moved past the groups
+    InterlockedExchange64(data.WindowStart, 0);
+    InterlockedAdd64(data.CurrBakeBatch, -numBatches);
+
+    leases.push_back(lease);
+}
+
+void BakeWorker::SendFinishedLeases(const DistributedBakeData& data)
+{
+    const std::vector<uint32>& groupSchedule = *data.Bake.GroupSchedule;
+
+    for(uint64 leaseIdx = 0; leaseIdx < leases.size();)
+    {
+        const BakeLease& lease = leases[leaseIdx];
+
+        bool finished = true;
+        for(uint64 i = 0; i < lease.Groups.size() && finished; ++i)
+            finished = data.Bake.GroupProgress[lease.Groups[i]].FinishedBatches >= batchesPerGroup;
+
+        if(finished == false)
+        {
+            ++leaseIdx;
+            continue;
+        }
+
+        const uint64 numGroups = lease.Groups.size();
+
+        BakeLeaseHeader header;
+        header.LeaseID = lease.ID;
+        header.HelloID = helloID;
+        header.NumGroups = numGroups;
+
+        ByteArraySerializer serializer;
+        SerializeItem(serializer, header);
+        for(uint64 i = 0; i < numGroups; ++i)
+        {
+            uint32 groupIdx = groupSchedule[lease.Groups[i]];
+            SerializeItem(serializer, groupIdx);
+        }
+
+        // The group data is the raw texels for each group, copied straight out of the bake results
+        std::vector<uint8>& payload = serializer.Bytes;
+        const uint64 groupDataOffset = payload.size();
+        payload.resize(groupDataOffset + numGroups * groupDataSize);
+        for(uint64 i = 0; i < numGroups; ++i)
+            CopyBakeGroupData(data.Bake, lease.Groups[i], payload.data() + groupDataOffset + i * groupDataSize);
+
+        connection.Send(uint32(BakeMessageType::LeaseResults), payload.data(), payload.size());
+        leases.erase(leases.begin() + leaseIdx);
+    }
+}
+
+// The leased groups are left to finish baking, but their results are never sent since the
+// coordinator releases the leases as soon as it notices that the connection is gone
+void BakeWorker::Disconnect()
+{
+    if(connection.IsConnected())
+        PrintString("Disconnected from bake coordinator %s:%u", coordinatorHost.c_str(), coordinatorPort);
+
+    connection.Close();
+    leases.clear();
+    sentHello = false;
+}
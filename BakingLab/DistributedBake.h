@@ -0,0 +1,198 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <MurmurHash.h>
+
+#include <winsock2.h>
+
+#include "BakeCheckpoint.h"
+
+using namespace SampleFramework11;
+
+// Everything from the current bake that the coordinator or a worker needs to get at
+struct DistributedBakeData
+{
+    BakeCheckpointData Bake;
+    Hash Key;                                           // scene contents and bake settings
+    volatile int64* CurrBakeBatch = nullptr;
+    volatile int64* WindowStart = nullptr;              // start of the bake threads' claim window
+    const std::vector<uint32>* GroupOrder = nullptr;
+    uint64 NumPriorityGroups = 0;
+    uint64 GroupOrderVersion = 0;                       // changes whenever the order is re-sorted
+};
+
+// What was passed on the command line with "-bakeworker [host[:port]]"
+struct BakeWorkerArgs
+{
+    bool Enabled = false;
+    std::string CoordinatorHost = "localhost";
+    uint32 Port = 0;                                    // 0 if it wasn't given
+};
+
+BakeWorkerArgs ParseBakeWorkerArgs(const wchar* commandLine);
+
+// A non-blocking TCP connection that sends and receives whole messages. Nothing ever waits on
+// the socket, so it can be pumped once per frame from the main thread. Heartbeats are sent and
+// swallowed by the connection itself, so that a peer that's gone quiet gets noticed.
+class BakeConnection
+{
+
+public:
+
+    // Takes ownership of a socket that's already connected
+    void Open(SOCKET newSocket);
+
+    // Starts connecting to a remote host, which finishes in a later call to Pump()
+    void Connect(const std::string& host, uint32 port);
+
+    void Close();
+
+    bool IsOpen() const { return socket != INVALID_SOCKET; }
+    bool IsConnected() const { return socket != INVALID_SOCKET && connecting == false; }
+
+    // Queues up a message to be sent by Pump()
+    void Send(uint32 type, const void* data, uint64 size);
+
+    // Sends as much of the queued data as the socket will take, and reads whatever has arrived.
+    // Returns false if the connection was closed or broken, or if the connection attempt failed.
+    // Throws if nothing has arrived from the other end in too long.
+    bool Pump();
+
+    // Pops the next complete message that was received, if there is one
+    bool Receive(uint32& type, std::vector<uint8>& payload);
+
+private:
+
+    bool ReceiveMessage(uint32& type, std::vector<uint8>& payload);
+
+    SOCKET socket = INVALID_SOCKET;
+    bool connecting = false;
+    uint64 lastSendTime = 0;
+    uint64 lastReceiveTime = 0;
+    std::vector<uint8> sendBuffer;
+    uint64 sendOffset = 0;
+    std::vector<uint8> receiveBuffer;
+    uint64 receiveOffset = 0;
+};
+
+// Hands out leases on bake groups to worker processes, and merges their results back into the
+// bake. Leases are taken from the back of the bake order so that they stay out of the way of the
+// local bake threads, which start from the front. The leased groups count as claimed as far as
+// the bake threads are concerned, and if a worker disconnects, stops responding or restarts its
+// bake then they're released so that they can be baked again (locally, or by another worker).
+class BakeCoordinator
+{
+
+public:
+
+    ~BakeCoordinator();
+
+    void Start(uint32 port);
+    void Shutdown();
+
+    bool Running() const { return listenSocket != INVALID_SOCKET; }
+    uint64 NumWorkers() const { return workers.size(); }
+
+    // Called once per frame from the main thread. The data is null until the bake has been set up,
+    // in which case only new connections are handled.
+    void Update(const DistributedBakeData* data);
+
+private:
+
+    struct BakeLease
+    {
+        uint64 ID = 0;
+        std::vector<uint32> Groups;                     // schedule indices
+    };
+
+    // A worker only gets leases once the last hello it sent matches the current bake
+    struct RemoteWorker
+    {
+        BakeConnection Connection;
+        std::string Name;
+        bool HasHello = false;
+        uint64 HelloID = 0;
+        Hash Key;
+        uint64 NumBakeGroups = 0;
+        int64 BatchesPerGroup = 0;
+        uint64 GroupDataSize = 0;
+        std::vector<BakeLease> Leases;
+    };
+
+    void AcceptWorkers();
+    bool WorkerMatchesBake(const RemoteWorker& worker) const;
+    void ProcessMessage(RemoteWorker& worker, uint32 type, const std::vector<uint8>& payload, const DistributedBakeData* data);
+    bool GrantLease(RemoteWorker& worker, const DistributedBakeData& data);
+    void MergeLeaseResults(RemoteWorker& worker, const std::vector<uint8>& payload, const DistributedBakeData& data);
+    void ReleaseLeases(RemoteWorker& worker, const DistributedBakeData* data);
+
+    SOCKET listenSocket = INVALID_SOCKET;
+    std::vector<RemoteWorker> workers;
+    std::vector<uint8> settingsData;
+    Hash bakeKey;
+    int64 bakeTag = -1;
+    uint64 numBakeGroups = 0;
+    uint64 groupOrderVersion = 0;
+    uint64 leaseCursor = 0;                             // leases are taken from the order below this
+    uint64 nextLeaseID = 0;
+    uint64 groupDataSize = 0;
+    int64 batchesPerGroup = 0;
+    std::vector<uint32> groupScheduleIndices;           // schedule index for each light map group
+};
+
+// Connects to a coordinator, applies the bake settings that it sends over, and bakes the groups
+// that it leases out. Leased groups are handed to the local bake threads by resetting their
+// progress counters, and their results are sent back once every batch is finished. The rest of
+// the worker's results are never used, so the bake threads sit idle when there's no lease.
+class BakeWorker
+{
+
+public:
+
+    ~BakeWorker();
+
+    void Start(const std::string& coordinatorHost, uint32 port);
+    void Shutdown();
+
+    bool Running() const { return running; }
+
+    // Called once per frame from the main thread. The data is null until the bake has been set up,
+    // in which case only the settings from the coordinator are handled.
+    void Update(const DistributedBakeData* data);
+
+private:
+
+    struct BakeLease
+    {
+        uint64 ID = 0;
+        std::vector<uint32> Groups;                     // schedule indices
+    };
+
+    void ProcessMessage(uint32 type, const std::vector<uint8>& payload, const DistributedBakeData* data);
+    void StartLease(const std::vector<uint8>& payload, const DistributedBakeData& data);
+    void SendFinishedLeases(const DistributedBakeData& data);
+    void Disconnect();
+
+    bool running = false;
+    std::string coordinatorHost;
+    uint32 coordinatorPort = 0;
+    BakeConnection connection;
+    uint64 lastConnectTime = 0;
+    bool sentHello = false;
+    uint64 helloID = 0;
+    std::vector<BakeLease> leases;
+    int64 bakeTag = -1;
+    uint64 groupDataSize = 0;
+    int64 batchesPerGroup = 0;
+    std::vector<uint32> groupScheduleIndices;
+};
@@ -0,0 +1,206 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "LightMapDenoiser.h"
+
+#include <Timer.h>
+#include <Utility.h>
+
+#include "AppSettings.h"
+
+static const int32 KernelRadius = 2;
+static const float KernelWeights[KernelRadius * 2 + 1] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+// Shared data for all threads working on a single filter pass
+struct DenoisePassData
+{
+    const LightMapDenoiseParams* Params = nullptr;
+    const PagedArray<BakePoint>* BakePoints = nullptr;
+    const Float3* Normals = nullptr;
+    const BakeResultStore* Src = nullptr;
+    BakeResultStore* Dst = nullptr;
+    int32 StepSize = 1;
+    volatile int64 CurrRow = 0;
+};
+
+static bool IsActiveTexel(const BakePoint& bakePoint)
+{
+    return bakePoint.Coverage != 0 && bakePoint.Coverage != 0xFFFFFFFF;
+}
+
+static void DenoiseRow(const DenoisePassData& pass, int32 y)
+{
+    const LightMapDenoiseParams& params = *pass.Params;
+    const PagedArray<BakePoint>& bakePoints = *pass.BakePoints;
+    const int32 lightMapSize = int32(params.LightMapSize);
+    const uint64 basisCount = params.BasisCount;
+    const int32 stepSize = pass.StepSize;
+
+    Float4 sums[AppSettings::MaxBasisCount];
+
+    for(int32 x = 0; x < lightMapSize; ++x)
+    {
+        const uint64 texelIdx = y * lightMapSize + x;
+        const uint64 texelOffset = pass.Src->TexelOffset(x, y);
+        const BakePoint& center = bakePoints[texelIdx];
+        if(IsActiveTexel(center) == false)
+        {
+            for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+                pass.Dst->BasisData(basisIdx)[texelOffset] = pass.Src->BasisData(basisIdx)[texelOffset];
+            continue;
+        }
+
+        // The position weight falls off relative to the world-space size of the filter footprint,
+        // so that the filter behaves the same regardless of the light map density
+        const float sigma = params.PositionSigma * std::max(center.Size.x, center.Size.y) * stepSize;
+        const float invTwoSigmaSq = 1.0f / std::max(2.0f * sigma * sigma, 1e-10f);
+        const Float3 centerNormal = pass.Normals[texelIdx];
+
+        for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+            sums[basisIdx] = Float4(0.0f, 0.0f, 0.0f, 0.0f);
+        float weightSum = 0.0f;
+
+        for(int32 ky = -KernelRadius; ky <= KernelRadius; ++ky)
+        {
+            const int32 sy = y + ky * stepSize;
+            if(sy < 0 || sy >= lightMapSize)
+                continue;
+
+            for(int32 kx = -KernelRadius; kx <= KernelRadius; ++kx)
+            {
+                const int32 sx = x + kx * stepSize;
+                if(sx < 0 || sx >= lightMapSize)
+                    continue;
+
+                const uint64 tapIdx = sy * lightMapSize + sx;
+                const BakePoint& tap = bakePoints[tapIdx];
+                if(IsActiveTexel(tap) == false)
+                    continue;
+
+                const float nDotN = Float3::Dot(centerNormal, pass.Normals[tapIdx]);
+                if(nDotN <= 0.0f)
+                    continue;
+
+                const Float3 delta = tap.Position - center.Position;
+                const float distSq = Float3::Dot(delta, delta);
+                float weight = KernelWeights[kx + KernelRadius] * KernelWeights[ky + KernelRadius];
+                weight *= std::exp(-distSq * invTwoSigmaSq);
+                weight *= std::pow(nDotN, params.NormalPower);
+
+                const uint64 tapOffset = pass.Src->TexelOffset(sx, sy);
+                for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+                    sums[basisIdx] += pass.Src->BasisData(basisIdx)[tapOffset].ToFloat4() * weight;
+                weightSum += weight;
+            }
+        }
+
+        // The center tap always has a weight of 1 before the kernel weight is applied, so we can't
+        // end up with a zero sum here
+        Assert_(weightSum > 0.0f);
+        const float invWeightSum = 1.0f / weightSum;
+        for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+            pass.Dst->BasisData(basisIdx)[texelOffset] = Half4(sums[basisIdx] * invWeightSum);
+    }
+}
+
+static uint32 __stdcall DenoiseThread(void* data)
+{
+    DenoisePassData* pass = reinterpret_cast<DenoisePassData*>(data);
+    const int64 numRows = int64(pass->Params->LightMapSize);
+
+    while(true)
+    {
+        const int64 row = InterlockedIncrement64(&pass->CurrRow) - 1;
+        if(row >= numRows)
+            break;
+
+        DenoiseRow(*pass, int32(row));
+    }
+
+    return 0;
+}
+
+static void RunDenoisePass(DenoisePassData& pass)
+{
+    pass.CurrRow = 0;
+
+    const uint64 numThreads = std::max<uint64>(pass.Params->NumThreads, 1);
+    std::vector<HANDLE> threads(numThreads);
+    for(uint64 i = 0; i < numThreads; ++i)
+    {
+        threads[i] = HANDLE(_beginthreadex(nullptr, 0, DenoiseThread, &pass, 0, nullptr));
+        if(threads[i] == 0)
+        {
+            AssertFail_("Failed to create thread for light map denoising");
+            throw Exception(L"Failed to create thread for light map denoising");
+        }
+    }
+
+    for(uint64 i = 0; i < numThreads; ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+}
+
+void DenoiseLightMap(const LightMapDenoiseParams& params, const PagedArray<BakePoint>& bakePoints,
+                     const BakeResultStore& input, BakeResultStore& output)
+{
+    const uint64 numTexels = params.LightMapSize * params.LightMapSize;
+    Assert_(bakePoints.Size() == numTexels);
+    Assert_(params.BasisCount <= AppSettings::MaxBasisCount);
+    Assert_(input.LightMapSize() == params.LightMapSize && input.BasisCount() == params.BasisCount);
+    Assert_(params.NumIterations > 0);
+
+    Timer timer;
+    PrintString("Denoising light map...");
+
+    // Bake point normals are averaged across MSAA samples, so they need to be re-normalized
+    PagedArray<Float3> normals;
+    normals.Init(numTexels, input.OutOfCore());
+    for(uint64 i = 0; i < numTexels; ++i)
+    {
+        if(IsActiveTexel(bakePoints[i]))
+            normals[i] = Float3::Normalize(bakePoints[i].Normal);
+    }
+
+    BakeResultStore temp;
+    output.Init(params.LightMapSize, params.BasisCount, false, input.OutOfCore());
+    if(params.NumIterations > 1)
+        temp.Init(params.LightMapSize, params.BasisCount, false, input.OutOfCore());
+
+    // Ping-pong between the output and the temporary store, making sure that the last pass ends
+    // up writing to the output store
+    BakeResultStore* targets[2] = { &output, &temp };
+    uint64 currTarget = (params.NumIterations - 1) % 2;
+
+    DenoisePassData pass;
+    pass.Params = &params;
+    pass.BakePoints = &bakePoints;
+    pass.Normals = normals.Data();
+    pass.Src = &input;
+
+    for(uint64 iteration = 0; iteration < params.NumIterations; ++iteration)
+    {
+        pass.Dst = targets[currTarget];
+        pass.StepSize = int32(1) << iteration;
+        RunDenoisePass(pass);
+
+        pass.Src = pass.Dst;
+        currTarget = 1 - currTarget;
+    }
+
+    Assert_(pass.Src == &output);
+
+    timer.Update();
+    PrintString("Finished! (%fs)", timer.DeltaSecondsF());
+}
@@ -0,0 +1,43 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+
+#include "SharedConstants.h"
+#include "BakeResultStore.h"
+
+using namespace SampleFramework11;
+
+struct LightMapDenoiseParams
+{
+    uint64 LightMapSize = 0;
+    uint64 BasisCount = 0;
+    uint64 NumIterations = 4;
+
+    // World-space falloff for the position weight, in units of the texel's world-space size
+    float PositionSigma = 1.0f;
+
+    // Exponent applied to the cosine between two texel normals
+    float NormalPower = 64.0f;
+
+    uint64 NumThreads = 1;
+};
+
+// Runs an edge-aware a-trous wavelet filter over a set of baked light map basis textures. Each
+// pass uses a 5x5 B3-spline kernel whose taps are spaced 2^i texels apart, and weights every tap
+// by how close its bake point is to the center one in both world-space position and normal.
+// Empty texels and gutter texels never contribute, so light doesn't bleed across UV charts.
+// The weights only depend on the bake points, so they're shared by every basis texture.
+void DenoiseLightMap(const LightMapDenoiseParams& params, const PagedArray<BakePoint>& bakePoints,
+                     const BakeResultStore& input, BakeResultStore& output);
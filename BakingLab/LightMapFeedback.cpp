@@ -0,0 +1,363 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "LightMapFeedback.h"
+
+#include <Timer.h>
+#include <Utility.h>
+#include <Graphics/Sampling.h>
+
+#include "AppSettings.h"
+
+// Shared data for all threads working on a single feedback pass
+struct FeedbackPassData
+{
+    const LightMapFeedbackParams* Params = nullptr;
+    const PagedArray<BakePoint>* BakePoints = nullptr;
+    Float3* DirectIrradiance = nullptr;
+    const PagedArray<Float4>* Src = nullptr;
+    PagedArray<Float4>* Dst = nullptr;
+    uint64 PassIdx = 0;
+    volatile int64 CurrRow = 0;
+};
+
+static bool IsActiveTexel(const BakePoint& bakePoint)
+{
+    return bakePoint.Coverage != 0 && bakePoint.Coverage != 0xFFFFFFFF;
+}
+
+// Gathers direct irradiance from the sun and the area light
+static Float3 ComputeDirectIrradiance(const FeedbackPassData& pass, const BakePoint& bakePoint,
+                                      const Float3& normal, Random& random)
+{
+    const LightMapFeedbackParams& params = *pass.Params;
+    RTCScene scene = params.SceneBVH->Scene;
+
+    Float3 irradianceSum;
+    for(uint64 sampleIdx = 0; sampleIdx < params.NumSamples; ++sampleIdx)
+    {
+        if(AppSettings::EnableSun)
+        {
+            const Float2 sunSample = random.RandomFloat2();
+            Float3 sunIrradiance;
+            SampleSunLight(bakePoint.Position, normal, scene, 1.0f, 0.0f, false, 0.0f, 1.0f,
+                           sunSample.x, sunSample.y, sunIrradiance);
+            irradianceSum += sunIrradiance;
+        }
+
+        if(AppSettings::EnableAreaLight)
+        {
+            const Float2 areaLightSample = random.RandomFloat2();
+            Float3 areaLightIrradiance;
+            Float3 areaLightDir;
+            SampleAreaLight(bakePoint.Position, normal, scene, 1.0f, 0.0f, false, 0.0f, 1.0f,
+                            areaLightSample.x, areaLightSample.y, areaLightIrradiance, areaLightDir);
+            irradianceSum += areaLightIrradiance;
+        }
+    }
+
+    return irradianceSum / float(params.NumSamples);
+}
+
+// Gathers the irradiance from the sky (or environment map) that isn't blocked by the scene. This
+// only goes into the first pass, since the later passes pick it up from segments that escape.
+static Float3 ComputeSkyIrradiance(const FeedbackPassData& pass, const BakePoint& bakePoint,
+                                   const Float3& normal, Random& random)
+{
+    const LightMapFeedbackParams& params = *pass.Params;
+
+    Float3x3 tangentFrame;
+    tangentFrame.SetXBasis(bakePoint.Tangent);
+    tangentFrame.SetYBasis(bakePoint.Bitangent);
+    tangentFrame.SetZBasis(normal);
+
+    // A path length of 1 ends the path at the first hit, so only rays that escape contribute
+    PathTracerParams pathParams;
+    pathParams.MaxPathLength = 1;
+    pathParams.SceneBVH = params.SceneBVH;
+    pathParams.SkyCache = params.SkyCache;
+    pathParams.EnvMaps = params.EnvMaps;
+
+    Float3 radianceSum;
+    for(uint64 sampleIdx = 0; sampleIdx < params.NumSamples; ++sampleIdx)
+    {
+        const Float2 dirSample = random.RandomFloat2();
+        const Float3 rayDirWS = Float3::Normalize(Float3::Transform(SampleCosineHemisphere(dirSample.x, dirSample.y), tangentFrame));
+
+        pathParams.RayDir = rayDirWS;
+        pathParams.RayStart = bakePoint.Position + 0.1f * rayDirWS;
+        pathParams.RayLen = FLT_MAX;
+
+        float illuminance = 0.0f;
+        bool hitSky = false;
+        radianceSum += PathTrace(pathParams, random, illuminance, hitSky);
+    }
+
+    return radianceSum * (Pi / float(params.NumSamples));
+}
+
+// Gathers the irradiance reflected off of other surfaces using the previous pass
+static Float3 ComputeBounceIrradiance(const FeedbackPassData& pass, const BakePoint& bakePoint,
+                                      const Float3& normal, Random& random)
+{
+    const LightMapFeedbackParams& params = *pass.Params;
+
+    Float3x3 tangentFrame;
+    tangentFrame.SetXBasis(bakePoint.Tangent);
+    tangentFrame.SetYBasis(bakePoint.Bitangent);
+    tangentFrame.SetZBasis(normal);
+
+    PathTracerParams pathParams;
+    pathParams.EnableDiffuse = true;
+    pathParams.MaxPathLength = -1;
+    pathParams.SceneBVH = params.SceneBVH;
+    pathParams.SkyCache = params.SkyCache;
+    pathParams.EnvMaps = params.EnvMaps;
+    pathParams.FeedbackLightMap = pass.Src->Data();
+    pathParams.FeedbackLightMapSize = params.LightMapSize;
+
+    IntegrationSampleSet sampleSet;
+    Float3 radianceSum;
+    for(uint64 sampleIdx = 0; sampleIdx < params.NumSamples; ++sampleIdx)
+    {
+        for(uint64 typeIdx = 0; typeIdx < NumIntegrationTypes; ++typeIdx)
+            sampleSet.Samples[typeIdx] = random.RandomFloat2();
+
+        const Float2 dirSample = sampleSet.BRDF();
+        const Float3 rayDirWS = Float3::Normalize(Float3::Transform(SampleCosineHemisphere(dirSample.x, dirSample.y), tangentFrame));
+
+        pathParams.RayDir = rayDirWS;
+        pathParams.RayStart = bakePoint.Position + 0.1f * rayDirWS;
+        pathParams.RayLen = FLT_MAX;
+        pathParams.SampleSet = &sampleSet;
+
+        float illuminance = 0.0f;
+        bool hitSky = false;
+        radianceSum += PathTrace(pathParams, random, illuminance, hitSky);
+    }
+
+    // Cosine-weighted sampling cancels out the cosine term, leaving a factor of Pi
+    return radianceSum * (Pi / float(params.NumSamples));
+}
+
+static uint32 __stdcall FeedbackThread(void* data)
+{
+    FeedbackPassData* pass = reinterpret_cast<FeedbackPassData*>(data);
+    const PagedArray<BakePoint>& bakePoints = *pass->BakePoints;
+    const uint64 lightMapSize = pass->Params->LightMapSize;
+
+    Random random;
+    random.SeedWithRandomValue();
+
+    const volatile int64* cancel = pass->Params->Cancel;
+    while(cancel == nullptr || *cancel == 0)
+    {
+        const int64 row = InterlockedIncrement64(&pass->CurrRow) - 1;
+        if(row >= int64(lightMapSize))
+            break;
+
+        for(uint64 x = 0; x < lightMapSize; ++x)
+        {
+            const uint64 texelIdx = row * lightMapSize + x;
+            const BakePoint& bakePoint = bakePoints[texelIdx];
+            if(IsActiveTexel(bakePoint) == false)
+            {
+                (*pass->Dst)[texelIdx] = Float4(0.0f, 0.0f, 0.0f, 0.0f);
+                continue;
+            }
+
+            // Bake point normals are averaged across MSAA samples, so they need to be re-normalized
+            const Float3 normal = Float3::Normalize(bakePoint.Normal);
+            if(pass->PassIdx == 0)
+                pass->DirectIrradiance[texelIdx] = ComputeDirectIrradiance(*pass, bakePoint, normal, random);
+
+            Float3 irradiance = pass->DirectIrradiance[texelIdx];
+            if(pass->PassIdx == 0)
+                irradiance += ComputeSkyIrradiance(*pass, bakePoint, normal, random);
+            else
+                irradiance += ComputeBounceIrradiance(*pass, bakePoint, normal, random);
+
+            (*pass->Dst)[texelIdx] = Float4(irradiance, 1.0f);
+        }
+    }
+
+    return 0;
+}
+
+static void RunFeedbackPass(FeedbackPassData& pass)
+{
+    pass.CurrRow = 0;
+
+    const uint64 numThreads = std::max<uint64>(pass.Params->NumThreads, 1);
+    std::vector<HANDLE> threads(numThreads);
+    for(uint64 i = 0; i < numThreads; ++i)
+    {
+        threads[i] = HANDLE(_beginthreadex(nullptr, 0, FeedbackThread, &pass, 0, nullptr));
+        if(threads[i] == 0)
+        {
+            AssertFail_("Failed to create thread for light map feedback");
+            throw Exception(L"Failed to create thread for light map feedback");
+        }
+    }
+
+    for(uint64 i = 0; i < numThreads; ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+
+    // Gutter texels store the position of the texel that they should copy from
+    const PagedArray<BakePoint>& bakePoints = *pass.BakePoints;
+    const uint64 lightMapSize = pass.Params->LightMapSize;
+    const uint64 numTexels = bakePoints.Size();
+    for(uint64 texelIdx = 0; texelIdx < numTexels; ++texelIdx)
+    {
+        const BakePoint& bakePoint = bakePoints[texelIdx];
+        if(bakePoint.Coverage == 0xFFFFFFFF)
+            (*pass.Dst)[texelIdx] = (*pass.Dst)[bakePoint.TexelPos.y * lightMapSize + bakePoint.TexelPos.x];
+    }
+}
+
+void ComputeLightMapFeedback(const LightMapFeedbackParams& params, const PagedArray<BakePoint>& bakePoints,
+                             PagedArray<Float4>& irradiance)
+{
+    const uint64 numTexels = params.LightMapSize * params.LightMapSize;
+    Assert_(bakePoints.Size() == numTexels);
+    Assert_(params.NumBounces > 0);
+    Assert_(params.NumSamples > 0);
+
+    Timer timer;
+    PrintString("Computing light map feedback for %llu bounce(s)...", params.NumBounces);
+
+    const bool onDisk = bakePoints.OnDisk();
+    PagedArray<Float3> directIrradiance;
+    directIrradiance.Init(numTexels, onDisk);
+
+    // Ping-pong between the output and a temporary array, making sure that the last pass ends up
+    // writing to the output array
+    PagedArray<Float4> temp;
+    irradiance.Init(numTexels, onDisk);
+    if(params.NumBounces > 1)
+        temp.Init(numTexels, onDisk);
+
+    PagedArray<Float4>* targets[2] = { &irradiance, &temp };
+    uint64 currTarget = (params.NumBounces - 1) % 2;
+
+    FeedbackPassData pass;
+    pass.Params = &params;
+    pass.BakePoints = &bakePoints;
+    pass.DirectIrradiance = directIrradiance.data();
+
+    for(uint64 passIdx = 0; passIdx < params.NumBounces; ++passIdx)
+    {
+        pass.PassIdx = passIdx;
+        pass.Dst = targets[currTarget];
+        RunFeedbackPass(pass);
+
+        if(params.Cancel != nullptr && *params.Cancel != 0)
+        {
+            PrintString("Cancelled");
+            return;
+        }
+
+        pass.Src = pass.Dst;
+        currTarget = 1 - currTarget;
+    }
+
+    Assert_(pass.Src == &irradiance);
+
+    timer.Update();
+    PrintString("Finished! (%fs)", timer.DeltaSecondsF());
+}
+
+LightMapFeedbackBuilder::~LightMapFeedbackBuilder()
+{
+    Discard();
+}
+
+void LightMapFeedbackBuilder::Start(const LightMapFeedbackParams& newParams, const PagedArray<BakePoint>& newBakePoints, int64 newTag)
+{
+    Discard();
+
+    skyCache.Init(AppSettings::SunDirection, AppSettings::GroundAlbedo, AppSettings::Turbidity);
+
+    params = newParams;
+    params.SkyCache = &skyCache;
+    params.Cancel = &cancel;
+    bakePoints = &newBakePoints;
+    tag = newTag;
+    thread = HANDLE(_beginthreadex(nullptr, 0, BuildThread, this, 0, nullptr));
+    if(thread == 0)
+    {
+        AssertFail_("Failed to create thread for light map feedback");
+        throw Exception(L"Failed to create thread for light map feedback");
+    }
+}
+
+void LightMapFeedbackBuilder::Discard()
+{
+    InterlockedExchange64(&cancel, 1);
+    Wait();
+
+    irradiance.Shutdown();
+    bakePoints = nullptr;
+    tag = -1;
+    built = false;
+    cancel = 0;
+}
+
+bool LightMapFeedbackBuilder::Busy() const
+{
+    return thread != nullptr && WaitForSingleObject(thread, 0) == WAIT_TIMEOUT;
+}
+
+void LightMapFeedbackBuilder::Finish(PagedArray<Float4>& dstIrradiance)
+{
+    Assert_(Pending());
+    Wait();
+
+    // If the build failed, the bake just goes ahead without a feedback light map
+    if(built)
+        dstIrradiance.Swap(irradiance);
+    else
+        dstIrradiance.Shutdown();
+
+    Discard();
+}
+
+void LightMapFeedbackBuilder::Wait()
+{
+    if(thread == nullptr)
+        return;
+
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    thread = nullptr;
+}
+
+uint32 __stdcall LightMapFeedbackBuilder::BuildThread(void* context)
+{
+    LightMapFeedbackBuilder& builder = *reinterpret_cast<LightMapFeedbackBuilder*>(context);
+
+    try
+    {
+        ComputeLightMapFeedback(builder.params, *builder.bakePoints, builder.irradiance);
+        builder.built = builder.cancel == 0;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to compute light map feedback: %ls", e.GetMessage().c_str());
+        builder.built = false;
+    }
+
+    return 0;
+}
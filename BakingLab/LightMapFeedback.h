@@ -0,0 +1,99 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+#include <Graphics/Textures.h>
+#include <Graphics/Skybox.h>
+
+#include "PathTracer.h"
+#include "SharedConstants.h"
+#include "PagedArray.h"
+
+using namespace SampleFramework11;
+
+struct LightMapFeedbackParams
+{
+    uint64 LightMapSize = 0;
+    uint64 NumBounces = 1;
+    uint64 NumSamples = 64;
+    uint64 NumThreads = 1;
+    const BVHData* SceneBVH = nullptr;
+    const SkyCache* SkyCache = nullptr;
+    const TextureData<Half4>* EnvMaps = nullptr;
+
+    // The computation stops early (leaving the result incomplete) once this is non-zero
+    const volatile int64* Cancel = nullptr;
+};
+
+// Computes a light map containing the total irradiance at every bake point after the requested
+// number of bounces, which can then be used by the path tracer (see PathTracerParams::FeedbackLightMap)
+// to shade the first hit of a path instead of continuing it. The first pass gathers direct
+// lighting from the sun, area light and sky, and each pass after that traces a single cosine-weighted
+// segment per sample from every bake point and looks up the previous pass at the hit's light map
+// UV (or the sky, for segments that escape). This means that every extra bounce only costs one ray
+// per sample, rather than making every path longer.
+//
+// The xyz components of the result hold the irradiance, and w is 1 for texels that have valid
+// data. Gutter texels are filled from their neighbors so that bilinear lookups don't darken
+// the edges of UV charts.
+//
+// The light map (and the temporary arrays used while computing it) are kept in paging files
+// when the bake points are, since it's the same size as the light map.
+void ComputeLightMapFeedback(const LightMapFeedbackParams& params, const PagedArray<BakePoint>& bakePoints,
+                             PagedArray<Float4>& irradiance);
+
+// Computes the feedback light map on a background thread, so that the UI keeps running while it's
+// solved. The bake threads shouldn't be scheduled for the bake tag that it's being computed for
+// until it's been handed over with Finish().
+class LightMapFeedbackBuilder
+{
+
+public:
+
+    ~LightMapFeedbackBuilder();
+
+    // The bake points, BVH and env maps need to stay alive until the build is finished or
+    // discarded. The sky cache is set up here from the current sun and sky settings.
+    void Start(const LightMapFeedbackParams& params, const PagedArray<BakePoint>& bakePoints, int64 tag);
+
+    // Cancels the build, waits for it to stop, and throws away whatever it computed
+    void Discard();
+
+    // Returns true if a build was started and hasn't been finished or discarded
+    bool Pending() const { return tag != -1; }
+
+    // The bake tag that was passed to Start()
+    int64 Tag() const { return tag; }
+
+    // Returns true while the build thread is still running
+    bool Busy() const;
+
+    // Swaps the finished light map into irradiance
+    void Finish(PagedArray<Float4>& irradiance);
+
+private:
+
+    void Wait();
+
+    static uint32 __stdcall BuildThread(void* context);
+
+    LightMapFeedbackParams params;
+    const PagedArray<BakePoint>* bakePoints = nullptr;
+    SkyCache skyCache;
+    PagedArray<Float4> irradiance;
+    volatile int64 cancel = 0;
+    int64 tag = -1;
+    bool built = false;
+    HANDLE thread = nullptr;
+};
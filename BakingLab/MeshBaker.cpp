@@ -23,10 +23,16 @@
 #include <Graphics/Textures.h>
 #include <Graphics/BRDF.h>
 #include <Graphics/Sampling.h>
+#include <Graphics/EXRWriter.h>
 
 #include "AppSettings.h"
 #include "SG.h"
 #include "PathTracer.h"
+#include "LightMapDenoiser.h"
+#include "RadianceCache.h"
+#include "LightMapFeedback.h"
+#include "SceneCache.h"
+#include "BVHBuilder.h"
 
 // Suppress vs2013: "new behavior: elements of array 'array' will be default initialized"
 #pragma warning(disable : 4351)
@@ -36,6 +42,101 @@ static const uint64 BakeGroupSizeX = 8;
 static const uint64 BakeGroupSizeY = 8;
 static const uint64 BakeGroupSize = BakeGroupSizeX * BakeGroupSizeY;
 
+// Number of samples that a progressive bake adds to a texel each time it visits a bake group.
+// The texel values are kept at full precision while these are accumulated, and only get
+// quantized when they're written back to the (FP16) bake results.
+static const uint64 ProgressiveSamplesPerBatch = 8;
+
+StaticAssert_(BakeGroupSizeX == BakeResultStore::TileSizeX && BakeGroupSizeY == BakeResultStore::TileSizeY);
+StaticAssert_(BakeGroupSize == 64);
+StaticAssert_(TileSize == RenderResultStore::TileSize);
+
+// Returns how many batches a progressive bake needs to add all of its samples to a single group
+static uint64 NumProgressiveBatchesPerGroup(uint64 sqrtNumSamples)
+{
+    const uint64 numSamples = sqrtNumSamples * sqrtNumSamples;
+    return (numSamples + ProgressiveSamplesPerBatch - 1) / ProgressiveSamplesPerBatch;
+}
+
+// Returns the width of the blocks of texels that share a single coarse texel at the start of a
+// progressive bake, or 1 if the bake goes straight to full resolution
+static uint64 CoarseBakeBlockSize(CoarseBakeModes coarseBakeMode, BakeModes bakeMode, SolveModes solveMode)
+{
+    if(AppSettings::SupportsProgressiveIntegration(bakeMode, solveMode) == false)
+        return 1;
+
+    if(coarseBakeMode == CoarseBakeModes::HalfResolution)
+        return 2;
+    else if(coarseBakeMode == CoarseBakeModes::QuarterResolution)
+        return 4;
+
+    return 1;
+}
+
+// Texels in a coarse block only share a coarse texel if they're on the same part of the same
+// surface, which is checked the same way the denoiser weighs its taps. The tangent frames need to
+// match as well, since tangent-space results aren't meaningful in a different frame.
+static const float CoarseShareMinCosAngle = 0.9f;
+static const float CoarseShareMaxTexelDistance = 1.5f;
+
+static bool CanShareCoarseTexel(const BakePoint& a, const BakePoint& b, uint64 coarseBlockSize)
+{
+    if(Float3::Dot(a.Normal, b.Normal) < CoarseShareMinCosAngle ||
+       Float3::Dot(a.Tangent, b.Tangent) < CoarseShareMinCosAngle ||
+       Float3::Dot(a.Bitangent, b.Bitangent) < CoarseShareMinCosAngle)
+        return false;
+
+    const float maxDistance = CoarseShareMaxTexelDistance * float(coarseBlockSize) * Max(Max(a.Size.x, a.Size.y), Max(b.Size.x, b.Size.y));
+    return Float3::Length(a.Position - b.Position) <= maxDistance;
+}
+
+// Returns how many batches it takes to add all of the samples to the coarse texels of a group. A
+// coarse batch adds more samples per texel than a full resolution batch, since there are fewer
+// texels to bake, so that both kinds of batches take about the same amount of time.
+static uint64 NumCoarseBatchesPerGroup(uint64 sqrtNumSamples, uint64 coarseBlockSize)
+{
+    if(coarseBlockSize <= 1)
+        return 0;
+
+    const uint64 numSamples = sqrtNumSamples * sqrtNumSamples;
+    const uint64 samplesPerBatch = ProgressiveSamplesPerBatch * coarseBlockSize * coarseBlockSize;
+    return (numSamples + samplesPerBatch - 1) / samplesPerBatch;
+}
+
+// Returns how many batches are needed to finish a single group with the current bake settings
+static uint64 NumBakeBatchesPerGroup(BakeModes bakeMode, SolveModes solveMode, CoarseBakeModes coarseBakeMode)
+{
+    if(AppSettings::SupportsProgressiveIntegration(bakeMode, solveMode) == false)
+        return BakeGroupSize;
+
+    const uint64 coarseBlockSize = CoarseBakeBlockSize(coarseBakeMode, bakeMode, solveMode);
+    return NumCoarseBatchesPerGroup(AppSettings::NumBakeSamples, coarseBlockSize) +
+           NumProgressiveBatchesPerGroup(AppSettings::NumBakeSamples);
+}
+static const uint64 RadianceCacheSize = 1024 * 1024;
+
+// Limits how much of the bake texture gets uploaded in a single frame, so that a full upload
+// (after a restart or a denoise) is spread out over several frames
+static const uint64 MaxBakeUploadSize = 32 * 1024 * 1024;
+
+// Minimum number of milliseconds between re-prioritizing the bake groups for a moving camera
+static const uint64 PriorityUpdateInterval = 250;
+
+// Size of the regions that the light map gets rasterized in when extracting the bake points
+static const uint32 ExtractionRegionSize = 1024;
+
+// Light maps bigger than this are always baked out-of-core
+static const uint32 MaxInCoreLightMapSize = 4096;
+
+// The light map texture that gets displayed is downsampled until it's no bigger than this, since a
+// full resolution FP16 texture array for a 16k light map would take up tens of gigabytes. The
+// full resolution results are only kept in the bake result store, which is what gets exported.
+static const uint64 MaxLightMapTextureSize = 4096;
+
+// For an out-of-core bake, the bake threads only hand out batches from this many groups at a time
+// (in light map order), so that the bake points and results they touch stay resident
+static const uint64 OutOfCoreGroupWindow = 4096;
+
 // Info about a gutter texel
 struct GutterTexel
 {
@@ -43,6 +144,33 @@ struct GutterTexel
     Uint2 NeighborPos;
 };
 
+// Returns the bit for a texel in its bake group's active texel mask
+static uint64 GroupTexelBit(uint64 x, uint64 y)
+{
+    return uint64(1) << ((y % BakeGroupSizeY) * BakeGroupSizeX + (x % BakeGroupSizeX));
+}
+
+// Returns the index of the bake point for a texel of a bake group, given its bit index in the group's mask
+static uint64 GroupTexelIndex(uint64 groupIdx, uint64 bitIdx, uint64 numGroupsX, uint64 lightMapSize)
+{
+    const uint64 x = (groupIdx % numGroupsX) * BakeGroupSizeX + (bitIdx % BakeGroupSizeX);
+    const uint64 y = (groupIdx / numGroupsX) * BakeGroupSizeY + (bitIdx / BakeGroupSizeX);
+    return y * lightMapSize + x;
+}
+
+// Returns how many light map texels (in each direction) get averaged into a single texel of the
+// light map texture. It's always a power of two that divides the bake group size, so that the
+// tiles can be downsampled independently.
+static uint64 LightMapTextureScale(uint64 lightMapSize)
+{
+    uint64 scale = 1;
+    while((lightMapSize + scale - 1) / scale > MaxLightMapTextureSize)
+        scale *= 2;
+
+    Assert_(BakeGroupSizeX % scale == 0 && BakeGroupSizeY % scale == 0);
+    return scale;
+}
+
 // Returns the final monte-carlo weighting factor using the PDF of a cosine-weighted hemisphere
 static float CosineWeightedMonteCarloFactor(uint64 numSamples)
 {
@@ -74,7 +202,7 @@ struct DiffuseBaker
     uint64 NumSamples = 0;
     Float3 ResultSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
         ResultSum = 0.0f;
@@ -125,7 +253,7 @@ struct DirectionalBaker
     float DirectionWeightSum;
     Float3 NormalSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
 
@@ -186,7 +314,7 @@ struct DirectionalRGBBaker
     Float3 DirectionWeightSum;
     Float3 NormalSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
 
@@ -247,7 +375,7 @@ struct HL2Baker
     uint64 NumSamples = 0;
     Float3 ResultSum[3];
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
         ResultSum[0] = ResultSum[1] = ResultSum[2] = 0.0f;
@@ -298,12 +426,12 @@ struct SH4Baker
     static const uint64 BasisCount = 4;
 
     uint64 NumSamples = 0;
-    SH4Color ResultSum;
+    SH4ColorAccumulator ResultSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
-        ResultSum = SH4Color();
+        ResultSum.Reset();
     }
 
     Float3 SampleDirection(Float2 samplePoint)
@@ -314,22 +442,23 @@ struct SH4Baker
     void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
     {
         const Float3 sampleDir = AppSettings::WorldSpaceBake ? sampleDirWS : sampleDirTS;
-        ResultSum += ProjectOntoSH4Color(sampleDir, sample);
+        ResultSum.AddSample(sampleDir, sample);
     }
 
     void FinalResult(Float4 bakeOutput[BasisCount])
     {
-        SH4Color result = ResultSum * HemisphereMonteCarloFactor(NumSamples);
+        SH4Color result = ResultSum.Resolve() * HemisphereMonteCarloFactor(NumSamples);
         for(uint64 i = 0; i < BasisCount; ++i)
             bakeOutput[i] = Float4(Float3::Clamp(result.Coefficients[i], -FP16Max, FP16Max), 1.0f);
     }
 
     void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
     {
+        const SH4Color resultSum = ResultSum.Resolve();
         const float lerpFactor = passIdx / (passIdx + 1.0f);
         for(uint64 i = 0; i < BasisCount; ++i)
         {
-            Float3 newSample = ResultSum.Coefficients[i] * HemisphereMonteCarloFactor(1);
+            Float3 newSample = resultSum.Coefficients[i] * HemisphereMonteCarloFactor(1);
             Float3 currValue = bakeOutput[i].To3D();
             currValue = Lerp<Float3>(newSample, currValue, lerpFactor);
             bakeOutput[i] = Float4(Float3::Clamp(currValue, -FP16Max, FP16Max), 1.0f);
@@ -343,12 +472,12 @@ struct SH9Baker
     static const uint64 BasisCount = 9;
 
     uint64 NumSamples = 0;
-    SH9Color ResultSum;
+    SH9ColorAccumulator ResultSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
-        ResultSum = SH9Color();
+        ResultSum.Reset();
     }
 
     Float3 SampleDirection(Float2 samplePoint)
@@ -359,22 +488,23 @@ struct SH9Baker
     void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
     {
         const Float3 sampleDir = AppSettings::WorldSpaceBake ? sampleDirWS : sampleDirTS;
-        ResultSum += ProjectOntoSH9Color(sampleDir, sample);
+        ResultSum.AddSample(sampleDir, sample);
     }
 
     void FinalResult(Float4 bakeOutput[BasisCount])
     {
-        SH9Color result = ResultSum * HemisphereMonteCarloFactor(NumSamples);
+        SH9Color result = ResultSum.Resolve() * HemisphereMonteCarloFactor(NumSamples);
         for(uint64 i = 0; i < BasisCount; ++i)
             bakeOutput[i] = Float4(Float3::Clamp(result.Coefficients[i], -FP16Max, FP16Max), 1.0f);
     }
 
     void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
     {
+        const SH9Color resultSum = ResultSum.Resolve();
         const float lerpFactor = passIdx / (passIdx + 1.0f);
         for(uint64 i = 0; i < BasisCount; ++i)
         {
-            Float3 newSample = ResultSum.Coefficients[i] * HemisphereMonteCarloFactor(1);
+            Float3 newSample = resultSum.Coefficients[i] * HemisphereMonteCarloFactor(1);
             Float3 currValue = bakeOutput[i].To3D();
             currValue = Lerp<Float3>(newSample, currValue, lerpFactor);
             bakeOutput[i] = Float4(Float3::Clamp(currValue, -FP16Max, FP16Max), 1.0f);
@@ -388,12 +518,12 @@ struct H4Baker
     static const uint64 BasisCount = 4;
 
     uint64 NumSamples = 0;
-    SH9Color ResultSum;
+    SH9ColorAccumulator ResultSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
-        ResultSum = SH9Color();
+        ResultSum.Reset();
     }
 
     Float3 SampleDirection(Float2 samplePoint)
@@ -403,12 +533,12 @@ struct H4Baker
 
     void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
     {
-        ResultSum += ProjectOntoSH9Color(sampleDirTS, sample);
+        ResultSum.AddSample(sampleDirTS, sample);
     }
 
     void FinalResult(Float4 bakeOutput[BasisCount])
     {
-        SH9Color shResult = ResultSum;
+        SH9Color shResult = ResultSum.Resolve();
         shResult.ConvolveWithCosineKernel();
         H4Color result = ConvertToH4(shResult) * HemisphereMonteCarloFactor(NumSamples);
         for(uint64 i = 0; i < BasisCount; ++i)
@@ -417,7 +547,7 @@ struct H4Baker
 
     void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
     {
-        SH9Color shResult = ResultSum;
+        SH9Color shResult = ResultSum.Resolve();
         shResult.ConvolveWithCosineKernel();
         H4Color result = ConvertToH4(shResult) * HemisphereMonteCarloFactor(1);
 
@@ -438,12 +568,12 @@ struct H6Baker
     static const uint64 BasisCount = 6;
 
     uint64 NumSamples = 0;
-    SH9Color ResultSum;
+    SH9ColorAccumulator ResultSum;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         NumSamples = numSamples;
-        ResultSum = SH9Color();
+        ResultSum.Reset();
     }
 
     Float3 SampleDirection(Float2 samplePoint)
@@ -453,12 +583,12 @@ struct H6Baker
 
     void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
     {
-        ResultSum += ProjectOntoSH9Color(sampleDirTS, sample);
+        ResultSum.AddSample(sampleDirTS, sample);
     }
 
     void FinalResult(Float4 bakeOutput[BasisCount])
     {
-        SH9Color shResult = ResultSum;
+        SH9Color shResult = ResultSum.Resolve();
         shResult.ConvolveWithCosineKernel();
         H6Color result = ConvertToH6(shResult) * HemisphereMonteCarloFactor(NumSamples);
         for(uint64 i = 0; i < BasisCount; ++i)
@@ -467,7 +597,7 @@ struct H6Baker
 
     void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
     {
-        SH9Color shResult = ResultSum;
+        SH9Color shResult = ResultSum.Resolve();
         shResult.ConvolveWithCosineKernel();
         H6Color result = ConvertToH6(shResult) * HemisphereMonteCarloFactor(1);
 
@@ -483,33 +613,46 @@ struct H6Baker
 };
 
 // Bakes radiance into a set of SG lobes, which is computed using a solve or by
-// using an ad-hoc projection. Bakes into SGCount * 3 floats.
-template<uint64 SGCount> struct SGBaker
+// using an ad-hoc projection. Bakes into SGCount * 3 floats. The solve mode is part of
+// the type so that the per-sample and per-texel paths don't need to branch on it.
+template<uint64 SGCount, SolveModes SolveMode> struct SGBaker
 {
     static const uint64 BasisCount = SGCount;
 
     uint64 NumSamples = 0;
     uint64 CurrSampleIdx = 0;
-    FixedArray<Float3> SampleDirs;
-    FixedArray<Float3> Samples;
+    Float3* SampleDirs = nullptr;
+    Float3* Samples = nullptr;
+    ScratchArena* Scratch = nullptr;
     SG ProjectedResult[SGCount];
     float RunningAverageWeights[SGCount] = { };
+    bool StreamingSolve = false;
+    SGNormalEquations NormalEquations;
 
-    void Init(uint64 numSamples, Float4 prevResult[BasisCount])
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
     {
         CurrSampleIdx = 0;
         NumSamples = numSamples;
 
-        if(NumSamples != SampleDirs.Size())
-            SampleDirs.Init(NumSamples);
-        if(NumSamples != Samples.Size())
-            Samples.Init(NumSamples);
+        // The least squares modes can either keep every sample around for one big solve at the end,
+        // or fold each sample into a k x k system as it comes in
+        StreamingSolve = AppSettings::StreamingSGSolve && (SolveMode == SolveModes::SVD || SolveMode == SolveModes::NNLS);
+        // The sample storage comes out of the thread's scratch memory, which gets rewound
+        // before the next texel is initialized
+        Scratch = &scratch;
+        if(StreamingSolve)
+            InitSGNormalEquations(NormalEquations, SGCount);
+        else
+        {
+            SampleDirs = scratch.Allocate<Float3>(NumSamples);
+            Samples = scratch.Allocate<Float3>(NumSamples);
+        }
 
         const SG* initialGuess = InitialGuess();
         for(uint64 i = 0; i < SGCount; ++i)
             ProjectedResult[i] = initialGuess[i];
 
-        if(AppSettings::SolveMode == SolveModes::RunningAverage || AppSettings::SolveMode == SolveModes::RunningAverageNN)
+        if(SolveMode == SolveModes::RunningAverage || SolveMode == SolveModes::RunningAverageNN)
         {
             for(uint64 i = 0; i < SGCount; ++i)
             {
@@ -527,29 +670,57 @@ template<uint64 SGCount> struct SGBaker
     void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
     {
         const Float3 sampleDir = AppSettings::WorldSpaceBake ? sampleDirWS : sampleDirTS;
+        if(StreamingSolve)
+        {
+            AccumulateSGNormalEquations<SGCount>(NormalEquations, sampleDir, sample, InitialGuessLobes());
+            return;
+        }
+
+        Assert_(CurrSampleIdx < NumSamples);
         SampleDirs[CurrSampleIdx] = sampleDir;
         Samples[CurrSampleIdx] = sample;
         ++CurrSampleIdx;
 
-        if(AppSettings::SolveMode == SolveModes::RunningAverage)
-            SGRunningAverage(sampleDir, sample, ProjectedResult, SGCount, (float)sampleIdx, RunningAverageWeights, false);
-        else if(AppSettings::SolveMode == SolveModes::RunningAverageNN)
-            SGRunningAverage(sampleDir, sample, ProjectedResult, SGCount, (float)sampleIdx, RunningAverageWeights, true);
+        if(SolveMode == SolveModes::RunningAverage)
+            SGRunningAverage<SGCount, false>(sampleDir, sample, InitialGuessLobes(), ProjectedResult, (float)sampleIdx, RunningAverageWeights);
+        else if(SolveMode == SolveModes::RunningAverageNN)
+            SGRunningAverage<SGCount, true>(sampleDir, sample, InitialGuessLobes(), ProjectedResult, (float)sampleIdx, RunningAverageWeights);
         else
-            ProjectOntoSGs(sampleDir, sample, ProjectedResult, SGCount);
+            ProjectOntoSGs<SGCount>(sampleDir, sample, InitialGuessLobes(), ProjectedResult);
     }
 
     void FinalResult(Float4 bakeOutput[BasisCount])
     {
         SG sgLobes[SGCount];
 
+        if(StreamingSolve)
+        {
+            const SG* initialGuess = InitialGuess();
+            for(uint64 i = 0; i < SGCount; ++i)
+                sgLobes[i] = initialGuess[i];
+
+            SolveSGNormalEquations<SGCount>(NormalEquations, sgLobes, SolveMode == SolveModes::NNLS);
+
+            for(uint64 i = 0; i < SGCount; ++i)
+                bakeOutput[i] = Float4(Float3::Clamp(sgLobes[i].Amplitude, 0.0f, FP16Max), 1.0f);
+
+            return;
+        }
+
         SGSolveParam params;
         params.NumSGs = SGCount;
         params.OutSGs = sgLobes;
-        params.XSamples = SampleDirs.Data();
-        params.YSamples = Samples.Data();
+        params.XSamples = SampleDirs;
+        params.YSamples = Samples;
         params.NumSamples = NumSamples;
-        SolveSGs(params);
+        params.Scratch = Scratch;
+
+        // Tangent-space directions come straight from the shared integration samples, so texels
+        // using the same sample pattern can share the factorized design matrix. Area light samples
+        // and world-space directions are unique to each texel, so caching those would just thrash.
+        params.CacheFactorization = AppSettings::WorldSpaceBake == false &&
+                                    (AppSettings::EnableAreaLight && AppSettings::BakeDirectAreaLight) == false;
+        SolveSGs<SGCount, SolveMode>(params);
 
         for(uint64 i = 0; i < SGCount; ++i)
             bakeOutput[i] = Float4(Float3::Clamp(sgLobes[i].Amplitude, 0.0f, FP16Max), 1.0f);
@@ -557,7 +728,7 @@ template<uint64 SGCount> struct SGBaker
 
     void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
     {
-        if(AppSettings::SolveMode == SolveModes::RunningAverage || AppSettings::SolveMode == SolveModes::RunningAverageNN)
+        if(SolveMode == SolveModes::RunningAverage || SolveMode == SolveModes::RunningAverageNN)
         {
             for(uint64 i = 0; i < SGCount; ++i)
                 bakeOutput[i] = Float4(Float3::Clamp(ProjectedResult[i].Amplitude, -FP16Max, FP16Max), RunningAverageWeights[i]);
@@ -576,10 +747,73 @@ template<uint64 SGCount> struct SGBaker
     }
 };
 
-typedef SGBaker<5> SG5Baker;
-typedef SGBaker<6> SG6Baker;
-typedef SGBaker<9> SG9Baker;
-typedef SGBaker<12> SG12Baker;
+// Feeds the same set of path samples to two bakers, which lets us bake several encodings while
+// only tracing the rays once. The bases for the second baker are stored after the bases for the
+// first baker, and the first baker picks the sample directions (so both need to be sampling the
+// same distribution).
+template<typename TBakerA, typename TBakerB> struct CompositeBaker
+{
+    static const uint64 BasisCount = TBakerA::BasisCount + TBakerB::BasisCount;
+
+    TBakerA BakerA;
+    TBakerB BakerB;
+
+    void Init(uint64 numSamples, Float4 prevResult[BasisCount], ScratchArena& scratch)
+    {
+        BakerA.Init(numSamples, prevResult, scratch);
+        BakerB.Init(numSamples, prevResult + TBakerA::BasisCount, scratch);
+    }
+
+    Float3 SampleDirection(Float2 samplePoint)
+    {
+        return BakerA.SampleDirection(samplePoint);
+    }
+
+    void AddSample(Float3 sampleDirTS, uint64 sampleIdx, Float3 sample, Float3 sampleDirWS, Float3 normal)
+    {
+        BakerA.AddSample(sampleDirTS, sampleIdx, sample, sampleDirWS, normal);
+        BakerB.AddSample(sampleDirTS, sampleIdx, sample, sampleDirWS, normal);
+    }
+
+    void FinalResult(Float4 bakeOutput[BasisCount])
+    {
+        BakerA.FinalResult(bakeOutput);
+        BakerB.FinalResult(bakeOutput + TBakerA::BasisCount);
+    }
+
+    void ProgressiveResult(Float4 bakeOutput[BasisCount], uint64 passIdx)
+    {
+        BakerA.ProgressiveResult(bakeOutput, passIdx);
+        BakerB.ProgressiveResult(bakeOutput + TBakerA::BasisCount, passIdx);
+    }
+};
+
+// The extra modes that get baked alongside the current bake mode for a composite bake. These all
+// use uniform hemisphere sampling and support progressive integration, and none of them depend on
+// the global SG solver state.
+typedef CompositeBaker<HL2Baker, CompositeBaker<SH4Baker, CompositeBaker<SH9Baker, CompositeBaker<H4Baker, H6Baker>>>> CompositeModeBakers;
+static const BakeModes CompositeBakeModes[] = { BakeModes::HL2, BakeModes::SH4, BakeModes::SH9, BakeModes::H4, BakeModes::H6 };
+StaticAssert_(CompositeModeBakers::BasisCount == MeshBaker::CompositeBasisCount);
+
+// Returns the index of the first composite result for a bake mode, or -1 if that mode isn't part of a composite bake
+static uint64 CompositeBasisOffset(BakeModes bakeMode)
+{
+    uint64 offset = 0;
+    for(uint64 i = 0; i < ArraySize_(CompositeBakeModes); ++i)
+    {
+        if(CompositeBakeModes[i] == bakeMode)
+            return offset;
+        offset += AppSettings::BasisCount(CompositeBakeModes[i]);
+    }
+
+    return uint64(-1);
+}
+
+// The diffuse baker uses cosine-weighted sampling, so it can't share samples with the other modes
+static bool SupportsCompositeBake(BakeModes bakeMode)
+{
+    return bakeMode != BakeModes::Diffuse;
+}
 
 // Data used by the baking threads
 struct BakeThreadContext
@@ -588,20 +822,35 @@ struct BakeThreadContext
     SkyCache SkyCache;
     const BVHData* SceneBVH = nullptr;
     const TextureData<Half4>* EnvMaps = nullptr;
-    const std::vector<BakePoint>* BakePoints = nullptr;
+    const PagedArray<BakePoint>* BakePoints = nullptr;
+    const std::vector<uint32>* GroupSchedule = nullptr;
+    const std::vector<uint32>* GroupOrder = nullptr;
+    uint64 NumPriorityGroups = 0;
+    const volatile int64* ScheduleTag = nullptr;
+    BakeGroupProgress* GroupProgress = nullptr;
+    BakeGroupQueue* GroupQueue = nullptr;
+    uint64 GroupWindowSize = 0;
     uint64 CurrNumBatches = 0;
     uint64 CurrLightMapSize = 0;
     BakeModes CurrBakeMode = BakeModes::Diffuse;
     SolveModes CurrSolveMode = SolveModes::NNLS;
+    uint64 CoarseBlockSize = 1;
+    uint64 NumCoarseBatches = 0;
     Random RandomGenerator;
     SampleModes CurrSampleMode = SampleModes::Random;
     uint64 CurrNumSamples = 0;
     const std::vector<IntegrationSamples>* Samples;
-    FixedArray<Float4>* BakeOutput = nullptr;
+    BakeResultStore* BakeOutput = nullptr;
+    BakeResultStore* CompositeOutput = nullptr;
+    uint64 NumBakeOutputBases = 0;
     volatile int64* CurrBatch = nullptr;
+    RadianceCache* RadianceCache = nullptr;
+    const Float4* FeedbackLightMap = nullptr;
+    ScratchArena Scratch;
 
-    void Init(FixedArray<Float4>* bakeOutput, const std::vector<IntegrationSamples>* samples,
-              volatile int64* currBatch, const MeshBaker* meshBaker, uint64 newTag)
+    void Init(BakeResultStore* bakeOutput, BakeResultStore* compositeOutput, const std::vector<IntegrationSamples>* samples,
+              volatile int64* currBatch, BakeGroupProgress* groupProgress, BakeGroupQueue* groupQueue,
+              ::RadianceCache* radianceCache, const MeshBaker* meshBaker, uint64 newTag)
     {
         if(BakeTag == uint64(-1))
             RandomGenerator.SeedWithRandomValue();
@@ -611,20 +860,235 @@ struct BakeThreadContext
         SceneBVH = &meshBaker->sceneBVH;
         EnvMaps = meshBaker->input.EnvMapData;
         BakePoints = &meshBaker->bakePoints;
+        GroupSchedule = &meshBaker->bakeGroupSchedule;
+        GroupOrder = &meshBaker->bakeGroupOrder;
+        NumPriorityGroups = meshBaker->numPriorityGroups;
+        ScheduleTag = &meshBaker->scheduleBakeTag;
+        GroupProgress = groupProgress;
+        GroupQueue = groupQueue;
+        GroupWindowSize = bakeOutput->OutOfCore() ? OutOfCoreGroupWindow : 0;
         CurrNumBatches = meshBaker->currNumBakeBatches;
         CurrLightMapSize = meshBaker->currLightMapSize;
         CurrBakeMode = meshBaker->currBakeMode;
         CurrSolveMode = meshBaker->currSolveMode;
-        BakeOutput = bakeOutput;
         CurrBatch = currBatch;
         CurrSampleMode = AppSettings::BakeSampleMode;
         CurrNumSamples = AppSettings::NumBakeSamples;
+        CoarseBlockSize = CoarseBakeBlockSize(meshBaker->currCoarseBakeMode, CurrBakeMode, CurrSolveMode);
+        NumCoarseBatches = NumCoarseBatchesPerGroup(CurrNumSamples, CoarseBlockSize);
         Samples = samples;
+        RadianceCache = AppSettings::EnableRadianceCache ? radianceCache : nullptr;
+        FeedbackLightMap = meshBaker->feedbackIrradiance.Size() > 0 ? meshBaker->feedbackIrradiance.Data() : nullptr;
+
+        BakeOutput = bakeOutput;
+        CompositeOutput = meshBaker->currCompositeBake ? compositeOutput : nullptr;
+        NumBakeOutputBases = AppSettings::BasisCount(CurrBakeMode);
+
+        // Make sure there's enough scratch memory for an SG baker to hold on to all of a texel's
+        // samples and then solve with them. The arena only ever grows, so this doesn't
+        // re-allocate every time the bake restarts.
+        const uint64 numSamplesPerTexel = CurrNumSamples * CurrNumSamples;
+        const uint64 scratchSize = ScratchArena::AllocationSize<Float3>(numSamplesPerTexel) * 2 +
+                                   SGSolveScratchSize(numSamplesPerTexel, AppSettings::MaxSGCount);
+        if(scratchSize > Scratch.Capacity())
+            Scratch.Init(scratchSize);
+    }
+
+    // For a composite bake, the bases for the extra modes come right after the current mode's bases
+    Float4 LoadResult(uint64 basisIdx, uint64 texelOffset) const
+    {
+        if(basisIdx < NumBakeOutputBases)
+            return BakeOutput->Load(basisIdx, texelOffset);
+        return CompositeOutput->Load(basisIdx - NumBakeOutputBases, texelOffset);
+    }
+
+    void StoreResult(uint64 basisIdx, uint64 texelOffset, const Float4& value)
+    {
+        if(basisIdx < NumBakeOutputBases)
+            BakeOutput->Store(basisIdx, texelOffset, value);
+        else
+            CompositeOutput->Store(basisIdx - NumBakeOutputBases, texelOffset, value);
+    }
+
+    // Only updates the full-precision results, and leaves the display copy alone
+    void StoreAccumulator(uint64 basisIdx, uint64 texelOffset, const Float4& value)
+    {
+        if(basisIdx < NumBakeOutputBases)
+            BakeOutput->StoreAccumulator(basisIdx, texelOffset, value);
+        else
+            CompositeOutput->StoreAccumulator(basisIdx - NumBakeOutputBases, texelOffset, value);
     }
 };
 
+// Claims the next batch of a group, if nobody else is working on it. A group's batches are baked
+// strictly one after another, since every batch reads back the results of the ones before it (and
+// a non-progressive batch fills in texels that later batches overwrite). So a batch can only be
+// claimed once the one before it has finished, at which point ClaimedBatches and FinishedBatches
+// match, and claiming it moves ClaimedBatches ahead so that the group is busy until it finishes.
+static bool TryClaimGroupBatch(BakeGroupProgress& progress, int64 batchesPerGroup, int64& batchIdx)
+{
+    const int64 claimedBatches = progress.ClaimedBatches;
+    if(claimedBatches >= batchesPerGroup || progress.FinishedBatches != claimedBatches)
+        return false;
+
+    if(InterlockedCompareExchange64(&progress.ClaimedBatches, claimedBatches + 1, claimedBatches) != claimedBatches)
+        return false;
+
+    batchIdx = claimedBatches;
+    return true;
+}
+
+// Sweeps over a range of the bake order looking for a group with a batch that can be claimed
+static bool ClaimBakeBatchInRange(BakeThreadContext& context, uint64 firstCandidate, uint64 numCandidates,
+                                  uint64& scheduleIdx, uint64& groupBatchIdx)
+{
+    const std::vector<uint32>& groupOrder = *context.GroupOrder;
+    const int64 batchesPerGroup = int64(context.CurrNumBatches / groupOrder.size());
+    BakeGroupQueue& queue = *context.GroupQueue;
+
+    for(uint64 attempt = 0; attempt < numCandidates; ++attempt)
+    {
+        const uint64 orderIdx = firstCandidate + uint64(InterlockedIncrement64(&queue.Sweep) - 1) % numCandidates;
+        const uint64 candidateIdx = groupOrder[orderIdx];
+
+        int64 batchIdx = 0;
+        if(TryClaimGroupBatch(context.GroupProgress[candidateIdx], batchesPerGroup, batchIdx) == false)
+            continue;
+
+        InterlockedIncrement64(context.CurrBatch);
+        if(orderIdx < context.NumPriorityGroups)
+            InterlockedDecrement64(&queue.PriorityBatchesLeft);
+
+        scheduleIdx = candidateIdx;
+        groupBatchIdx = uint64(batchIdx);
+        return true;
+    }
+
+    return false;
+}
+
+// Claims the next batch of the next group in the bake order that still has batches left. Until
+// all of the batches for the priority groups at the front of the order are claimed, those groups
+// are tried first, and a thread only moves on to the rest of the order if every one of them is
+// busy with another thread. The groups take turns so that they all converge at the same rate.
+// For an out-of-core bake, only the groups in a window at the front of the order take turns, and
+// the window moves along once they're finished. Returns false if there's nothing left to claim
+// (or everything that's left is busy).
+static bool ClaimBakeBatch(BakeThreadContext& context, uint64& scheduleIdx, uint64& groupBatchIdx)
+{
+    if(*context.CurrBatch >= int64(context.CurrNumBatches))
+        return false;
+
+    const std::vector<uint32>& groupOrder = *context.GroupOrder;
+    const uint64 numBakeGroups = groupOrder.size();
+    const int64 batchesPerGroup = int64(context.CurrNumBatches / numBakeGroups);
+    BakeGroupQueue& queue = *context.GroupQueue;
+
+    const bool priorityGroupsLeft = queue.PriorityBatchesLeft > 0 && context.NumPriorityGroups > 0;
+    if(priorityGroupsLeft && ClaimBakeBatchInRange(context, 0, context.NumPriorityGroups, scheduleIdx, groupBatchIdx))
+        return true;
+
+    uint64 firstCandidate = 0;
+    uint64 numCandidates = numBakeGroups;
+    if(context.GroupWindowSize > 0)
+    {
+        // Slide the window past any groups at the front of it that have been fully claimed
+        uint64 windowStart = uint64(queue.WindowStart);
+        while(windowStart < numBakeGroups && context.GroupProgress[groupOrder[windowStart]].ClaimedBatches >= batchesPerGroup)
+        {
+            InterlockedCompareExchange64(&queue.WindowStart, int64(windowStart + 1), int64(windowStart));
+            windowStart = uint64(queue.WindowStart);
+        }
+
+        if(windowStart < numBakeGroups)
+        {
+            firstCandidate = windowStart;
+            numCandidates = std::min(context.GroupWindowSize, numBakeGroups - windowStart);
+        }
+    }
+
+    return ClaimBakeBatchInRange(context, firstCandidate, numCandidates, scheduleIdx, groupBatchIdx);
+}
+
+// Adds the samples in [sampleStart, sampleEnd) to the progressive results for a single texel. The
+// texel's current results are treated as the average of the first sampleStart samples.
+template<typename TBaker> static void BakeProgressiveSamples(BakeThreadContext& context, TBaker& baker, PathTracerParams& params,
+                                                             const IntegrationSamples& integrationSamples, const BakePoint& bakePoint,
+                                                             uint64 groupTexelIdx, uint64 sampleStart, uint64 sampleEnd,
+                                                             Float4 texelResults[TBaker::BasisCount])
+{
+    Random& random = context.RandomGenerator;
+
+    const bool addAreaLight = AppSettings::EnableAreaLight && AppSettings::BakeDirectAreaLight;
+
+    Float3x3 tangentFrame;
+    tangentFrame.SetXBasis(bakePoint.Tangent);
+    tangentFrame.SetYBasis(bakePoint.Bitangent);
+    tangentFrame.SetZBasis(bakePoint.Normal);
+
+    for(uint64 sampleIdx = sampleStart; sampleIdx < sampleEnd; ++sampleIdx)
+    {
+        // The baker only accumulates one sample per pixel in progressive rendering.
+        context.Scratch.Reset();
+        baker.Init(1, texelResults, context.Scratch);
+
+        IntegrationSampleSet sampleSet;
+        sampleSet.Init(integrationSamples, groupTexelIdx, sampleIdx);
+
+        // Create a random ray direction in tangent space, then convert to world space
+        Float3 rayStart = bakePoint.Position;
+        Float3 rayDirTS = baker.SampleDirection(sampleSet.Pixel());
+        Float3 rayDirWS = Float3::Transform(rayDirTS, tangentFrame);
+        rayDirWS = Float3::Normalize(rayDirWS);
+
+        Float3 sampleResult = 0.0f;
+
+        Float2 directAreaLightSample = sampleSet.Lens();
+        if(addAreaLight && directAreaLightSample.x >= 0.5f)
+        {
+            Float3 areaLightIrradiance;
+            sampleResult = SampleAreaLight(bakePoint.Position, bakePoint.Normal, context.SceneBVH->Scene,
+                                           1.0f, 0.0f, false, 0.0f, 1.0f, sampleSet.Lens().x,
+                                           sampleSet.Lens().y, areaLightIrradiance, rayDirWS);
+            rayDirTS = Float3::Transform(rayDirWS, Float3x3::Transpose(tangentFrame));
+        }
+        else
+        {
+            params.RayDir = rayDirWS;
+            params.RayStart = rayStart + 0.1f * rayDirWS;
+            params.RayLen = FLT_MAX;
+            params.SampleSet = &sampleSet;
+
+            float illuminance = 0.0f;
+            bool hitSky = false;
+            sampleResult = PathTrace(params, random, illuminance, hitSky);
+
+            if(AppSettings::BakeDirectSunLight)
+            {
+                Float3 sunLightIrradiance;
+                sampleResult += SampleSunLight(bakePoint.Position, bakePoint.Normal, context.SceneBVH->Scene,
+                    1.0f, 0.0f, false, 0.0f, 1.0f, sampleSet.Lens().x,
+                    sampleSet.Lens().y, sunLightIrradiance);
+            }
+        }
+
+        // Account for equally distributing our samples among the area light and the rest of the environment
+        if(addAreaLight)
+            sampleResult *= 2.0f;
+
+        if (!isfinite(sampleResult.x) || !isfinite(sampleResult.y) || !isfinite(sampleResult.z))
+            sampleResult = 0.0;
+
+        baker.AddSample(rayDirTS, sampleIdx, sampleResult, rayDirWS, bakePoint.Normal);
+
+        baker.ProgressiveResult(texelResults, sampleIdx);
+    }
+}
+
 // Runs a single iteration of the bake thread. If the bake mode supports progressive baking,
-// then this function will add 1 path tracer sample to all texels within the bake group.
+// then this function will add up to ProgressiveSamplesPerBatch path tracer samples to all texels
+// within the bake group (or to one texel per block of texels, for the coarse batches that come
+// first in a coarse-to-fine bake).
 // Otherwise, it will completely bake a single texel within a bake group and flood fill
 // its unbaked neighbors within the thread group.
 template<typename TBaker> static bool BakeDriver(BakeThreadContext& context, TBaker& baker)
@@ -632,23 +1096,32 @@ template<typename TBaker> static bool BakeDriver(BakeThreadContext& context, TBa
     if(context.CurrNumBatches == 0)
         return false;
 
-    const uint64 batchIdx = InterlockedIncrement64(context.CurrBatch) - 1;
-    if(batchIdx >= context.CurrNumBatches)
+    // After a restart, the main thread needs to set up the group progress counters first
+    if(*context.ScheduleTag != int64(context.BakeTag))
+        return false;
+
+    uint64 scheduleIdx = 0;
+    uint64 groupBatchIdx = 0;
+    if(ClaimBakeBatch(context, scheduleIdx, groupBatchIdx) == false)
         return false;
 
     // Are we baking one sample per texel and progessively integrating, or are we going to
     // fully compute the final baked texel value and flood fill the neighbors?
     const bool progressiveintegration = AppSettings::SupportsProgressiveIntegration(context.CurrBakeMode, context.CurrSolveMode);
 
-    // Figure out which 8x8 group we're working on
+    // Figure out which 8x8 group we're working on. Only groups containing active texels are
+    // scheduled, and the schedule computed by BuildBakeGroupSchedule never changes during a bake.
     const uint64 numGroupsX = (context.CurrLightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
-    const uint64 numGroupsY = (context.CurrLightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
-    const uint64 numBakeGroups = numGroupsX * numGroupsY;
-
-    const uint64 groupIdx = batchIdx % numBakeGroups;
+    const std::vector<uint32>& groupSchedule = *context.GroupSchedule;
+    const uint64 groupIdx = groupSchedule[scheduleIdx];
     const uint64 groupIdxX = groupIdx % numGroupsX;
     const uint64 groupIdxY = groupIdx / numGroupsX;
 
+    // Let the checkpoint writer know that this group's results are being modified. Finishing the
+    // scope is also what lets the group's next batch be claimed (see TryClaimGroupBatch).
+    BakeGroupProgress& groupProgress = context.GroupProgress[scheduleIdx];
+    BakeGroupWriteScope groupWriteScope(groupProgress);
+
     const uint64 sqrtNumSamples = context.CurrNumSamples;
     const uint64 numSamplesPerTexel = sqrtNumSamples * sqrtNumSamples;
 
@@ -673,15 +1146,130 @@ template<typename TBaker> static bool BakeDriver(BakeThreadContext& context, TBa
     params.SceneBVH = context.SceneBVH;
     params.SkyCache = &context.SkyCache;
     params.EnvMaps = context.EnvMaps;
+    params.RadianceCache = context.RadianceCache;
+    params.RadianceCacheTag = int64(context.BakeTag);
+    params.FeedbackLightMap = context.FeedbackLightMap;
+    params.FeedbackLightMapSize = context.CurrLightMapSize;
+
+    if(progressiveintegration && groupBatchIdx < context.NumCoarseBatches)
+    {
+        // The covered texels in each block of the group are split up into clusters of texels on the
+        // same surface, and each cluster is represented by its first texel. That texel gets the
+        // cluster's share of the samples for the whole block, and its results are copied to the
+        // rest of the cluster after every batch so that the whole light map fills in with a
+        // blocky preview early on. The fine pass replaces the preview later on (see below).
+        const uint64 blockSize = context.CoarseBlockSize;
+        const uint64 samplesPerBatch = ProgressiveSamplesPerBatch * blockSize * blockSize;
+        const uint64 batchSampleIdx = groupBatchIdx * samplesPerBatch;
+        const uint64 groupOffset = context.BakeOutput->TileOffset(groupIdxX, groupIdxY);
+        const PagedArray<BakePoint>& bakePoints = *context.BakePoints;
+
+        // The coarse texel goes through the full sample range again in the fine pass, so the coarse
+        // batches draw from the next group's sample set to keep those samples from repeating
+        const IntegrationSamples& coarseSamples = (*context.Samples)[(groupIdx + 1) % numThreads];
+
+        for(uint64 blockY = 0; blockY < BakeGroupSizeY; blockY += blockSize)
+        {
+            for(uint64 blockX = 0; blockX < BakeGroupSizeX; blockX += blockSize)
+            {
+                uint64 blockTexels[BakeGroupSize];
+                const BakePoint* blockPoints[BakeGroupSize];
+                uint64 numBlockTexels = 0;
+                for(uint64 groupTexelIdxY = blockY; groupTexelIdxY < blockY + blockSize; ++groupTexelIdxY)
+                {
+                    for(uint64 groupTexelIdxX = blockX; groupTexelIdxX < blockX + blockSize; ++groupTexelIdxX)
+                    {
+                        const uint64 texelIdxX = groupIdxX * BakeGroupSizeX + groupTexelIdxX;
+                        const uint64 texelIdxY = groupIdxY * BakeGroupSizeY + groupTexelIdxY;
+                        if(texelIdxX >= context.CurrLightMapSize || texelIdxY >= context.CurrLightMapSize)
+                            continue;
 
-    if(progressiveintegration)
-    {
-        const uint64 sampleIdx = batchIdx / numBakeGroups;
+                        const BakePoint& bakePoint = bakePoints[texelIdxY * context.CurrLightMapSize + texelIdxX];
+                        if(bakePoint.Coverage == 0 || bakePoint.Coverage == 0xFFFFFFFF)
+                            continue;
+
+                        blockTexels[numBlockTexels] = groupTexelIdxY * BakeGroupSizeX + groupTexelIdxX;
+                        blockPoints[numBlockTexels] = &bakePoint;
+                        ++numBlockTexels;
+                    }
+                }
+
+                // Each texel joins the first cluster whose coarse texel it can share with, or
+                // starts a new one
+                uint64 clusterTexels[BakeGroupSize];
+                for(uint64 i = 0; i < numBlockTexels; ++i)
+                {
+                    clusterTexels[i] = i;
+                    for(uint64 j = 0; j < i; ++j)
+                    {
+                        if(clusterTexels[j] == j && CanShareCoarseTexel(*blockPoints[i], *blockPoints[j], blockSize))
+                        {
+                            clusterTexels[i] = j;
+                            break;
+                        }
+                    }
+                }
+
+                for(uint64 coarseIdx = 0; coarseIdx < numBlockTexels; ++coarseIdx)
+                {
+                    if(clusterTexels[coarseIdx] != coarseIdx)
+                        continue;
+
+                    uint64 clusterSize = 0;
+                    for(uint64 i = coarseIdx; i < numBlockTexels; ++i)
+                        clusterSize += clusterTexels[i] == coarseIdx ? 1 : 0;
+
+                    // Splitting the block's samples between its clusters keeps the cost of the
+                    // coarse pass the same no matter how many surfaces meet in a block
+                    const uint64 clusterSamples = std::max<uint64>(numSamplesPerTexel * clusterSize / numBlockTexels, 1);
+                    const uint64 batchSampleEnd = std::min(batchSampleIdx + samplesPerBatch, clusterSamples);
+                    if(batchSampleIdx >= batchSampleEnd)
+                        continue;
 
-        // Loop over all texels in the 8x8 group, and compute 1 sample for each
-        for(uint64 groupTexelIdxX = 0; groupTexelIdxX < BakeGroupSizeX; ++groupTexelIdxX)
+                    const uint64 coarseTexelIdx = blockTexels[coarseIdx];
+                    Float4 texelResults[TBaker::BasisCount];
+                    if(batchSampleIdx > 0)
+                    {
+                        for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
+                            texelResults[basisIdx] = context.LoadResult(basisIdx, groupOffset + coarseTexelIdx);
+                    }
+
+                    BakeProgressiveSamples(context, baker, params, coarseSamples, *blockPoints[coarseIdx], coarseTexelIdx,
+                                           batchSampleIdx, batchSampleEnd, texelResults);
+
+                    for(uint64 i = coarseIdx; i < numBlockTexels; ++i)
+                    {
+                        if(clusterTexels[i] != coarseIdx)
+                            continue;
+
+                        for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
+                            context.StoreResult(basisIdx, groupOffset + blockTexels[i], texelResults[basisIdx]);
+                    }
+                }
+            }
+        }
+    }
+    else if(progressiveintegration)
+    {
+        // After a coarse pass, every texel starts out showing its coarse texel's results, which
+        // stand in for the texel's share of the block's samples. The fine pass starts over from
+        // scratch in the full-precision results, and only replaces the preview in the display copy
+        // once it has at least that many samples of its own. This way the preview never leaks
+        // into the final results, which come out the same as a bake without the coarse pass.
+        const uint64 fineBatchIdx = groupBatchIdx - context.NumCoarseBatches;
+        const uint64 blockArea = context.CoarseBlockSize * context.CoarseBlockSize;
+        const uint64 previewSamples = context.NumCoarseBatches > 0 ? numSamplesPerTexel / blockArea : 0;
+
+        const uint64 batchSampleIdx = fineBatchIdx * ProgressiveSamplesPerBatch;
+        const uint64 batchSampleEnd = std::min(batchSampleIdx + ProgressiveSamplesPerBatch, numSamplesPerTexel);
+        const bool replacePreview = batchSampleEnd >= previewSamples;
+        const uint64 groupOffset = context.BakeOutput->TileOffset(groupIdxX, groupIdxY);
+
+        // Loop over all texels in the 8x8 group, and compute a batch of samples for each. The
+        // group's results are stored contiguously, so the texels are visited in storage order.
+        for(uint64 groupTexelIdxY = 0; groupTexelIdxY < BakeGroupSizeY; ++groupTexelIdxY)
         {
-            for(uint64 groupTexelIdxY = 0; groupTexelIdxY < BakeGroupSizeY; ++groupTexelIdxY)
+            for(uint64 groupTexelIdxX = 0; groupTexelIdxX < BakeGroupSizeX; ++groupTexelIdxX)
             {
                 const uint64 groupTexelIdx = groupTexelIdxY * BakeGroupSizeX + groupTexelIdxX;
 
@@ -689,104 +1277,56 @@ template<typename TBaker> static bool BakeDriver(BakeThreadContext& context, TBa
                 const uint64 texelIdxX = groupIdxX * BakeGroupSizeX + groupTexelIdxX;
                 const uint64 texelIdxY = groupIdxY * BakeGroupSizeY + groupTexelIdxY;
                 const uint64 texelIdx = texelIdxY * context.CurrLightMapSize + texelIdxX;
+                const uint64 texelOffset = groupOffset + groupTexelIdx;
                 if(texelIdxX >= context.CurrLightMapSize || texelIdxY >= context.CurrLightMapSize)
                     continue;
 
                 // Skip if the texel is empty
-                const std::vector<BakePoint>& bakePoints = *context.BakePoints;
+                const PagedArray<BakePoint>& bakePoints = *context.BakePoints;
                 const BakePoint& bakePoint = bakePoints[texelIdx];
                 if(bakePoint.Coverage == 0 || bakePoint.Coverage == 0xFFFFFFFF)
                     continue;
 
                 Float4 texelResults[TBaker::BasisCount];
-                if(sampleIdx > 0)
+                if(batchSampleIdx > 0)
                 {
                     for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
-                        texelResults[basisIdx] = context.BakeOutput[basisIdx][texelIdx];
+                        texelResults[basisIdx] = context.LoadResult(basisIdx, texelOffset);
                 }
 
-                // The baker only accumulates one sample per pixel in progressive rendering.
-                baker.Init(1, texelResults);
-
-                IntegrationSampleSet sampleSet;
-                sampleSet.Init(integrationSamples, groupTexelIdx, sampleIdx);
-
-                Float3x3 tangentFrame;
-                tangentFrame.SetXBasis(bakePoint.Tangent);
-                tangentFrame.SetYBasis(bakePoint.Bitangent);
-                tangentFrame.SetZBasis(bakePoint.Normal);
-
-                // Create a random ray direction in tangent space, then convert to world space
-                Float3 rayStart = bakePoint.Position;
-                Float3 rayDirTS = baker.SampleDirection(sampleSet.Pixel());
-                Float3 rayDirWS = Float3::Transform(rayDirTS, tangentFrame);
-                rayDirWS = Float3::Normalize(rayDirWS);
-
-                Float3 sampleResult = 0.0f;
+                BakeProgressiveSamples(context, baker, params, integrationSamples, bakePoint, groupTexelIdx,
+                                       batchSampleIdx, batchSampleEnd, texelResults);
 
-                Float2 directAreaLightSample = sampleSet.Lens();
-                if(addAreaLight && directAreaLightSample.x >= 0.5f)
-                {
-                    Float3 areaLightIrradiance;
-                    sampleResult = SampleAreaLight(bakePoint.Position, bakePoint.Normal, context.SceneBVH->Scene,
-                                                   1.0f, 0.0f, false, 0.0f, 1.0f, sampleSet.Lens().x,
-                                                   sampleSet.Lens().y, areaLightIrradiance, rayDirWS);
-                    rayDirTS = Float3::Transform(rayDirWS, Float3x3::Transpose(tangentFrame));
-                }
-                else
+                for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
                 {
-                    params.RayDir = rayDirWS;
-                    params.RayStart = rayStart + 0.1f * rayDirWS;
-                    params.RayLen = FLT_MAX;
-                    params.SampleSet = &sampleSet;
-
-                    float illuminance = 0.0f;
-                    bool hitSky = false;
-                    sampleResult = PathTrace(params, random, illuminance, hitSky);
-
-                    if(AppSettings::BakeDirectSunLight)
-                    {
-                        Float3 sunLightIrradiance;
-                        sampleResult += SampleSunLight(bakePoint.Position, bakePoint.Normal, context.SceneBVH->Scene,
-                            1.0f, 0.0f, false, 0.0f, 1.0f, sampleSet.Lens().x,
-                            sampleSet.Lens().y, sunLightIrradiance);
-                    }
+                    if(replacePreview)
+                        context.StoreResult(basisIdx, texelOffset, texelResults[basisIdx]);
+                    else
+                        context.StoreAccumulator(basisIdx, texelOffset, texelResults[basisIdx]);
                 }
-
-                // Account for equally distributing our samples among the area light and the rest of the environment
-                if(addAreaLight)
-                    sampleResult *= 2.0f;
-
-                if (!isfinite(sampleResult.x) || !isfinite(sampleResult.y) || !isfinite(sampleResult.z))
-                    sampleResult = 0.0;
-
-                baker.AddSample(rayDirTS, sampleIdx, sampleResult, rayDirWS, bakePoint.Normal);
-
-                baker.ProgressiveResult(texelResults, sampleIdx);
-
-                for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
-                    context.BakeOutput[basisIdx][texelIdx] = texelResults[basisIdx];
             }
         }
     }
     else
     {
         Float4 texelResults[TBaker::BasisCount];
-        baker.Init(numSamplesPerTexel, texelResults);
+        context.Scratch.Reset();
+        baker.Init(numSamplesPerTexel, texelResults, context.Scratch);
 
         // Figure out the texel within the group that we're working on (we do 64 passes per group, each one a different texel)
-        const uint64 groupTexelIdx =  batchIdx / numBakeGroups;
+        const uint64 groupTexelIdx = groupBatchIdx;
         const uint64 groupTexelIdxX = groupTexelIdx % BakeGroupSizeX;
         const uint64 groupTexelIdxY = groupTexelIdx / BakeGroupSizeX;
 
         const uint64 texelIdxX = groupIdxX * BakeGroupSizeX + groupTexelIdxX;
         const uint64 texelIdxY = groupIdxY * BakeGroupSizeY + groupTexelIdxY;
         const uint64 texelIdx = texelIdxY * context.CurrLightMapSize + texelIdxX;
+        const uint64 groupOffset = context.BakeOutput->TileOffset(groupIdxX, groupIdxY);
         if(texelIdxX >= context.CurrLightMapSize || texelIdxY >= context.CurrLightMapSize)
             return true;
 
         // Skip if the texel is empty
-        const std::vector<BakePoint>& bakePoints = *context.BakePoints;
+        const PagedArray<BakePoint>& bakePoints = *context.BakePoints;
         const BakePoint& bakePoint = bakePoints[texelIdx];
         if(bakePoint.Coverage == 0 || bakePoint.Coverage == 0xFFFFFFFF)
             return true;
@@ -849,34 +1389,33 @@ template<typename TBaker> static bool BakeDriver(BakeThreadContext& context, TBa
         }
 
         baker.FinalResult(texelResults);
-        for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
-            context.BakeOutput[basisIdx][texelIdx] = texelResults[basisIdx];
 
-        // Temporarily fill in the rest of the texels in the group
-        for(uint64 i = groupTexelIdx; i < BakeGroupSize; ++i)
+        // Write the result, and temporarily fill in the rest of the texels in the group. Padding
+        // texels past the edge of the light map are never read, so they can be written to as well.
+        for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
         {
-            const uint64 offsetX = i % BakeGroupSizeX;
-            const uint64 offsetY = i / BakeGroupSizeX;
-            const uint64 neighborX = groupIdxX * BakeGroupSizeX + offsetX;
-            const uint64 neighborY = groupIdxY * BakeGroupSizeY + offsetY;
-            if(neighborX >= context.CurrLightMapSize || neighborY >= context.CurrLightMapSize)
-                continue;
-
-            uint64 neighborTexelIdx = neighborY * context.CurrLightMapSize + neighborX;
-            for(uint64 basisIdx = 0; basisIdx < TBaker::BasisCount; ++basisIdx)
-                context.BakeOutput[basisIdx][neighborTexelIdx] = texelResults[basisIdx];
+            const Float4 basisResult = texelResults[basisIdx];
+            for(uint64 i = groupTexelIdx; i < BakeGroupSize; ++i)
+                context.StoreResult(basisIdx, groupOffset + i, basisResult);
         }
     }
 
+    // Let the main thread know that the group's tile needs to be uploaded again
+    context.BakeOutput->MarkTileDirty(groupIdx);
+
     return true;
 }
 
 // Data passed to the bake thread entry point
 struct BakeThreadData
 {
-    FixedArray<Float4>* BakeOutput = nullptr;
+    BakeResultStore* BakeOutput = nullptr;
+    BakeResultStore* CompositeOutput = nullptr;
     const std::vector<IntegrationSamples>* Samples = nullptr;
     volatile int64* CurrBatch = nullptr;
+    BakeGroupProgress* GroupProgress = nullptr;
+    BakeGroupQueue* GroupQueue = nullptr;
+    RadianceCache* RadianceCache = nullptr;
     const MeshBaker* Baker = nullptr;
 };
 
@@ -893,8 +1432,9 @@ template<typename TBaker> uint32 __stdcall BakeThread(void* data)
     {
         const uint64 currTag = meshBaker->bakeTag;
         if(context.BakeTag != currTag)
-            context.Init(threadData->BakeOutput, threadData->Samples,
-                         threadData->CurrBatch, threadData->Baker, currTag);
+            context.Init(threadData->BakeOutput, threadData->CompositeOutput, threadData->Samples, threadData->CurrBatch,
+                         threadData->GroupProgress, threadData->GroupQueue, threadData->RadianceCache,
+                         threadData->Baker, currTag);
 
         if(BakeDriver<TBaker>(context, baker) == false)
             Sleep(5);
@@ -903,129 +1443,62 @@ template<typename TBaker> uint32 __stdcall BakeThread(void* data)
     return 0;
 }
 
+typedef uint32 (__stdcall* BakeThreadEntryPoint)(void*);
 
-// Builds a BVH tree for an entire model/scene
-static void BuildBVH(const Model& model, BVHData& bvhData, ID3D11Device* d3dDevice, RTCDevice device)
+// Picks the bake thread entry point for a baker, optionally combined with the composite mode bakers
+template<typename TBaker> static BakeThreadEntryPoint BakeThreadFunction(bool composite)
 {
-    if(bvhData.Scene != nullptr)
-    {
-        rtcDeleteScene(bvhData.Scene);
-        bvhData.Scene = nullptr;
-    }
-    bvhData.Scene = rtcDeviceNewScene(device, RTC_SCENE_DYNAMIC, RTC_INTERSECT1);
-    bvhData.Device = device;
-
-    // Count the total number of vertices and triangles
-    uint32 totalNumVertices = 0;
-    uint32 totalNumTriangles = 0;
-    for(uint64 i = 0; i < model.Meshes().size(); ++i)
-    {
-        const Mesh& mesh = model.Meshes()[i];
-        Assert_(mesh.VertexStride() == sizeof(Vertex));
-        totalNumVertices += mesh.NumVertices();
-        totalNumTriangles += mesh.NumIndices() / 3;
-    }
-
-    bvhData.Triangles.resize(totalNumTriangles);
-    bvhData.Vertices.resize(totalNumVertices);
-    bvhData.MaterialIndices.resize(totalNumTriangles);
-    std::vector<Float4> vertices(totalNumVertices);
-
-    uint32 vtxOffset = 0;
-    uint32 triOffset = 0;
-
-    // Add the data for each mesh
-    for(uint64 meshIdx = 0; meshIdx < model.Meshes().size(); ++meshIdx)
-    {
-        const Mesh& mesh = model.Meshes()[meshIdx];
-        const Vertex* vertexData = reinterpret_cast<const Vertex*>(mesh.Vertices());
-        const uint8* indexData = mesh.Indices();
-        const uint32 numVertices = mesh.NumVertices();
-        const uint32 numIndices = mesh.NumIndices();
-        const uint32 indexSize = mesh.IndexSize();
-        const uint32 vertexStride = mesh.VertexStride();
-
-        // Prepare the triangles
-        const uint32 numTriangles = numIndices / 3;
-        for(uint64 partIdx = 0; partIdx < mesh.MeshParts().size(); ++partIdx)
-        {
-            const MeshPart& meshPart = mesh.MeshParts()[partIdx];
-            const uint32 startTriangle = meshPart.IndexStart / 3;
-            const uint32 endTriangle = (meshPart.IndexStart + meshPart.IndexCount) / 3;
-            for(uint32 i = startTriangle; i < endTriangle; ++i)
-            {
-                const uint32 idx0 = GetIndex(indexData, i * 3 + 0, indexSize) + vtxOffset;
-                const uint32 idx1 = GetIndex(indexData, i * 3 + 1, indexSize) + vtxOffset;
-                const uint32 idx2 = GetIndex(indexData, i * 3 + 2, indexSize) + vtxOffset;
+    if(composite)
+        return BakeThread<CompositeBaker<TBaker, CompositeModeBakers>>;
+    else
+        return BakeThread<TBaker>;
+}
 
-                bvhData.Triangles[i + triOffset] = Uint3(idx0, idx1, idx2);
-                bvhData.MaterialIndices[i + triOffset] = meshPart.MaterialIdx;
-            }
-        }
+// Picks the SG baker that was compiled for the current solve mode
+template<uint64 SGCount> static BakeThreadEntryPoint SGBakeThreadFunction(SolveModes solveMode, bool composite)
+{
+    if(solveMode == SolveModes::SVD)
+        return BakeThreadFunction<SGBaker<SGCount, SolveModes::SVD>>(composite);
+    else if(solveMode == SolveModes::NNLS)
+        return BakeThreadFunction<SGBaker<SGCount, SolveModes::NNLS>>(composite);
+    else if(solveMode == SolveModes::RunningAverage)
+        return BakeThreadFunction<SGBaker<SGCount, SolveModes::RunningAverage>>(composite);
+    else if(solveMode == SolveModes::RunningAverageNN)
+        return BakeThreadFunction<SGBaker<SGCount, SolveModes::RunningAverageNN>>(composite);
+    else
+        return BakeThreadFunction<SGBaker<SGCount, SolveModes::Projection>>(composite);
+}
 
-        // Prepare the vertices
-        for(uint32 i = 0; i < numVertices; ++i)
-        {
-            const Float3& position = vertexData[i].Position;
-            vertices[i + vtxOffset] = Float4(position, 0.0f);
-            bvhData.Vertices[i + vtxOffset] = vertexData[i];
-        }
 
-        triOffset += numTriangles;
-        vtxOffset += numVertices;
-    }
+// Computes lightmap sample points and gutter texels. The bake points are stored densely with one
+// entry per texel, and the active (non-empty, non-gutter) texels are also marked in a mask for
+// each bake group, with one bit per texel. The light map is rasterized one region at a time, so
+// that the render targets only need to be as big as a region no matter how big the light map is.
+static void ExtractBakePoints(const BakeInputData& bakeInput, PagedArray<BakePoint>& bakePoints,
+                              std::vector<uint64>& activeTexelMasks, std::vector<GutterTexel>& gutterTexels,
+                              bool outOfCore)
+{
+    const uint32 LightMapSize = AppSettings::LightMapResolution;
+    const uint64 NumTexels = uint64(LightMapSize) * LightMapSize;
+    const uint64 NumGroupsX = (LightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
+    const uint64 NumGroupsY = (LightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
 
-    uint32 geoID = rtcNewTriangleMesh(bvhData.Scene, RTC_GEOMETRY_STATIC, totalNumTriangles, totalNumVertices);
+    bakePoints.Init(NumTexels, outOfCore);
+    activeTexelMasks.assign(NumGroupsX * NumGroupsY, 0);
+    gutterTexels.clear();
 
-    Float4* meshVerts = reinterpret_cast<Float4*>(rtcMapBuffer(bvhData.Scene, geoID, RTC_VERTEX_BUFFER));
-    memcpy(meshVerts, vertices.data(), totalNumVertices * sizeof(Float4));
-    rtcUnmapBuffer(bvhData.Scene, geoID, RTC_VERTEX_BUFFER);
+    Timer timer;
+    PrintString("Extracting light map sample points...");
 
-    Uint3* meshTriangles = reinterpret_cast<Uint3*>(rtcMapBuffer(bvhData.Scene, geoID, RTC_INDEX_BUFFER));
-    memcpy(meshTriangles, bvhData.Triangles.data(), totalNumTriangles * sizeof(Uint3));
-    rtcUnmapBuffer(bvhData.Scene, geoID, RTC_INDEX_BUFFER);
+    ID3D11Device* device = bakeInput.Device;
+    ID3D11DeviceContextPtr context;
+    device->GetImmediateContext(&context);
 
-    rtcCommit(bvhData.Scene);
-
-    RTCError embreeError = rtcDeviceGetError(device);
-    Assert_(embreeError == RTC_NO_ERROR);
-    if(embreeError != RTC_NO_ERROR)
-        throw Exception(L"Failed to build embree scene!");
-
-    // Load the material texture data
-    const uint64 numMaterials = model.Materials().size();
-    bvhData.MaterialDiffuseMaps.resize(numMaterials);
-    bvhData.MaterialNormalMaps.resize(numMaterials);
-    bvhData.MaterialRoughnessMaps.resize(numMaterials);
-    bvhData.MaterialMetallicMaps.resize(numMaterials);
-
-    for(uint64 i = 0; i < numMaterials; ++i)
-    {
-        const MeshMaterial& material = model.Materials()[i];
-        GetTextureData(d3dDevice, material.DiffuseMap, bvhData.MaterialDiffuseMaps[i]);
-        GetTextureData(d3dDevice, material.NormalMap, bvhData.MaterialNormalMaps[i]);
-        GetTextureData(d3dDevice, material.RoughnessMap, bvhData.MaterialRoughnessMaps[i]);
-        GetTextureData(d3dDevice, material.MetallicMap, bvhData.MaterialMetallicMaps[i]);
-    }
-}
-
-// Computes lightmap sample points and gutter texels
-static void ExtractBakePoints(const BakeInputData& bakeInput, std::vector<BakePoint>& bakePoints,
-                              std::vector<GutterTexel>& gutterTexels)
-{
-    const uint32 LightMapSize = AppSettings::LightMapResolution;
-    const uint64 NumTexels = LightMapSize * LightMapSize;
-
-    bakePoints.clear();
-    bakePoints.resize(NumTexels);
-    gutterTexels.clear();
-
-    Timer timer;
-    PrintString("Extracting light map sample points...");
-
-    ID3D11Device* device = bakeInput.Device;
-    ID3D11DeviceContextPtr context;
-    device->GetImmediateContext(&context);
+    // Each region gets an extra texel of padding on every side, so that gutter texels along the
+    // edge of a region can still check the coverage of their neighbors in the next region
+    const uint32 RegionSize = std::min(LightMapSize, ExtractionRegionSize);
+    const uint32 TargetSize = RegionSize + 2;
+    const uint32 NumRegions = (LightMapSize + RegionSize - 1) / RegionSize;
 
     // Rasterize the mesh to the lightmap in UV space
     const uint32 NumTargets = 5;
@@ -1040,28 +1513,20 @@ static void ExtractBakePoints(const BakeInputData& bakeInput, std::vector<BakePo
 
     RenderTarget2D targets[NumTargets];
     RenderTarget2D msaaTargets[NumTargets];
+    StagingTexture2D stagingTextures[NumTargets];
     for(uint64 i = 0; i < NumTargets; ++i)
     {
-        targets[i].Initialize(bakeInput.Device, LightMapSize, LightMapSize, RTFormats[i]);
-        msaaTargets[i].Initialize(bakeInput.Device, LightMapSize, LightMapSize, RTFormats[i], 1, 8, 0);
+        targets[i].Initialize(bakeInput.Device, TargetSize, TargetSize, RTFormats[i]);
+        msaaTargets[i].Initialize(bakeInput.Device, TargetSize, TargetSize, RTFormats[i], 1, 8, 0);
+        stagingTextures[i].Initialize(device, TargetSize, TargetSize, RTFormats[i]);
     }
 
-    ID3D11RenderTargetView* rtViews[NumTargets];
-    for(uint64 i = 0; i < NumTargets; ++i)
-        rtViews[i] = msaaTargets[i].RTView;
-
-    context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
-
-    float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-    for(uint64 i = 0; i < NumTargets; ++i)
-        context->ClearRenderTargetView(rtViews[i], clearColor);
-
     VertexShaderPtr vs = CompileVSFromFile(device, L"LightMapRasterization.hlsl");
     PixelShaderPtr ps = CompilePSFromFile(device, L"LightMapRasterization.hlsl");
+    VertexShaderPtr resolveVS = CompileVSFromFile(device, L"LightMapRasterization.hlsl", "ResolveVS");
+    PixelShaderPtr resolvePS = CompilePSFromFile(device, L"LightMapRasterization.hlsl", "ResolvePS");
 
-    context->VSSetShader(vs, nullptr, 0);
     context->GSSetShader(nullptr, nullptr, 0);
-    context->PSSetShader(ps, nullptr, 0);
     context->HSSetShader(nullptr, nullptr, 0);
     context->DSSetShader(nullptr, nullptr, 0);
 
@@ -1078,178 +1543,426 @@ static void ExtractBakePoints(const BakeInputData& bakeInput, std::vector<BakePo
     dsStates.Initialize(device);
     context->OMSetDepthStencilState(dsStates.DepthDisabled(), 0);
 
-    D3D11_VIEWPORT viewport;
-    viewport.Width = float(LightMapSize);
-    viewport.Height = float(LightMapSize);
-    viewport.TopLeftX = 0.0f;
-    viewport.TopLeftY = 0.0f;
-    viewport.MinDepth = 0.0f;
-    viewport.MaxDepth = 1.0f;
-    context->RSSetViewports(1, &viewport);
-
     ConstantBuffer<uint32> constantBuffer;
     constantBuffer.Initialize(device);
-    constantBuffer.SetPS(context, 0);
-
-    uint32 vertexOffset = 0;
 
     const Model& model = *bakeInput.SceneModel;
     const std::vector<Mesh>& meshes = model.Meshes();
+    std::vector<ID3D11InputLayoutPtr> inputLayouts(meshes.size());
     for(uint64 meshIdx = 0; meshIdx < meshes.size(); ++meshIdx)
     {
         const Mesh& mesh = meshes[meshIdx];
-
-        ID3D11InputLayoutPtr inputLayout;
         DXCall(device->CreateInputLayout(mesh.InputElements(), mesh.NumInputElements(),
                                          vs->ByteCode->GetBufferPointer(),
-                                         vs->ByteCode->GetBufferSize(), &inputLayout));
-        context->IASetInputLayout(inputLayout);
+                                         vs->ByteCode->GetBufferSize(), &inputLayouts[meshIdx]));
+    }
 
-        ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
-        UINT vertexStrides[1] = { mesh.VertexStride() };
-        UINT offsets[1] = { 0 };
-        context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
-        context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    ID3D11RenderTargetView* rtViews[NumTargets];
+    ID3D11ShaderResourceView* srViews[NumTargets];
 
-        constantBuffer.Data = vertexOffset;
-        constantBuffer.ApplyChanges(context);
+    for(uint32 regionY = 0; regionY < NumRegions; ++regionY)
+    {
+        for(uint32 regionX = 0; regionX < NumRegions; ++regionX)
+        {
+            // Texel (startX, startY) of the light map ends up at (1, 1) in the targets
+            const uint32 startX = regionX * RegionSize;
+            const uint32 startY = regionY * RegionSize;
+            const uint32 endX = std::min(startX + RegionSize, LightMapSize);
+            const uint32 endY = std::min(startY + RegionSize, LightMapSize);
+
+            for(uint64 i = 0; i < NumTargets; ++i)
+                rtViews[i] = msaaTargets[i].RTView;
+            context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
+
+            float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for(uint64 i = 0; i < NumTargets; ++i)
+                context->ClearRenderTargetView(rtViews[i], clearColor);
+
+            context->VSSetShader(vs, nullptr, 0);
+            context->PSSetShader(ps, nullptr, 0);
+
+            // The viewport still covers the whole light map, it's just shifted so that the region
+            // lands in the targets. This keeps the rasterization identical to rendering it all at once.
+            D3D11_VIEWPORT viewport;
+            viewport.Width = float(LightMapSize);
+            viewport.Height = float(LightMapSize);
+            viewport.TopLeftX = 1.0f - float(startX);
+            viewport.TopLeftY = 1.0f - float(startY);
+            viewport.MinDepth = 0.0f;
+            viewport.MaxDepth = 1.0f;
+            context->RSSetViewports(1, &viewport);
+
+            constantBuffer.SetPS(context, 0);
+
+            uint32 vertexOffset = 0;
+            for(uint64 meshIdx = 0; meshIdx < meshes.size(); ++meshIdx)
+            {
+                const Mesh& mesh = meshes[meshIdx];
+                context->IASetInputLayout(inputLayouts[meshIdx]);
 
-        context->DrawIndexed(mesh.NumIndices(), 0, 0);
+                ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
+                UINT vertexStrides[1] = { mesh.VertexStride() };
+                UINT offsets[1] = { 0 };
+                context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
+                context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
+                context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        vertexOffset += mesh.NumVertices();
-    }
+                constantBuffer.Data = vertexOffset;
+                constantBuffer.ApplyChanges(context);
 
-    // Resolve the targets
-    VertexShaderPtr resolveVS = CompileVSFromFile(device, L"LightMapRasterization.hlsl", "ResolveVS");
-    PixelShaderPtr resolvePS = CompilePSFromFile(device, L"LightMapRasterization.hlsl", "ResolvePS");
-    context->VSSetShader(resolveVS, nullptr, 0);
-    context->PSSetShader(resolvePS, nullptr, 0);
+                context->DrawIndexed(mesh.NumIndices(), 0, 0);
 
-    for(uint64 i = 0; i < NumTargets; ++i)
-        rtViews[i] = targets[i].RTView;
-    context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
+                vertexOffset += mesh.NumVertices();
+            }
 
-    context->IASetInputLayout(nullptr);
-    context->IASetIndexBuffer(nullptr, DXGI_FORMAT_R16_UINT, 0);
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            // Resolve the targets
+            context->VSSetShader(resolveVS, nullptr, 0);
+            context->PSSetShader(resolvePS, nullptr, 0);
 
-    ID3D11Buffer* vertexBuffers[1] = { nullptr };
-    UINT vertexStrides[1] = { 0 };
-    UINT offsets[1] = { 0 };
-    context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
+            D3D11_VIEWPORT resolveViewport;
+            resolveViewport.Width = float(TargetSize);
+            resolveViewport.Height = float(TargetSize);
+            resolveViewport.TopLeftX = 0.0f;
+            resolveViewport.TopLeftY = 0.0f;
+            resolveViewport.MinDepth = 0.0f;
+            resolveViewport.MaxDepth = 1.0f;
+            context->RSSetViewports(1, &resolveViewport);
 
-    ID3D11ShaderResourceView* srViews[NumTargets];
-    for(uint64 i = 0; i < NumTargets; ++i)
-        srViews[i] = msaaTargets[i].SRView;
-    context->PSSetShaderResources(0, NumTargets, srViews);
+            for(uint64 i = 0; i < NumTargets; ++i)
+                rtViews[i] = targets[i].RTView;
+            context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
 
-    context->Draw(3, 0);
+            context->IASetInputLayout(nullptr);
+            context->IASetIndexBuffer(nullptr, DXGI_FORMAT_R16_UINT, 0);
+            context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    context->VSSetShader(nullptr, nullptr, 0);
-    context->GSSetShader(nullptr, nullptr, 0);
-    context->PSSetShader(nullptr, nullptr, 0);
+            ID3D11Buffer* vertexBuffers[1] = { nullptr };
+            UINT vertexStrides[1] = { 0 };
+            UINT offsets[1] = { 0 };
+            context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
 
-    for(uint64 i = 0; i < NumTargets; ++i)
-    {
-        rtViews[i] = nullptr;
-        srViews[i] = nullptr;
-    }
+            for(uint64 i = 0; i < NumTargets; ++i)
+                srViews[i] = msaaTargets[i].SRView;
+            context->PSSetShaderResources(0, NumTargets, srViews);
 
-    context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
-    context->PSSetShaderResources(0, NumTargets, srViews);
+            context->Draw(3, 0);
 
-    // Read back the results, and extract the sample points
-    StagingTexture2D stagingTextures[NumTargets];
-    uint32 pitches[5] = { 0 };
-    const uint8* textureData[5] = { nullptr };
-    for(uint64 i = 0; i < NumTargets; ++i)
-    {
-        stagingTextures[i].Initialize(device, LightMapSize, LightMapSize, RTFormats[i]);
-        context->CopyResource(stagingTextures[i].Texture, targets[i].Texture);
-        textureData[i] = reinterpret_cast<uint8*>(stagingTextures[i].Map(context, 0, pitches[i]));
-    }
+            context->VSSetShader(nullptr, nullptr, 0);
+            context->PSSetShader(nullptr, nullptr, 0);
 
-    for(uint32 y = 0; y < LightMapSize; ++y)
-    {
-        const Float4* positions = reinterpret_cast<const Float4*>(textureData[0] + y * pitches[0]);
-        const Float4* normals = reinterpret_cast<const Float4*>(textureData[1] + y * pitches[1]);
-        const Float4* tangents = reinterpret_cast<const Float4*>(textureData[2] + y * pitches[2]);
-        const Float4* bitangents = reinterpret_cast<const Float4*>(textureData[3] + y * pitches[3]);
-        const uint32* coverage = reinterpret_cast<const uint32*>(textureData[4] + y * pitches[4]);
-        for(uint32 x = 0; x < LightMapSize; ++x)
-        {
-            const uint64 pointIdx = y * LightMapSize + x;
-            BakePoint& bakePoint = bakePoints[pointIdx];
+            for(uint64 i = 0; i < NumTargets; ++i)
+            {
+                rtViews[i] = nullptr;
+                srViews[i] = nullptr;
+            }
+
+            context->OMSetRenderTargets(NumTargets, rtViews, nullptr);
+            context->PSSetShaderResources(0, NumTargets, srViews);
 
-            if(coverage[x] != 0)
+            // Read back the results, and extract the sample points
+            uint32 pitches[NumTargets] = { 0 };
+            const uint8* textureData[NumTargets] = { nullptr };
+            for(uint64 i = 0; i < NumTargets; ++i)
             {
-                // Active texel, extract the relevent data from the rasterization result
-                bakePoint.Position = positions[x].To3D();
-                bakePoint.Normal = normals[x].To3D();
-                bakePoint.Tangent = tangents[x].To3D();
-                bakePoint.Bitangent = bitangents[x].To3D();
-                bakePoint.Size = Float2(positions[x].w, normals[x].w);
-                bakePoint.Coverage = coverage[x];
-                bakePoint.TexelPos = Uint2(x, y);
-                bakePoints.push_back(bakePoint);
+                context->CopyResource(stagingTextures[i].Texture, targets[i].Texture);
+                textureData[i] = reinterpret_cast<uint8*>(stagingTextures[i].Map(context, 0, pitches[i]));
             }
-            else
+
+            for(uint32 y = startY; y < endY; ++y)
             {
-                // Check if this is a gutter texel that needs to replicate its value from a neighbor
-                GutterTexel gutterTexel;
-                gutterTexel.TexelPos = Uint2(x, y);
-                int32 currDist = 0;
-                bool foundNeighbor = false;
-
-                // Empty texel, look for nearby active texels to see if we're a gutter texel
-                for(int32 ny = -1; ny <= 1; ++ny)
+                const uint32 targetY = y - startY + 1;
+                const Float4* positions = reinterpret_cast<const Float4*>(textureData[0] + targetY * pitches[0]);
+                const Float4* normals = reinterpret_cast<const Float4*>(textureData[1] + targetY * pitches[1]);
+                const Float4* tangents = reinterpret_cast<const Float4*>(textureData[2] + targetY * pitches[2]);
+                const Float4* bitangents = reinterpret_cast<const Float4*>(textureData[3] + targetY * pitches[3]);
+                const uint32* coverage = reinterpret_cast<const uint32*>(textureData[4] + targetY * pitches[4]);
+                for(uint32 x = startX; x < endX; ++x)
                 {
-                    int32 neighborY = y + ny;
-                    if(neighborY < 0 || neighborY >= int32(LightMapSize))
-                        continue;
+                    const uint32 targetX = x - startX + 1;
+                    const uint64 pointIdx = uint64(y) * LightMapSize + x;
+                    BakePoint& bakePoint = bakePoints[pointIdx];
 
-                    for(int32 nx = -1; nx <= 1; ++nx)
+                    if(coverage[targetX] != 0)
                     {
-                        if(nx == 0 && ny == 0)
-                            continue;
-
-                        int32 neighborX = x + nx;
-                        if(neighborX < 0 || neighborX >= int32(LightMapSize))
-                            continue;
-
-                        int32 dist = std::abs(nx) + std::abs(ny);
-                        if(foundNeighbor && dist >= currDist)
-                            continue;
+                        // Active texel, extract the relevent data from the rasterization result
+                        bakePoint.Position = positions[targetX].To3D();
+                        bakePoint.Normal = normals[targetX].To3D();
+                        bakePoint.Tangent = tangents[targetX].To3D();
+                        bakePoint.Bitangent = bitangents[targetX].To3D();
+                        bakePoint.Size = Float2(positions[targetX].w, normals[targetX].w);
+                        bakePoint.Coverage = coverage[targetX];
+                        bakePoint.TexelPos = Uint2(x, y);
+                        activeTexelMasks[(y / BakeGroupSizeY) * NumGroupsX + (x / BakeGroupSizeX)] |= GroupTexelBit(x, y);
+                    }
+                    else
+                    {
+                        // Check if this is a gutter texel that needs to replicate its value from a neighbor
+                        GutterTexel gutterTexel;
+                        gutterTexel.TexelPos = Uint2(x, y);
+                        int32 currDist = 0;
+                        bool foundNeighbor = false;
+
+                        // Empty texel, look for nearby active texels to see if we're a gutter texel
+                        for(int32 ny = -1; ny <= 1; ++ny)
+                        {
+                            int32 neighborY = y + ny;
+                            if(neighborY < 0 || neighborY >= int32(LightMapSize))
+                                continue;
+
+                            for(int32 nx = -1; nx <= 1; ++nx)
+                            {
+                                if(nx == 0 && ny == 0)
+                                    continue;
+
+                                int32 neighborX = x + nx;
+                                if(neighborX < 0 || neighborX >= int32(LightMapSize))
+                                    continue;
+
+                                int32 dist = std::abs(nx) + std::abs(ny);
+                                if(foundNeighbor && dist >= currDist)
+                                    continue;
+
+                                int32 offset = (targetY + ny) * pitches[4] + (targetX + nx) * sizeof(uint32);
+                                const uint32 neighborCoverage = *reinterpret_cast<const uint32*>(textureData[4] + offset);
+                                if(neighborCoverage != 0)
+                                {
+                                    gutterTexel.NeighborPos = Uint2(neighborX, neighborY);
+                                    foundNeighbor = true;
+                                    currDist = dist;
+                                }
+                            }
+                        }
 
-                        int32 offset = neighborY * pitches[4] + neighborX * sizeof(uint32);
-                        const uint32 neighborCoverage = *reinterpret_cast<const uint32*>(textureData[4] + offset);
-                        if(neighborCoverage != 0)
+                        if(foundNeighbor)
                         {
-                            gutterTexel.NeighborPos = Uint2(neighborX, neighborY);
-                            foundNeighbor = true;
-                            currDist = dist;
+                            // Mark it as a gutter texel
+                            bakePoint.Coverage = 0xFFFFFFFF;
+                            bakePoint.TexelPos = gutterTexel.NeighborPos;
+                            gutterTexels.push_back(gutterTexel);
                         }
                     }
                 }
+            }
+
+            for(uint64 i = 0; i < NumTargets; ++i)
+                stagingTextures[i].Unmap(context, 0);
+        }
+    }
+
+    timer.Update();
+    PrintString("Finished! (%fs)", timer.DeltaSecondsF());
+}
+
+// Spreads the low 10 bits of a value so that there are 2 zero bits between each bit
+static uint32 SpreadBits3D(uint32 x)
+{
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// Sorts the groups in a bake schedule along a Morton curve through their world-space centers
+static void SortBakeGroupSchedule(const std::vector<Float3>& groupCenters, const Float3& boundsMin,
+                                  const Float3& boundsMax, std::vector<uint32>& groupSchedule)
+{
+    const Float3 boundsSize = Float3::Max(boundsMax - boundsMin, Float3(1e-6f, 1e-6f, 1e-6f));
+    std::vector<uint64> sortKeys(groupSchedule.size());
+    for(uint64 i = 0; i < groupSchedule.size(); ++i)
+    {
+        const Float3 normalized = (groupCenters[groupSchedule[i]] - boundsMin) / boundsSize;
+        const uint32 qx = uint32(Saturate(normalized.x) * 1023.0f);
+        const uint32 qy = uint32(Saturate(normalized.y) * 1023.0f);
+        const uint32 qz = uint32(Saturate(normalized.z) * 1023.0f);
+        const uint32 mortonCode = SpreadBits3D(qx) | (SpreadBits3D(qy) << 1) | (SpreadBits3D(qz) << 2);
+
+        // Pack the group index into the low bits so that the sort is deterministic
+        sortKeys[i] = (uint64(mortonCode) << 32) | groupSchedule[i];
+    }
+
+    std::sort(sortKeys.begin(), sortKeys.end());
+    for(uint64 i = 0; i < sortKeys.size(); ++i)
+        groupSchedule[i] = uint32(sortKeys[i] & 0xFFFFFFFF);
+}
+
+// Builds the list of bake groups that contain at least one active texel, sorted along a Morton
+// curve through the world-space center of each group. Consecutive batches then work on texels
+// that are close together in the scene, which keeps the BVH nodes and radiance cache cells that
+// they touch warm in the cache. For an out-of-core bake the groups are left in light map order
+// instead, since that's the order that the bake points and results are laid out in on disk. A
+// world-space bounding sphere is also returned for each group in the schedule, which is used for
+// prioritizing the groups that the camera can see.
+static void BuildBakeGroupSchedule(const PagedArray<BakePoint>& bakePoints, const std::vector<uint64>& activeTexelMasks,
+                                   uint64 lightMapSize, bool lightMapOrder, std::vector<uint32>& groupSchedule,
+                                   std::vector<Float4>& groupBounds)
+{
+    groupSchedule.clear();
+    groupBounds.clear();
+
+    const uint64 numGroupsX = (lightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
+    const uint64 numGroupsY = (lightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
+    const uint64 numGroups = numGroupsX * numGroupsY;
+    Assert_(activeTexelMasks.size() == numGroups);
+
+    std::vector<Float3> groupCenters(numGroups, Float3(0.0f, 0.0f, 0.0f));
+    std::vector<uint32> groupTexelCounts(numGroups, 0);
+
+    for(uint64 groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+    {
+        const uint64 activeMask = activeTexelMasks[groupIdx];
+        for(uint64 bitIdx = 0; bitIdx < BakeGroupSize && (activeMask >> bitIdx) != 0; ++bitIdx)
+        {
+            if((activeMask & (uint64(1) << bitIdx)) == 0)
+                continue;
+
+            const BakePoint& bakePoint = bakePoints[GroupTexelIndex(groupIdx, bitIdx, numGroupsX, lightMapSize)];
+            groupCenters[groupIdx] += bakePoint.Position;
+            groupTexelCounts[groupIdx] += 1;
+        }
+    }
+
+    Float3 boundsMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+    Float3 boundsMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for(uint64 groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+    {
+        if(groupTexelCounts[groupIdx] == 0)
+            continue;
+
+        const Float3 center = groupCenters[groupIdx] / float(groupTexelCounts[groupIdx]);
+        groupCenters[groupIdx] = center;
+        boundsMin = Float3(Min(boundsMin.x, center.x), Min(boundsMin.y, center.y), Min(boundsMin.z, center.z));
+        boundsMax = Float3::Max(boundsMax, center);
+        groupSchedule.push_back(uint32(groupIdx));
+    }
+
+    if(groupSchedule.size() == 0)
+        return;
+
+    if(lightMapOrder == false)
+        SortBakeGroupSchedule(groupCenters, boundsMin, boundsMax, groupSchedule);
+
+    // Grow each group's sphere to include all of its texels, with a bit of padding for their size
+    std::vector<float> groupRadii(numGroups, 0.0f);
+    for(uint64 groupIdx = 0; groupIdx < numGroups; ++groupIdx)
+    {
+        const uint64 activeMask = activeTexelMasks[groupIdx];
+        for(uint64 bitIdx = 0; bitIdx < BakeGroupSize && (activeMask >> bitIdx) != 0; ++bitIdx)
+        {
+            if((activeMask & (uint64(1) << bitIdx)) == 0)
+                continue;
 
-                if(foundNeighbor)
+            const BakePoint& bakePoint = bakePoints[GroupTexelIndex(groupIdx, bitIdx, numGroupsX, lightMapSize)];
+            const float texelRadius = Float3::Length(bakePoint.Position - groupCenters[groupIdx]) + Max(bakePoint.Size.x, bakePoint.Size.y);
+            groupRadii[groupIdx] = Max(groupRadii[groupIdx], texelRadius);
+        }
+    }
+
+    groupBounds.resize(groupSchedule.size());
+    for(uint64 i = 0; i < groupSchedule.size(); ++i)
+        groupBounds[i] = Float4(groupCenters[groupSchedule[i]], groupRadii[groupSchedule[i]]);
+}
+
+// Gathers the bake points for the visualizer. When the light map texture is downsampled, only the
+// first active texel in each block of texels that shares a texture texel is included, which keeps
+// the buffer from growing past what an in-core light map would need.
+static void GatherVisualizerBakePoints(const PagedArray<BakePoint>& bakePoints, const std::vector<uint64>& activeTexelMasks,
+                                       uint64 lightMapSize, uint64 textureScale, std::vector<BakePoint>& visualizerPoints)
+{
+    visualizerPoints.clear();
+
+    const uint64 numGroupsX = (lightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
+    for(uint64 groupIdx = 0; groupIdx < activeTexelMasks.size(); ++groupIdx)
+    {
+        const uint64 activeMask = activeTexelMasks[groupIdx];
+        if(activeMask == 0)
+            continue;
+
+        for(uint64 blockY = 0; blockY < BakeGroupSizeY; blockY += textureScale)
+        {
+            for(uint64 blockX = 0; blockX < BakeGroupSizeX; blockX += textureScale)
+            {
+                bool found = false;
+                for(uint64 y = blockY; y < blockY + textureScale && found == false; ++y)
                 {
-                    // Mark it as a gutter texel
-                    bakePoint.Coverage = 0xFFFFFFFF;
-                    bakePoint.TexelPos = gutterTexel.NeighborPos;
-                    gutterTexels.push_back(gutterTexel);
+                    for(uint64 x = blockX; x < blockX + textureScale && found == false; ++x)
+                    {
+                        const uint64 bitIdx = y * BakeGroupSizeX + x;
+                        if(activeMask & (uint64(1) << bitIdx))
+                        {
+                            visualizerPoints.push_back(bakePoints[GroupTexelIndex(groupIdx, bitIdx, numGroupsX, lightMapSize)]);
+                            found = true;
+                        }
+                    }
                 }
             }
         }
     }
+}
 
-    for(uint64 i = 0; i < NumTargets; ++i)
-        stagingTextures[i].Unmap(context, 0);
+// Offsets to the 8 neighbors of a tile, in the order of the bits in the gutter dependency masks
+static const int32 NeighborTileOffsets[8][2] =
+{
+    { -1, -1 }, { 0, -1 }, { 1, -1 },
+    { -1, 0 }, { 1, 0 },
+    { -1, 1 }, { 0, 1 }, { 1, 1 },
+};
 
+static uint8 NeighborTileBit(int32 offsetX, int32 offsetY)
+{
+    for(uint32 i = 0; i < 8; ++i)
+        if(NeighborTileOffsets[i][0] == offsetX && NeighborTileOffsets[i][1] == offsetY)
+            return uint8(1 << i);
 
-    timer.Update();
-    PrintString("Finished! (%fs)", timer.DeltaSecondsF());
+    Assert_(false);
+    return 0;
+}
+
+// Sorts the gutter texels by the tile that they're in, so that the gutter texels for a tile can
+// be filled in when that tile gets uploaded. Since gutter texels copy from texels that can be in
+// a neighboring tile, each tile also gets a mask of the neighbors that need to be uploaded again
+// when the tile changes.
+static void BuildGutterTileLists(std::vector<GutterTexel>& gutterTexels, uint64 lightMapSize,
+                                 std::vector<uint32>& tileStarts, std::vector<uint8>& tileDependents)
+{
+    const uint64 numTilesX = (lightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
+    const uint64 numTilesY = (lightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
+    const uint64 numTiles = numTilesX * numTilesY;
+
+    const uint64 numGutterTexels = gutterTexels.size();
+    std::vector<uint64> sortKeys(numGutterTexels);
+    for(uint64 i = 0; i < numGutterTexels; ++i)
+    {
+        const Uint2 texelPos = gutterTexels[i].TexelPos;
+        const uint64 tileIdx = (texelPos.y / BakeGroupSizeY) * numTilesX + (texelPos.x / BakeGroupSizeX);
+        sortKeys[i] = (tileIdx << 32) | i;
+    }
+
+    std::sort(sortKeys.begin(), sortKeys.end());
+
+    std::vector<GutterTexel> sortedTexels(numGutterTexels);
+    for(uint64 i = 0; i < numGutterTexels; ++i)
+        sortedTexels[i] = gutterTexels[sortKeys[i] & 0xFFFFFFFF];
+    gutterTexels.swap(sortedTexels);
+
+    tileStarts.assign(numTiles + 1, 0);
+    tileDependents.assign(numTiles, 0);
+    for(uint64 i = 0; i < numGutterTexels; ++i)
+    {
+        const GutterTexel& gutterTexel = gutterTexels[i];
+        const int32 tileX = int32(gutterTexel.TexelPos.x / BakeGroupSizeX);
+        const int32 tileY = int32(gutterTexel.TexelPos.y / BakeGroupSizeY);
+        const int32 srcTileX = int32(gutterTexel.NeighborPos.x / BakeGroupSizeX);
+        const int32 srcTileY = int32(gutterTexel.NeighborPos.y / BakeGroupSizeY);
+        tileStarts[tileY * numTilesX + tileX + 1] += 1;
+
+        if(srcTileX != tileX || srcTileY != tileY)
+            tileDependents[srcTileY * numTilesX + srcTileX] |= NeighborTileBit(tileX - srcTileX, tileY - srcTileY);
+    }
+
+    for(uint64 tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+        tileStarts[tileIdx + 1] += tileStarts[tileIdx];
 }
 
 // == Ground Truth Rendering ======================================================================
@@ -1272,12 +1985,10 @@ struct RenderThreadContext
     SampleModes CurrSampleMode = SampleModes::Random;
     uint64 CurrNumSamples = 0;
     const std::vector<IntegrationSamples>* Samples;
-    FixedArray<Half4>* RenderBuffer = nullptr;
-    FixedArray<float>* RenderWeightBuffer = nullptr;
+    RenderResultStore* RenderOutput = nullptr;
     volatile int64* CurrTile = nullptr;
 
-    void Init(FixedArray<Half4>* renderBuffer, FixedArray<float>* renderWeightBuffer,
-              const std::vector<IntegrationSamples>* samples,
+    void Init(RenderResultStore* renderOutput, const std::vector<IntegrationSamples>* samples,
               volatile int64* currTile, const MeshBaker* meshBaker, uint64 newTag)
     {
         if(RenderTag == uint64(-1))
@@ -1294,8 +2005,7 @@ struct RenderThreadContext
         Proj = meshBaker->currProj;
         ViewProjInv = meshBaker->currViewProjInv;
         CurrNumTiles = meshBaker->currNumTiles;
-        RenderBuffer = renderBuffer;
-        RenderWeightBuffer = renderWeightBuffer;
+        RenderOutput = renderOutput;
         CurrTile = currTile;
         CurrSampleMode = AppSettings::RenderSampleMode;
         CurrNumSamples = AppSettings::NumRenderSamples;
@@ -1304,7 +2014,7 @@ struct RenderThreadContext
 };
 
 // Runs a single iteration of the ground truth render thread. This function will compute
-// a single radiance for every pixel within a tile, and blend with with the previous result.
+// a single radiance for every pixel within a tile, and add it to the tile's running sums.
 static bool RenderDriver(RenderThreadContext& context)
 {
     if(context.CurrNumTiles == 0)
@@ -1353,12 +2063,14 @@ static bool RenderDriver(RenderThreadContext& context)
 
     const int32 pathLength = AppSettings::EnableIndirectLighting ? AppSettings::MaxRenderPathLength : 2;
 
+    // Samples get accumulated into this tile's block of the render results
+    RenderResultStore::Tile& tile = context.RenderOutput->GetTile(passTileIdx);
+
     uint64 tilePixelIdx = 0;
     for(uint64 y = startY; y < endY; ++y)
     {
         for(uint64 x = startX; x < endX; ++x)
         {
-            const uint64 pixelIdx = (y * screenWidth + x);
             IntegrationSampleSet sampleSet;
             sampleSet.Init(samples, tilePixelIdx, passIdx);
 
@@ -1413,28 +2125,33 @@ static bool RenderDriver(RenderThreadContext& context)
             params.RussianRouletteProbability = AppSettings::RenderRussianRouletteProbability;
             Float3 radiance = PathTrace(params, context.RandomGenerator, illuminance, hitSky);
 
-            FixedArray<Half4>& renderBuffer = *context.RenderBuffer;
-            FixedArray<float>& renderWeightBuffer = *context.RenderWeightBuffer;
-            Float4 oldValue = renderBuffer[pixelIdx].ToFloat4();
-
-            float oldWeight = passIdx > 0 ? renderWeightBuffer[pixelIdx] : 0.0f;
-            Float4 newValue = (oldValue * oldWeight) + Float4(radiance, illuminance);
-            float newWeight = oldWeight + 1.0f;
-            renderBuffer[pixelIdx] = Float4::Clamp(newValue / newWeight, 0.0f, FP16Max);
-            renderWeightBuffer[pixelIdx] = newWeight;
+            // The first pass overwrites whatever was left over from the previous render
+            const uint64 tileOffset = (y - startY) * TileSize + (x - startX);
+            const Float4 sample = Float4(radiance, illuminance);
+            if(passIdx > 0)
+            {
+                tile.Sums[tileOffset] += sample;
+                tile.Counts[tileOffset] += 1.0f;
+            }
+            else
+            {
+                tile.Sums[tileOffset] = sample;
+                tile.Counts[tileOffset] = 1.0f;
+            }
 
             ++tilePixelIdx;
         }
     }
 
+    context.RenderOutput->MarkTileDirty(passTileIdx);
+
     return true;
 }
 
 // Data passed to the ground truth render thread
 struct RenderThreadData
 {
-    FixedArray<Half4>* RenderBuffer = nullptr;
-    FixedArray<float>* RenderWeightBuffer = nullptr;
+    RenderResultStore* RenderOutput = nullptr;
     const std::vector<IntegrationSamples>* Samples = nullptr;
     volatile int64* CurrTile = nullptr;
     const MeshBaker* Baker = nullptr;
@@ -1452,8 +2169,8 @@ static uint32 __stdcall RenderThread(void* data)
     {
         const uint64 currTag = meshBaker->renderTag;
         if(context.RenderTag != currTag)
-            context.Init(threadData->RenderBuffer, threadData->RenderWeightBuffer, threadData->Samples,
-                         threadData->CurrTile, threadData->Baker, currTag);
+            context.Init(threadData->RenderOutput, threadData->Samples, threadData->CurrTile,
+                         threadData->Baker, currTag);
 
         if(RenderDriver(context) == false)
             Sleep(5);
@@ -1495,7 +2212,8 @@ void MeshBaker::Initialize(const BakeInputData& inputData)
         throw Exception(L"Failed to initialize embree!");
 
     // Build the BVHs
-    BuildBVH(*input.SceneModel, sceneBVH, input.Device, rtcDevice);
+    BuildBVH(*input.SceneModel, input.SceneModelCache, sceneBVH, input.Device, rtcDevice);
+    sceneHash = ComputeBakeSceneHash(sceneBVH);
 
     renderSampleMode = AppSettings::RenderSampleMode;
     numRenderSamples = AppSettings::NumRenderSamples;
@@ -1505,16 +2223,17 @@ void MeshBaker::Initialize(const BakeInputData& inputData)
 
     numThreads = GetNumThreads();
     renderSamples.resize(numThreads);
-    bakeSamples.resize(numThreads);
+
+    // The coarse pass of a coarse-to-fine bake needs a different sample set than the fine pass
+    bakeSamples.resize(std::max<uint64>(numThreads, 2));
 
     for(uint64 i = 0; i < numThreads; ++i)
-    {
         GenerateIntegrationSamples(renderSamples[i], numRenderSamples, TileSize, TileSize,
                                    renderSampleMode, NumIntegrationTypes, rng);
 
+    for(uint64 i = 0; i < bakeSamples.size(); ++i)
         GenerateIntegrationSamples(bakeSamples[i], numBakeSamples, BakeGroupSize, 1,
                                    bakeSampleMode, NumIntegrationTypes, rng);
-    }
 
     initialized = true;
 }
@@ -1527,27 +2246,45 @@ void MeshBaker::Shutdown()
     KillBakeThreads();
     KillRenderThreads();
 
+    bakeCoordinator.Shutdown();
+    bakeWorker.Shutdown();
+    feedbackBuilder.Discard();
+
     // Shutdown embree
+    bvhBuilder.Discard();
     sceneBVH = BVHData();
     rtcDeleteDevice(rtcDevice);
     rtcDevice = nullptr;
 }
 
 MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint32 screenHeight,
-                                  ID3D11DeviceContext* deviceContext, const Model* currentModel)
+                                  ID3D11DeviceContext* deviceContext, const Model* currentModel,
+                                  const SceneCache* currentSceneCache)
 {
     Assert_(initialized);
 
     const bool32 showGroundTruth = AppSettings::ShowGroundTruth;
 
-    if(currentModel != input.SceneModel)
+    // The BVH for a new scene gets built in the background, and the old scene keeps rendering and
+    // baking until it's ready. A build for a scene that's no longer selected is thrown away once
+    // it finishes, since the build thread can't be interrupted.
+    if(bvhBuilder.PendingModel() != nullptr && bvhBuilder.Busy() == false && bvhBuilder.PendingModel() != currentModel)
+        bvhBuilder.Discard();
+
+    if(currentModel != input.SceneModel && bvhBuilder.PendingModel() == nullptr)
+        bvhBuilder.Start(currentModel, currentSceneCache, rtcDevice);
+
+    if(bvhBuilder.PendingModel() == currentModel && bvhBuilder.Busy() == false)
     {
         KillBakeThreads();
         KillRenderThreads();
 
-        sceneBVH = BVHData();
+        // The feedback light map is traced against the old BVH
+        feedbackBuilder.Discard();
+
         input.SceneModel = currentModel;
-        BuildBVH(*input.SceneModel, sceneBVH, input.Device, rtcDevice);
+        input.SceneModelCache = currentSceneCache;
+        bvhBuilder.Finish(sceneBVH, sceneHash, input.Device);
 
         InterlockedIncrement64(&renderTag);
         InterlockedIncrement64(&bakeTag);
@@ -1564,35 +2301,64 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
         const uint32 lightMapSize = AppSettings::LightMapResolution;
         const BakeModes bakeMode = AppSettings::BakeMode;
         const SolveModes solveMode = AppSettings::SolveMode;
-        if(lightMapSize != currLightMapSize || bakeMode != currBakeMode || solveMode != currSolveMode || AppSettings::WorldSpaceBake.Changed())
+        if(lightMapSize != currLightMapSize || bakeMode != currBakeMode || solveMode != currSolveMode || AppSettings::WorldSpaceBake.Changed() ||
+           AppSettings::StreamingSGSolve.Changed() || AppSettings::CompositeBake.Changed() || AppSettings::OutOfCoreBake.Changed())
         {
             KillBakeThreads();
             KillRenderThreads();
-
-            ExtractBakePoints(input, bakePoints, gutterTexels);
-            bakePointBuffer.Initialize(input.Device, sizeof(BakePoint), uint32(bakePoints.size()),
-                                       false, false, false, bakePoints.data());
-
+            feedbackBuilder.Discard();
+
+            // If a composite bake already finished for this light map, we can pull the results for
+            // the new bake mode straight out of the composite results instead of baking again
+            const bool compositeBakeComplete = currCompositeBake && currBakeBatch >= int64(currNumBakeBatches);
+            const bool reuseCompositeResults = compositeBakeComplete && lightMapSize == currLightMapSize &&
+                                               compositeBakeWorldSpace == bool(AppSettings::WorldSpaceBake) &&
+                                               CompositeBasisOffset(bakeMode) != uint64(-1);
+
+            // Out-of-core bakes keep the bake points and results in paging files, and bake the groups in
+            // light map order so that only a small window of the light map is being touched at a time.
+            // Light maps that are too big to keep in memory are always baked that way.
+            const bool outOfCore = AppSettings::OutOfCoreBake || lightMapSize > MaxInCoreLightMapSize;
+            ExtractBakePoints(input, bakePoints, activeTexelMasks, gutterTexels, outOfCore);
+            BuildBakeGroupSchedule(bakePoints, activeTexelMasks, lightMapSize, outOfCore, bakeGroupSchedule, bakeGroupBounds);
+            BuildGutterTileLists(gutterTexels, lightMapSize, gutterTileStarts, gutterTileDependents);
+            bakeGroupProgress.Init(bakeGroupSchedule.size());
+
+            // The visualizer only needs the active texels, at the resolution of the light map texture
+            bakeTextureScale = LightMapTextureScale(lightMapSize);
+            std::vector<BakePoint> visualizerPoints;
+            GatherVisualizerBakePoints(bakePoints, activeTexelMasks, lightMapSize, bakeTextureScale, visualizerPoints);
+            bakePointBuffer.Initialize(input.Device, sizeof(BakePoint), uint32(visualizerPoints.size()),
+                                       false, false, false, visualizerPoints.data());
+
+            // Progressive bakes accumulate their running means (and SG weights) at full precision
             const uint64 basisCount = AppSettings::BasisCount(bakeMode);
-            const uint64 numTexels = lightMapSize * lightMapSize;
-            for(uint64 i = 0; i < AppSettings::MaxBasisCount; ++i)
-                bakeResults[i].Shutdown();
+            const bool accumulate = AppSettings::SupportsProgressiveIntegration(bakeMode, solveMode);
+            bakeResults.Init(lightMapSize, basisCount, accumulate, outOfCore);
+
+            if(reuseCompositeResults)
+            {
+                const uint64 compositeOffset = CompositeBasisOffset(bakeMode);
+                for(uint64 i = 0; i < basisCount; ++i)
+                    bakeResults.CopyBasis(i, compositeResults, compositeOffset + i);
+            }
 
-            for(uint64 i = 0; i < basisCount; ++i)
-                bakeResults[i].Init(numTexels);
+            const bool compositeBake = AppSettings::CompositeBake && SupportsCompositeBake(bakeMode);
+            if(compositeBake == false)
+                compositeResults.Shutdown();
+            else if(reuseCompositeResults == false)
+                compositeResults.Init(lightMapSize, CompositeBasisCount, accumulate, outOfCore);
 
-            const uint64 numGroupsX = (lightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
-            const uint64 numGroupsY = (lightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
-            if(AppSettings::SupportsProgressiveIntegration(bakeMode, solveMode))
-                currNumBakeBatches = numGroupsX * numGroupsY * AppSettings::NumBakeSamples * AppSettings::NumBakeSamples;
-            else
-                currNumBakeBatches = numGroupsX * numGroupsY * BakeGroupSize;
+            currCoarseBakeMode = AppSettings::CoarseBakeMode;
+            currNumBakeBatches = bakeGroupSchedule.size() * NumBakeBatchesPerGroup(bakeMode, solveMode, currCoarseBakeMode);
 
             currLightMapSize = lightMapSize;
             currBakeMode = bakeMode;
             currSolveMode = solveMode;
+            currCompositeBake = compositeBake;
+            compositeBakeWorldSpace = AppSettings::WorldSpaceBake;
             InterlockedIncrement64(&bakeTag);
-            currBakeBatch = 0;
+            currBakeBatch = reuseCompositeResults ? int64(currNumBakeBatches) : 0;
 
             const uint64 sgCount = AppSettings::SGCount(currBakeMode);
             SGDistribution distribution = AppSettings::WorldSpaceBake ? SGDistribution::Spherical : SGDistribution::Hemispherical;
@@ -1604,9 +2370,10 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             for(uint64  i = 0; i < sgCount; ++i)
                 sgDirections[i] = initalGuess[i].Axis;
 
+            const uint32 textureSize = uint32((lightMapSize + bakeTextureScale - 1) / bakeTextureScale);
             D3D11_TEXTURE2D_DESC texDesc;
-            texDesc.Width = lightMapSize;
-            texDesc.Height = lightMapSize;
+            texDesc.Width = textureSize;
+            texDesc.Height = textureSize;
             texDesc.ArraySize = uint32(basisCount);
             texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
             texDesc.CPUAccessFlags = 0;
@@ -1632,14 +2399,8 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             srvDesc.Texture2DArray.ArraySize = texDesc.ArraySize;
             DXCall(input.Device->CreateShaderResourceView(bakeTexture, &srvDesc, &bakeTextureSRV));
 
-            // Create staging textures to use for updating the bake texture
-            D3D11_TEXTURE2D_DESC stagingDesc = texDesc;
-            stagingDesc.Usage = D3D11_USAGE_STAGING;
-            stagingDesc.BindFlags = 0;
-            stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-            stagingDesc.ArraySize = 1;
-            for(uint64 i = 0; i < NumStagingTextures; ++i)
-                DXCall(input.Device->CreateTexture2D(&stagingDesc, nullptr, &bakeStagingTextures[i]));
+            // The new texture needs to have all of its tiles uploaded
+            uploadedBakeTag = -1;
         }
 
         if(AppSettings::BakeSampleMode != bakeSampleMode || AppSettings::NumBakeSamples != numBakeSamples)
@@ -1650,19 +2411,136 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             KillBakeThreads();
             KillRenderThreads();
 
-            for(uint64 i = 0; i < numThreads; ++i)
+            // A resumed checkpoint can have a different number of sample sets than there are threads
+            for(uint64 i = 0; i < bakeSamples.size(); ++i)
                 GenerateIntegrationSamples(bakeSamples[i], numBakeSamples, BakeGroupSize, 1,
                                            bakeSampleMode, NumIntegrationTypes, rng);
 
-            const uint64 numGroupsX = (lightMapSize + (BakeGroupSizeX - 1)) / BakeGroupSizeX;
-            const uint64 numGroupsY = (lightMapSize + (BakeGroupSizeY - 1)) / BakeGroupSizeY;
-            if(AppSettings::SupportsProgressiveIntegration(bakeMode, solveMode))
-                currNumBakeBatches = numGroupsX * numGroupsY * AppSettings::NumBakeSamples * AppSettings::NumBakeSamples;
-            else
-                currNumBakeBatches = numGroupsX * numGroupsY * BakeGroupSize;
+            // Cached SG factorizations were keyed off of the old sample directions
+            ClearSGSolverCache();
+
+            currNumBakeBatches = bakeGroupSchedule.size() * NumBakeBatchesPerGroup(bakeMode, solveMode, currCoarseBakeMode);
+
+            InterlockedIncrement64(&bakeTag);
+            currBakeBatch = 0;
+        }
+
+        if(AppSettings::CoarseBakeMode != currCoarseBakeMode)
+        {
+            KillBakeThreads();
+
+            currCoarseBakeMode = AppSettings::CoarseBakeMode;
+            currNumBakeBatches = bakeGroupSchedule.size() * NumBakeBatchesPerGroup(bakeMode, solveMode, currCoarseBakeMode);
+
+            InterlockedIncrement64(&bakeTag);
+            currBakeBatch = 0;
+        }
+
+        if(AppSettings::EnableRadianceCache.Changed() || AppSettings::RadianceCacheTolerance.Changed()
+           || AppSettings::RadianceCacheCellSize.Changed()
+           || (AppSettings::EnableRadianceCache && radianceCache.Initialized() == false))
+        {
+            // The cache parameters are read by the bake threads without any synchronization
+            KillBakeThreads();
+
+            if(AppSettings::EnableRadianceCache && radianceCache.Initialized() == false)
+                radianceCache.Init(RadianceCacheSize);
+            else if(AppSettings::EnableRadianceCache == false)
+                radianceCache.Shutdown();
+
+            radianceCache.CellSize = AppSettings::RadianceCacheCellSize;
+            radianceCache.ErrorTolerance = AppSettings::RadianceCacheTolerance;
+
+            InterlockedIncrement64(&bakeTag);
+            currBakeBatch = 0;
+        }
+
+        if(AppSettings::LightMapFeedbackBounces.Changed() || AppSettings::LightMapFeedbackSamples.Changed())
+        {
+            feedbackBuilder.Discard();
+            feedbackBakeTag = -1;
+            if(AppSettings::LightMapFeedbackBounces == 0 && feedbackIrradiance.Size() > 0)
+            {
+                KillBakeThreads();
+                feedbackIrradiance.Shutdown();
+                InterlockedIncrement64(&bakeTag);
+                currBakeBatch = 0;
+            }
+        }
+
+        // The feedback light map depends on the lighting and the light map layout, so it needs to
+        // be re-computed whenever the bake restarts. It's computed in the background, and the bake
+        // threads don't get scheduled until it's ready. Once it's swapped in the bake is restarted
+        // again, since the bake threads only pick up the new light map when the tag changes. It's
+        // not needed at all if the results are going to come out of the result cache.
+        bool feedbackPending = false;
+        if(AppSettings::LightMapFeedbackBounces > 0 && feedbackBakeTag != bakeTag)
+        {
+            if(feedbackBuilder.Pending() && feedbackBuilder.Tag() != bakeTag)
+                feedbackBuilder.Discard();
+
+            if(feedbackBuilder.Pending())
+            {
+                feedbackPending = true;
+            }
+            else if(BakeResultsCached() == false)
+            {
+                LightMapFeedbackParams params;
+                params.LightMapSize = currLightMapSize;
+                params.NumBounces = AppSettings::LightMapFeedbackBounces;
+                params.NumSamples = AppSettings::LightMapFeedbackSamples;
+                params.NumThreads = numThreads;
+                params.SceneBVH = &sceneBVH;
+                params.EnvMaps = input.EnvMapData;
+                feedbackBuilder.Start(params, bakePoints, bakeTag);
+                feedbackPending = true;
+            }
+        }
+
+        if(feedbackPending && feedbackBuilder.Busy() == false)
+        {
+            KillBakeThreads();
+            feedbackBuilder.Finish(feedbackIrradiance);
 
             InterlockedIncrement64(&bakeTag);
             currBakeBatch = 0;
+            feedbackBakeTag = bakeTag;
+            feedbackPending = false;
+        }
+
+        // Every time the bake restarts, the group progress counters need to be reset (or loaded
+        // from a checkpoint) while the bake threads are stopped. Finished results for the same
+        // scene and settings are pulled out of the result cache instead. A distributed bake worker
+        // starts out with every group marked as finished, and only bakes what it gets leased.
+        if(checkpointBakeTag != bakeTag && feedbackPending == false)
+        {
+            KillBakeThreads();
+            if(bakeWorker.Running())
+            {
+                ResetBakeGroupProgress(CheckpointData(), true);
+                currBakeBatch = currNumBakeBatches;
+            }
+            else if(LoadBakeFromResultCache() == false)
+                ResumeBakeFromCheckpoint();
+            checkpointBakeTag = bakeTag;
+
+            // The bake threads can start claiming batches once the order is set up
+            UpdateBakeGroupOrder(camera);
+            scheduleBakeTag = bakeTag;
+
+            // Results that were loaded from a file need to be uploaded in full
+            uploadedBakeTag = -1;
+        }
+        else if(checkpointBakeTag == bakeTag && currBakeBatch < int64(currNumBakeBatches) && checkpointWriter.Busy() == false &&
+                (PrioritizeBakeGroups() != prioritizedBakeGroupOrder ||
+                (prioritizedBakeGroupOrder && priorityViewProjection != camera.ViewProjectionMatrix() &&
+                 GetTickCount64() - lastPriorityUpdateTime >= PriorityUpdateInterval)))
+        {
+            // Re-prioritize as the camera moves around, but not so often that the bake threads
+            // spend all of their time being stopped and started. Stopping them also means waiting
+            // for the checkpoint writer, so this is put off while a checkpoint is being written.
+            KillBakeThreads();
+            UpdateBakeGroupOrder(camera);
         }
     }
     else
@@ -1692,14 +2570,6 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             DXCall(input.Device->CreateTexture2D(&texDesc, NULL, &renderTexture));
             DXCall(input.Device->CreateShaderResourceView(renderTexture, NULL, &renderTextureSRV));
 
-              // Create staging textures to use for updating the render texture
-            D3D11_TEXTURE2D_DESC stagingDesc = texDesc;
-            stagingDesc.Usage = D3D11_USAGE_STAGING;
-            stagingDesc.BindFlags = 0;
-            stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-            for(uint64 i = 0; i < NumStagingTextures; ++i)
-                DXCall(input.Device->CreateTexture2D(&stagingDesc, nullptr, &renderStagingTextures[i]));
-
             uint64 numTilesX = (screenWidth + (TileSize - 1)) / TileSize;
             uint64 numTilesY = (screenHeight + (TileSize - 1)) / TileSize;
             uint64 numTiles = numTilesX * numTilesY;
@@ -1710,10 +2580,8 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             InterlockedIncrement64(&renderTag);
             currTile = 0;
 
-            const uint64 numPixels = numTiles * TileSize * TileSize;
-            renderBuffer.Init(numPixels);
-            renderWeightBuffer.Init(numPixels);
-            renderWeightBuffer.Fill(0.0f);
+            renderResults.Init(screenWidth, screenHeight);
+            Assert_(renderResults.NumTiles() == numTiles);
 
         }
 
@@ -1764,6 +2632,34 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
         currBakeBatch = 0;
     }
 
+    // Any change to the distributed bake mode restarts the bake, since a worker's results are
+    // incomplete and the groups that a coordinator had leased out need to be baked again
+    const DistributedBakeModes distributedBakeMode = AppSettings::DistributedBakeMode;
+    const uint32 distributedBakePort = distributedBakeMode != DistributedBakeModes::Disabled ? uint32(AppSettings::DistributedBakePort) : 0;
+    if(distributedBakeMode != currDistributedBakeMode || distributedBakePort != currDistributedBakePort)
+    {
+        KillBakeThreads();
+        bakeCoordinator.Shutdown();
+        bakeWorker.Shutdown();
+
+        try
+        {
+            if(distributedBakeMode == DistributedBakeModes::Coordinator)
+                bakeCoordinator.Start(distributedBakePort);
+            else if(distributedBakeMode == DistributedBakeModes::Worker)
+                bakeWorker.Start(bakeCoordinatorHost, distributedBakePort);
+        }
+        catch(Exception e)
+        {
+            PrintStringW(L"Failed to start the distributed bake: %ls", e.GetMessage().c_str());
+        }
+
+        currDistributedBakeMode = distributedBakeMode;
+        currDistributedBakePort = distributedBakePort;
+        InterlockedIncrement64(&bakeTag);
+        currBakeBatch = 0;
+    }
+
     // Change checks for baking only
     if(AppSettings::BakeDirectSunLight.Changed() || AppSettings::BakeDirectAreaLight.Changed()
         || AppSettings::BakeRussianRouletteDepth.Changed() || AppSettings::BakeRussianRouletteProbability.Changed()
@@ -1803,6 +2699,55 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
         currTile = 0;
     }
 
+    if(AppSettings::DenoiseLightMap.Changed() || AppSettings::DenoiserIterations.Changed()
+        || AppSettings::DenoiserPositionSigma.Changed() || AppSettings::DenoiserNormalPower.Changed())
+    {
+        denoisedBakeTag = -1;
+    }
+
+    if(showGroundTruth == false)
+    {
+        // Run the denoiser once the bake finishes, or on demand. A denoise of a partial bake is
+        // kept around as a preview until the bake completes, at which point it gets refreshed.
+        const bool bakeComplete = currBakeBatch >= int64(currNumBakeBatches);
+        const bool denoisedResultsValid = denoisedBakeTag == bakeTag;
+        bool runDenoiser = AppSettings::RunDenoiser;
+        if(bakeComplete && AppSettings::DenoiseLightMap && denoisedResultsValid == false && bakeWorker.Running() == false)
+            runDenoiser = true;
+        if(bakeComplete && denoisedResultsValid && denoisedBakeComplete == false)
+            runDenoiser = true;
+
+        if(runDenoiser)
+        {
+            KillBakeThreads();
+
+            LightMapDenoiseParams params;
+            params.LightMapSize = currLightMapSize;
+            params.BasisCount = AppSettings::BasisCount(currBakeMode);
+            params.NumIterations = AppSettings::DenoiserIterations;
+            params.PositionSigma = AppSettings::DenoiserPositionSigma;
+            params.NormalPower = AppSettings::DenoiserNormalPower;
+            params.NumThreads = numThreads;
+            DenoiseLightMap(params, bakePoints, bakeResults, denoisedResults);
+
+            denoisedBakeTag = bakeTag;
+            denoisedBakeComplete = bakeComplete;
+            uploadedBakeTag = -1;
+
+            StartBakeThreads();
+        }
+
+        // A worker's results only cover the groups that it was leased, so they're never saved
+        const bool saveResults = bakeWorker.Running() == false;
+        if(AppSettings::EnableBakeResultCache && bakeComplete && resultCacheTag != bakeTag && checkpointBakeTag == bakeTag && saveResults)
+            StoreBakeInResultCache();
+
+        if(AppSettings::EnableBakeCheckpoints && checkpointBakeTag == bakeTag && saveResults)
+            UpdateBakeCheckpoint();
+    }
+
+    UpdateDistributedBake();
+
     MeshBakerStatus status;
     status.GroundTruth = renderTextureSRV;
     status.LightMap = bakeTextureSRV;
@@ -1823,75 +2768,546 @@ MeshBakerStatus MeshBaker::Update(const Camera& camera, uint32 screenWidth, uint
             status.GroundTruthSampleCount = (currTile - lastTileNum) * (TileSize * TileSize);
         lastTileNum = currTile;
 
-        renderStagingTextureIdx = (renderStagingTextureIdx + 1) % NumStagingTextures;
-        ID3D11Texture2D* stagingTexture = renderStagingTextures[renderStagingTextureIdx];
+        UploadRenderTiles(deviceContext);
+    }
+    else
+    {
+        const uint64 numPasses = AppSettings::NumBakeSamples * AppSettings::NumBakeSamples;
+        status.BakeProgress = Saturate(currBakeBatch / (currNumBakeBatches - 1.0f));
+        status.GroundTruthProgress = 1.0f;
+        lastTileNum = INT64_MAX;
+
+        UploadBakeTiles(deviceContext);
+    }
+
+    Sleep(0);
+
+    return status;
+}
+
+BakeCheckpointData MeshBaker::CheckpointData()
+{
+    BakeCheckpointData data;
+    data.Identity = checkpointIdentity;
+    data.NumBakeBatches = currNumBakeBatches;
+    data.GroupSchedule = &bakeGroupSchedule;
+    data.GroupProgress = bakeGroupProgress.Data();
+    data.BakeResults = &bakeResults;
+    data.CompositeResults = currCompositeBake ? &compositeResults : nullptr;
+    data.Samples = &bakeSamples;
+    data.FeedbackIrradiance = &feedbackIrradiance;
+    data.CurrBakeTag = &bakeTag;
+    data.BakeTag = bakeTag;
+    return data;
+}
+
+// Called with the bake threads stopped whenever the bake restarts
+void MeshBaker::ResumeBakeFromCheckpoint()
+{
+    lastCheckpointTime = GetTickCount64();
+    completedCheckpointTag = -1;
+    if(bakeGroupSchedule.empty())
+        return;
+
+    int64 resumeBatch = -1;
+    if(AppSettings::EnableBakeCheckpoints && currBakeBatch < int64(currNumBakeBatches))
+    {
+        checkpointIdentity = ComputeBakeCheckpointIdentity(bakePoints);
+        checkpointIdentityTag = bakeTag;
+        resumeBatch = LoadBakeCheckpoint(CheckpointData());
+    }
+
+    if(resumeBatch >= 0)
+    {
+        // The checkpoint's integration samples replace the ones the SG factorizations were cached for
+        ClearSGSolverCache();
+
+        currBakeBatch = resumeBatch;
+        if(resumeBatch >= int64(currNumBakeBatches))
+            completedCheckpointTag = bakeTag;
+    }
+    else
+    {
+        // Batches that bake threads still running with the old settings claimed before they were
+        // stopped don't count, unless the bake was already complete to begin with
+        const bool bakeComplete = currBakeBatch >= int64(currNumBakeBatches);
+        ResetBakeGroupProgress(CheckpointData(), bakeComplete);
+        currBakeBatch = bakeComplete ? int64(currNumBakeBatches) : 0;
+    }
+}
+
+// Sorts the bake groups so that the ones the camera can see come first, nearest first, followed
+// by the rest of the groups in order of distance. The visible groups become the priority groups,
+// which get all of their remaining batches handed out before any other group gets another batch.
+// Only the order changes, so any batches that were already baked are kept. This can only be
+// called while the bake threads are stopped.
+// Out-of-core bakes slide a window over the bake group order to keep the tiles being worked on
+// local, which only works if the groups are in light map order
+bool MeshBaker::PrioritizeBakeGroups() const
+{
+    return AppSettings::PrioritizeVisibleTexels && bakeResults.OutOfCore() == false;
+}
+
+void MeshBaker::UpdateBakeGroupOrder(const Camera& camera)
+{
+    Assert_(bakeThreadsSuspended);
+
+    const uint64 numBakeGroups = bakeGroupSchedule.size();
+    bakeGroupOrder.resize(numBakeGroups);
+    ++bakeGroupOrderVersion;
+    numPriorityGroups = 0;
+    bakeGroupQueue.Sweep = 0;
+    bakeGroupQueue.PriorityBatchesLeft = 0;
+    bakeGroupQueue.WindowStart = 0;
+    priorityViewProjection = camera.ViewProjectionMatrix();
+    lastPriorityUpdateTime = GetTickCount64();
+    prioritizedBakeGroupOrder = PrioritizeBakeGroups();
+
+    if(prioritizedBakeGroupOrder == false || numBakeGroups == 0)
+    {
+        for(uint64 i = 0; i < numBakeGroups; ++i)
+            bakeGroupOrder[i] = uint32(i);
+        return;
+    }
 
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        ZeroMemory(&mapped, sizeof(mapped));
-        if(SUCCEEDED(deviceContext->Map(stagingTexture, 0, D3D11_MAP_WRITE, 0, &mapped)))
+    // Extract the frustum planes from the view projection matrix. The far plane is left out,
+    // since far away groups should still come before the ones behind the camera.
+    const Float4x4& vp = priorityViewProjection;
+    Float4 frustumPlanes[5] =
+    {
+        Float4(vp._14 + vp._11, vp._24 + vp._21, vp._34 + vp._31, vp._44 + vp._41),
+        Float4(vp._14 - vp._11, vp._24 - vp._21, vp._34 - vp._31, vp._44 - vp._41),
+        Float4(vp._14 + vp._12, vp._24 + vp._22, vp._34 + vp._32, vp._44 + vp._42),
+        Float4(vp._14 - vp._12, vp._24 - vp._22, vp._34 - vp._32, vp._44 - vp._42),
+        Float4(vp._13, vp._23, vp._33, vp._43),
+    };
+
+    for(uint64 i = 0; i < ArraySize_(frustumPlanes); ++i)
+        frustumPlanes[i] = frustumPlanes[i] / Float3::Length(frustumPlanes[i].To3D());
+
+    const Float3 cameraPos = camera.Position();
+    std::vector<uint64> sortKeys(numBakeGroups);
+    for(uint64 i = 0; i < numBakeGroups; ++i)
+    {
+        const Float3 center = bakeGroupBounds[i].To3D();
+        const float radius = bakeGroupBounds[i].w;
+
+        bool visible = true;
+        for(uint64 planeIdx = 0; planeIdx < ArraySize_(frustumPlanes); ++planeIdx)
         {
-            uint8* dst = reinterpret_cast<uint8*>(mapped.pData);
-            const Half4* src = renderBuffer.Data();
-            for(uint64 y = 0; y < screenHeight; ++y)
+            const Float4& plane = frustumPlanes[planeIdx];
+            if(Float3::Dot(plane.To3D(), center) + plane.w < -radius)
+                visible = false;
+        }
+
+        // Positive floats sort the same way as their bits
+        const float distance = Max(Float3::Length(center - cameraPos) - radius, 0.0f);
+        uint32 distanceBits = 0;
+        memcpy(&distanceBits, &distance, sizeof(float));
+
+        sortKeys[i] = (visible ? 0 : (1ull << 63)) | (uint64(distanceBits) << 32) | i;
+        if(visible)
+            ++numPriorityGroups;
+    }
+
+    std::sort(sortKeys.begin(), sortKeys.end());
+
+    const int64 batchesPerGroup = BakeBatchesPerGroup(CheckpointData());
+    int64 priorityBatchesLeft = 0;
+    for(uint64 i = 0; i < numBakeGroups; ++i)
+    {
+        bakeGroupOrder[i] = uint32(sortKeys[i] & 0xFFFFFFFF);
+        if(i < numPriorityGroups)
+            priorityBatchesLeft += std::max<int64>(batchesPerGroup - bakeGroupProgress[bakeGroupOrder[i]].ClaimedBatches, 0);
+    }
+
+    bakeGroupQueue.PriorityBatchesLeft = priorityBatchesLeft;
+}
+
+// Exchanges leases and results with the distributed bake workers or coordinator. Both of them
+// need to keep talking while the bake is restarting, but they only get at the bake data once
+// the group progress counters have been set up.
+void MeshBaker::UpdateDistributedBake()
+{
+    if(bakeCoordinator.Running() == false && bakeWorker.Running() == false)
+        return;
+
+    const bool bakeReady = checkpointBakeTag == bakeTag && bakeGroupSchedule.size() > 0;
+
+    DistributedBakeData data;
+    if(bakeReady)
+    {
+        data.Bake = CheckpointData();
+        data.Key = ResultCacheKey();
+        data.CurrBakeBatch = &currBakeBatch;
+        data.WindowStart = &bakeGroupQueue.WindowStart;
+        data.GroupOrder = &bakeGroupOrder;
+        data.NumPriorityGroups = numPriorityGroups;
+        data.GroupOrderVersion = bakeGroupOrderVersion;
+    }
+
+    bakeCoordinator.Update(bakeReady ? &data : nullptr);
+    bakeWorker.Update(bakeReady ? &data : nullptr);
+}
+
+// Kicks off a checkpoint write if enough time has passed since the last one, or if the bake
+// just finished. The write happens on a background thread while the bake threads keep going.
+void MeshBaker::UpdateBakeCheckpoint()
+{
+    if(checkpointWriter.Busy() || bakeGroupSchedule.empty())
+        return;
+
+    const bool bakeComplete = currBakeBatch >= int64(currNumBakeBatches);
+    if(bakeComplete && completedCheckpointTag == bakeTag)
+        return;
+
+    const uint64 interval = uint64(AppSettings::BakeCheckpointInterval) * 1000;
+    if(bakeComplete == false && GetTickCount64() - lastCheckpointTime < interval)
+        return;
+
+    if(checkpointIdentityTag != bakeTag)
+    {
+        checkpointIdentity = ComputeBakeCheckpointIdentity(bakePoints);
+        checkpointIdentityTag = bakeTag;
+    }
+
+    checkpointWriter.Start(CheckpointData());
+    lastCheckpointTime = GetTickCount64();
+    if(bakeComplete)
+        completedCheckpointTag = bakeTag;
+}
+
+BakeResultCacheData MeshBaker::ResultCacheData()
+{
+    BakeResultCacheData data;
+    data.BakeResults = &bakeResults;
+    data.CompositeResults = currCompositeBake ? &compositeResults : nullptr;
+    data.SGDirections = sgDirections;
+    data.SGSharpness = &sgSharpness;
+    data.SGCount = AppSettings::SGCount(currBakeMode);
+    return data;
+}
+
+// The key only needs to be re-computed when the bake restarts, since every setting that goes
+// into it restarts the bake when it changes
+const Hash& MeshBaker::ResultCacheKey()
+{
+    if(resultCacheKeyTag != bakeTag)
+    {
+        resultCacheKey = ComputeBakeResultCacheKey(sceneHash);
+        resultCacheKeyTag = bakeTag;
+    }
+
+    return resultCacheKey;
+}
+
+// Returns true if the current bake hasn't finished yet, but its results are in the cache
+bool MeshBaker::BakeResultsCached()
+{
+    if(AppSettings::EnableBakeResultCache == false || bakeGroupSchedule.empty())
+        return false;
+    if(currBakeBatch >= int64(currNumBakeBatches))
+        return false;
+
+    return BakeResultCacheContains(ResultCacheKey());
+}
+
+// Called with the bake threads stopped whenever the bake restarts. Returns true if the results
+// were loaded from the cache, in which case the bake is already finished.
+bool MeshBaker::LoadBakeFromResultCache()
+{
+    if(BakeResultsCached() == false)
+        return false;
+
+    if(LoadCachedBakeResults(ResultCacheKey(), ResultCacheData()) == false)
+        return false;
+
+    currBakeBatch = currNumBakeBatches;
+    ResetBakeGroupProgress(CheckpointData(), true);
+    resultCacheTag = bakeTag;
+
+    // There's nothing left to checkpoint
+    lastCheckpointTime = GetTickCount64();
+    completedCheckpointTag = bakeTag;
+
+    return true;
+}
+
+// Saves the results once a bake finishes. The bake threads are stopped so that none of them can
+// still be writing out the last few batches.
+void MeshBaker::StoreBakeInResultCache()
+{
+    KillBakeThreads();
+
+    if(bakeGroupSchedule.empty() == false)
+    {
+        const uint64 maxCacheSize = uint64(AppSettings::BakeResultCacheSize) * 1024 * 1024;
+        StoreCachedBakeResults(ResultCacheKey(), ResultCacheData(), maxCacheSize);
+    }
+    resultCacheTag = bakeTag;
+
+    StartBakeThreads();
+}
+
+// Box filters a row of un-tiled light map tiles down to the resolution of the light map texture.
+// Only the covered texels get averaged, so that the edges of the UV charts don't get darkened by
+// the empty texels next to them. The coverage masks have one entry per tile in the row.
+static void DownsampleTileRows(const Half4* src, uint64 srcWidth, const uint64* coverage, uint64 numTexelsX,
+                               uint64 numTexelsY, uint64 scale, Half4* dst, uint64 dstWidth, uint64 dstHeight)
+{
+    for(uint64 dstY = 0; dstY < dstHeight; ++dstY)
+    {
+        for(uint64 dstX = 0; dstX < dstWidth; ++dstX)
+        {
+            Float4 sum;
+            float numCovered = 0.0f;
+            for(uint64 y = dstY * scale; y < std::min((dstY + 1) * scale, numTexelsY); ++y)
             {
-                memcpy(dst, src, sizeof(Half4) * screenWidth);
-                dst += mapped.RowPitch;
-                src += screenWidth;
+                for(uint64 x = dstX * scale; x < std::min((dstX + 1) * scale, numTexelsX); ++x)
+                {
+                    if(coverage[x / BakeGroupSizeX] & GroupTexelBit(x, y))
+                    {
+                        sum += src[y * srcWidth + x].ToFloat4();
+                        numCovered += 1.0f;
+                    }
+                }
             }
 
-            deviceContext->Unmap(stagingTexture, 0);
+            dst[dstY * dstWidth + dstX] = numCovered > 0.0f ? Half4(sum / numCovered) : Half4();
         }
+    }
+}
 
-        deviceContext->CopyResource(renderTexture, stagingTexture);
+// Uploads the tiles of the bake texture whose results changed since they were last uploaded.
+// Tiles are uploaded in horizontal runs, one box per basis, and the rows are visited starting
+// from where the previous frame ran out of budget so that every tile eventually gets its turn.
+void MeshBaker::UploadBakeTiles(ID3D11DeviceContext* deviceContext)
+{
+    const BakeResultStore& results = denoisedBakeTag == bakeTag ? denoisedResults : bakeResults;
+    Assert_(results.LightMapSize() == currLightMapSize);
+
+    const uint64 basisCount = results.BasisCount();
+    const uint64 numTilesX = results.NumTilesX();
+    const uint64 numTilesY = results.NumTilesY();
+    const uint64 numTiles = results.NumTiles();
+    Assert_(gutterTileDependents.size() == numTiles);
+
+    // Anything other than the bake threads writing to the results requires a full upload
+    if(uploadedBakeTag != bakeTag || uploadedBakeResults != &results)
+    {
+        pendingBakeTiles.assign(numTiles, 1);
+        uploadedBakeTag = bakeTag;
+        uploadedBakeResults = &results;
     }
-    else
+
+    if(&results == &bakeResults)
     {
-        const uint32 LightMapSize = AppSettings::LightMapResolution;
-        const uint64 numPasses = AppSettings::NumBakeSamples * AppSettings::NumBakeSamples;
-        status.BakeProgress = Saturate(currBakeBatch / (currNumBakeBatches - 1.0f));
-        status.GroundTruthProgress = 1.0f;
-        lastTileNum = INT64_MAX;
+        for(uint64 tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+        {
+            if(bakeResults.ClearTileDirty(tileIdx) == false)
+                continue;
+
+            pendingBakeTiles[tileIdx] = 1;
 
-        const uint64 basisCount = AppSettings::BasisCount(currBakeMode);
-        bakeStagingTextureIdx = (bakeStagingTextureIdx + 1) % NumStagingTextures;
-        bakeTextureUpdateIdx = (bakeTextureUpdateIdx + 1) % basisCount;
-        ID3D11Texture2D* stagingTexture = bakeStagingTextures[bakeStagingTextureIdx];
+            // Gutter texels in neighboring tiles can be copying from this tile
+            const uint8 dependents = gutterTileDependents[tileIdx];
+            if(dependents == 0)
+                continue;
 
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        ZeroMemory(&mapped, sizeof(mapped));
-        if(SUCCEEDED(deviceContext->Map(stagingTexture, 0, D3D11_MAP_WRITE, 0, &mapped)))
+            for(uint64 i = 0; i < 8; ++i)
+            {
+                const int64 offset = NeighborTileOffsets[i][1] * int64(numTilesX) + NeighborTileOffsets[i][0];
+                if(dependents & (1 << i))
+                    pendingBakeTiles[uint64(int64(tileIdx) + offset)] = 1;
+            }
+        }
+    }
+
+    const uint64 lightMapSize = results.LightMapSize();
+    const uint64 tileUploadSize = BakeResultStore::TileSize * sizeof(Half4) * basisCount;
+    const uint64 scratchWidth = numTilesX * BakeResultStore::TileSizeX;
+    const uint64 scratchPitch = scratchWidth * sizeof(Half4);
+    textureUploadScratch.resize(scratchWidth * BakeResultStore::TileSizeY);
+    Half4* scratch = textureUploadScratch.data();
+
+    uint64 uploadBudget = MaxBakeUploadSize;
+    for(uint64 rowIdx = 0; rowIdx < numTilesY && uploadBudget > 0; ++rowIdx)
+    {
+        const uint64 tileY = (bakeUploadTileRow + rowIdx) % numTilesY;
+        bakeUploadTileRow = tileY;
+
+        uint64 tileX = 0;
+        while(tileX < numTilesX && uploadBudget > 0)
         {
-            Half4* dst = reinterpret_cast<Half4*>(mapped.pData);
-            const Float4* src = bakeResults[bakeTextureUpdateIdx].Data();
-            for(uint64 y = 0; y < LightMapSize; ++y)
+            if(pendingBakeTiles[tileY * numTilesX + tileX] == 0)
             {
-                for(uint64 x = 0; x < LightMapSize; ++x)
-                    dst[x] = Half4(src[x]);
+                ++tileX;
+                continue;
+            }
 
-                dst += mapped.RowPitch / sizeof(Half4);
-                src += LightMapSize;
+            const uint64 maxRunLength = std::max<uint64>(uploadBudget / tileUploadSize, 1);
+            const uint64 runStart = tileX;
+            while(tileX < numTilesX && tileX - runStart < maxRunLength && pendingBakeTiles[tileY * numTilesX + tileX])
+            {
+                pendingBakeTiles[tileY * numTilesX + tileX] = 0;
+                ++tileX;
             }
 
-            const uint64 numGutterTexels = gutterTexels.size();
-            for(uint64 i = 0; i < numGutterTexels; ++i)
+            const uint64 runLength = tileX - runStart;
+            uploadBudget -= std::min(uploadBudget, runLength * tileUploadSize);
+
+            const uint64 startX = runStart * BakeResultStore::TileSizeX;
+            const uint64 startY = tileY * BakeResultStore::TileSizeY;
+            const uint64 endX = std::min(tileX * BakeResultStore::TileSizeX, lightMapSize);
+            const uint64 endY = std::min(startY + BakeResultStore::TileSizeY, lightMapSize);
+            D3D11_BOX box;
+            box.left = uint32(startX / bakeTextureScale);
+            box.right = uint32((endX + bakeTextureScale - 1) / bakeTextureScale);
+            box.top = uint32(startY / bakeTextureScale);
+            box.bottom = uint32((endY + bakeTextureScale - 1) / bakeTextureScale);
+            box.front = 0;
+            box.back = 1;
+
+            const uint64 firstTileIdx = tileY * numTilesX + runStart;
+            const uint64 gutterStart = gutterTileStarts[firstTileIdx];
+            const uint64 gutterEnd = gutterTileStarts[firstTileIdx + runLength];
+
+            // Downsampling needs to know which texels are covered, which is the active texels
+            // plus the gutter texels that get filled in below
+            const uint64* coverage = nullptr;
+            if(bakeTextureScale > 1)
             {
-                const GutterTexel& gutterTexel = gutterTexels[i];
-                const uint64 srcIdx = gutterTexel.NeighborPos.y * LightMapSize + gutterTexel.NeighborPos.x;
-                uint8* gutterDst = reinterpret_cast<uint8*>(mapped.pData) + gutterTexel.TexelPos.y * mapped.RowPitch;
-                gutterDst += gutterTexel.TexelPos.x * sizeof(Half4);
-                const Half4& gutterSrc = bakeResults[bakeTextureUpdateIdx][srcIdx];
-                *reinterpret_cast<Half4*>(gutterDst) = gutterSrc;
+                textureCoverageScratch.assign(activeTexelMasks.begin() + firstTileIdx,
+                                              activeTexelMasks.begin() + firstTileIdx + runLength);
+                for(uint64 i = gutterStart; i < gutterEnd; ++i)
+                {
+                    const Uint2 texelPos = gutterTexels[i].TexelPos;
+                    textureCoverageScratch[texelPos.x / BakeGroupSizeX - runStart] |= GroupTexelBit(texelPos.x, texelPos.y);
+                }
+                coverage = textureCoverageScratch.data();
             }
 
-            deviceContext->Unmap(stagingTexture, 0);
+            for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+            {
+                // The results are already in FP16, so they just need to be un-tiled
+                results.CopyTileRows(basisIdx, runStart, tileY, runLength, scratch, scratchPitch);
+
+                const Half4* src = results.BasisData(basisIdx);
+                for(uint64 i = gutterStart; i < gutterEnd; ++i)
+                {
+                    const GutterTexel& gutterTexel = gutterTexels[i];
+                    const uint64 srcOffset = results.TexelOffset(gutterTexel.NeighborPos.x, gutterTexel.NeighborPos.y);
+                    scratch[(gutterTexel.TexelPos.y - startY) * scratchWidth + (gutterTexel.TexelPos.x - startX)] = src[srcOffset];
+                }
+
+                if(coverage == nullptr)
+                {
+                    deviceContext->UpdateSubresource(bakeTexture, uint32(basisIdx), &box, scratch, uint32(scratchPitch), 0);
+                    continue;
+                }
+
+                const uint64 dstWidth = box.right - box.left;
+                const uint64 dstHeight = box.bottom - box.top;
+                textureDownsampleScratch.resize(dstWidth * dstHeight);
+                DownsampleTileRows(scratch, scratchWidth, coverage, endX - startX, endY - startY,
+                                   bakeTextureScale, textureDownsampleScratch.data(), dstWidth, dstHeight);
+                deviceContext->UpdateSubresource(bakeTexture, uint32(basisIdx), &box, textureDownsampleScratch.data(),
+                                                 uint32(dstWidth * sizeof(Half4)), 0);
+            }
         }
+    }
+}
+
+// Exports straight from the bake results instead of the light map texture, since the texture can
+// be downsampled. Each basis gets un-tiled into a row-major copy with its gutter texels filled in,
+// which is kept in a paging file for an out-of-core bake.
+void MeshBaker::ExportLightMap(const wchar* filePath)
+{
+    const BakeResultStore& results = denoisedBakeTag == bakeTag ? denoisedResults : bakeResults;
+    if(results.Initialized() == false)
+        throw Exception(L"There's no baked light map to export");
 
-        deviceContext->CopySubresourceRegion(bakeTexture, uint32(bakeTextureUpdateIdx), 0, 0, 0, stagingTexture, 0, nullptr);
+    const uint64 lightMapSize = results.LightMapSize();
+    const uint64 basisCount = results.BasisCount();
+    const uint64 rowPitch = lightMapSize * sizeof(Half4);
+
+    std::vector<EXRPartDesc> parts(basisCount);
+    for(uint64 i = 0; i < basisCount; ++i)
+    {
+        parts[i].Name = "Basis" + ToAnsiString(i);
+        parts[i].Width = uint32(lightMapSize);
+        parts[i].Height = uint32(lightMapSize);
+        parts[i].NumChannels = 4;
     }
 
-    Sleep(0);
+    PagedArray<Half4> texels;
+    texels.Init(lightMapSize * lightMapSize, results.OutOfCore());
 
-    return status;
+    EXRWriter writer;
+    writer.Open(filePath, parts.data(), parts.size(), 0);
+    for(uint64 basisIdx = 0; basisIdx < basisCount; ++basisIdx)
+    {
+        for(uint64 tileY = 0; tileY < results.NumTilesY(); ++tileY)
+        {
+            Half4* dst = texels.Data() + tileY * BakeResultStore::TileSizeY * lightMapSize;
+            results.CopyTileRows(basisIdx, 0, tileY, results.NumTilesX(), dst, rowPitch);
+        }
+
+        const Half4* src = results.BasisData(basisIdx);
+        for(uint64 i = 0; i < gutterTexels.size(); ++i)
+        {
+            const GutterTexel& gutterTexel = gutterTexels[i];
+            const uint64 srcOffset = results.TexelOffset(gutterTexel.NeighborPos.x, gutterTexel.NeighborPos.y);
+            texels[gutterTexel.TexelPos.y * lightMapSize + gutterTexel.TexelPos.x] = src[srcOffset];
+        }
+
+        writer.WritePart(texels.Data(), rowPitch);
+    }
+
+    writer.Close();
+}
+
+// Resolves and uploads the tiles of the ground truth render that the render threads touched
+// since the last frame, in horizontal runs of tiles
+void MeshBaker::UploadRenderTiles(ID3D11DeviceContext* deviceContext)
+{
+    const uint64 numTilesX = renderResults.NumTilesX();
+    const uint64 numTilesY = renderResults.NumTilesY();
+    const uint64 scratchWidth = numTilesX * RenderResultStore::TileSize;
+    const uint64 scratchPitch = scratchWidth * sizeof(Half4);
+    textureUploadScratch.resize(scratchWidth * RenderResultStore::TileSize);
+    Half4* scratch = textureUploadScratch.data();
+
+    for(uint64 tileY = 0; tileY < numTilesY; ++tileY)
+    {
+        uint64 tileX = 0;
+        while(tileX < numTilesX)
+        {
+            if(renderResults.ClearTileDirty(tileY * numTilesX + tileX) == false)
+            {
+                ++tileX;
+                continue;
+            }
+
+            const uint64 runStart = tileX++;
+            while(tileX < numTilesX && renderResults.ClearTileDirty(tileY * numTilesX + tileX))
+                ++tileX;
+
+            // Averaging and converting to FP16 only happens here, when a frame is displayed
+            const uint64 runLength = tileX - runStart;
+            renderResults.ResolveTiles(runStart, tileY, runLength, scratch, scratchPitch);
+
+            const uint64 startY = tileY * RenderResultStore::TileSize;
+            D3D11_BOX box;
+            box.left = uint32(runStart * RenderResultStore::TileSize);
+            box.right = uint32(std::min(tileX * RenderResultStore::TileSize, renderResults.Width()));
+            box.top = uint32(startY);
+            box.bottom = uint32(std::min(startY + RenderResultStore::TileSize, renderResults.Height()));
+            box.front = 0;
+            box.back = 1;
+            deviceContext->UpdateSubresource(renderTexture, 0, &box, scratch, uint32(scratchPitch), 0);
+        }
+    }
 }
 
 void MeshBaker::KillBakeThreads()
@@ -1911,6 +3327,9 @@ void MeshBaker::KillBakeThreads()
     bakeThreadData.clear();
     killBakeThreads = false;
     bakeThreadsSuspended = true;
+
+    // The checkpoint writer reads the bake results, so it needs to finish before they can change
+    checkpointWriter.Wait();
 }
 
 void MeshBaker::StartBakeThreads()
@@ -1922,38 +3341,43 @@ void MeshBaker::StartBakeThreads()
     if(bakeThreads.size() > 0)
         return;
 
+    const bool composite = currCompositeBake;
     uint32 (__stdcall* threadFunction)(void*) = BakeThread<DiffuseBaker>;
     if(currBakeMode == BakeModes::HL2)
-        threadFunction = BakeThread<HL2Baker>;
+        threadFunction = BakeThreadFunction<HL2Baker>(composite);
     else if (currBakeMode == BakeModes::Directional)
-        threadFunction = BakeThread<DirectionalBaker>;
+        threadFunction = BakeThreadFunction<DirectionalBaker>(composite);
     else if(currBakeMode == BakeModes::DirectionalRGB)
-        threadFunction = BakeThread<DirectionalRGBBaker>;
+        threadFunction = BakeThreadFunction<DirectionalRGBBaker>(composite);
     else if(currBakeMode == BakeModes::SH4)
-        threadFunction = BakeThread<SH4Baker>;
+        threadFunction = BakeThreadFunction<SH4Baker>(composite);
     else if(currBakeMode == BakeModes::SH9)
-        threadFunction = BakeThread<SH9Baker>;
+        threadFunction = BakeThreadFunction<SH9Baker>(composite);
     else if(currBakeMode == BakeModes::H4)
-        threadFunction = BakeThread<H4Baker>;
+        threadFunction = BakeThreadFunction<H4Baker>(composite);
     else if(currBakeMode == BakeModes::H6)
-        threadFunction = BakeThread<H6Baker>;
+        threadFunction = BakeThreadFunction<H6Baker>(composite);
     else if(currBakeMode == BakeModes::SG5)
-        threadFunction = BakeThread<SG5Baker>;
+        threadFunction = SGBakeThreadFunction<5>(currSolveMode, composite);
     else if(currBakeMode == BakeModes::SG6)
-        threadFunction = BakeThread<SG6Baker>;
+        threadFunction = SGBakeThreadFunction<6>(currSolveMode, composite);
     else if(currBakeMode == BakeModes::SG9)
-        threadFunction = BakeThread<SG9Baker>;
+        threadFunction = SGBakeThreadFunction<9>(currSolveMode, composite);
     else if(currBakeMode == BakeModes::SG12)
-        threadFunction = BakeThread<SG12Baker>;
+        threadFunction = SGBakeThreadFunction<12>(currSolveMode, composite);
 
     bakeThreads.resize(numThreads);
     bakeThreadData.resize(numThreads);
     for(uint64 i = 0; i < numThreads; ++i)
     {
         BakeThreadData* threadData = &bakeThreadData[i];
-        threadData->BakeOutput = bakeResults;
+        threadData->BakeOutput = &bakeResults;
+        threadData->CompositeOutput = &compositeResults;
         threadData->Samples = &bakeSamples;
         threadData->CurrBatch = &currBakeBatch;
+        threadData->GroupProgress = bakeGroupProgress.Data();
+        threadData->GroupQueue = &bakeGroupQueue;
+        threadData->RadianceCache = &radianceCache;
         threadData->Baker = this;
         bakeThreads[i] = HANDLE(_beginthreadex(nullptr, 0, threadFunction, threadData, 0, nullptr));
         if(bakeThreads[i] == 0)
@@ -1999,8 +3423,7 @@ void MeshBaker::StartRenderThreads()
     for(uint64 i = 0; i < numThreads; ++i)
     {
         RenderThreadData* threadData = &renderThreadData[i];
-        threadData->RenderBuffer = &renderBuffer;
-        threadData->RenderWeightBuffer = &renderWeightBuffer;
+        threadData->RenderOutput = &renderResults;
         threadData->Samples = &renderSamples;
         threadData->CurrTile = &currTile;
         threadData->Baker = this;
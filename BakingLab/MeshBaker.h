@@ -20,6 +20,14 @@
 #include <Graphics/Skybox.h>
 
 #include "PathTracer.h"
+#include "RadianceCache.h"
+#include "BakeResultStore.h"
+#include "RenderResultStore.h"
+#include "BakeCheckpoint.h"
+#include "BakeResultCache.h"
+#include "BVHBuilder.h"
+#include "LightMapFeedback.h"
+#include "DistributedBake.h"
 #include "SharedConstants.h"
 #include "AppSettings.h"
 
@@ -38,11 +46,13 @@ struct IntegrationSamples;
 struct BakeThreadData;
 struct GutterTexel;
 struct Vertex;
+class SceneCache;
 
 // Input to the baker
 struct BakeInputData
 {
     const Model* SceneModel = nullptr;
+    const SceneCache* SceneModelCache = nullptr;           // null if the scene isn't cached
     ID3D11Device* Device = nullptr;
     ID3D11ShaderResourceView* EnvMaps[AppSettings::NumCubeMaps];
     TextureData<Half4> EnvMapData[AppSettings::NumCubeMaps];
@@ -67,6 +77,14 @@ struct MeshBakerStatus
     float SGSharpness = 0.0f;
 };
 
+// Shared state that the bake threads use for claiming batches in priority order
+struct BakeGroupQueue
+{
+    volatile int64 Sweep = 0;
+    volatile int64 PriorityBatchesLeft = 0;
+    volatile int64 WindowStart = 0;
+};
+
 class MeshBaker
 {
 
@@ -79,11 +97,17 @@ public:
     void Shutdown();
 
     MeshBakerStatus Update(const Camera& camera, uint32 screenWidth, uint32 screenHeight,
-                           ID3D11DeviceContext* deviceContext, const Model* currentModel);
+                           ID3D11DeviceContext* deviceContext, const Model* currentModel,
+                           const SceneCache* currentSceneCache);
+
+    // Writes the baked light map to a multi-part EXR file at full resolution
+    void ExportLightMap(const wchar* filePath);
+
+    // Where to find the coordinator when baking as a distributed bake worker
+    std::string bakeCoordinatorHost = "localhost";
 
     // Read/Write Data shared with render threads
-    FixedArray<Half4> renderBuffer;
-    FixedArray<float> renderWeightBuffer;
+    RenderResultStore renderResults;
     volatile int64 currTile = 0;
 
     // Read-only data shared with render threads
@@ -97,9 +121,15 @@ public:
     bool killRenderThreads = false;
     uint64 currNumTiles = 0;
 
+    // Number of bases stored for the extra bake modes in a composite bake
+    static const uint64 CompositeBasisCount = 26;
+
     // Read/Write data shared with bake threads
-    FixedArray<Float4> bakeResults[AppSettings::MaxBasisCount];
+    BakeResultStore bakeResults;
+    BakeResultStore compositeResults;
     volatile int64 currBakeBatch = 0;
+    FixedArray<BakeGroupProgress> bakeGroupProgress;
+    BakeGroupQueue bakeGroupQueue;
 
     // Read-only data shared with bake threads
     volatile int64 bakeTag = 0;
@@ -108,8 +138,16 @@ public:
     uint64 currLightMapSize = 0;
     BakeModes currBakeMode = BakeModes::Diffuse;
     SolveModes currSolveMode = SolveModes::NNLS;
-    std::vector<BakePoint> bakePoints;
+    CoarseBakeModes currCoarseBakeMode = CoarseBakeModes::Disabled;
+    bool currCompositeBake = false;
+    PagedArray<BakePoint> bakePoints;
+    std::vector<uint64> activeTexelMasks;              // one bit per texel of each bake group
+    std::vector<uint32> bakeGroupSchedule;
+    std::vector<uint32> bakeGroupOrder;                 // schedule indices, priority groups first
+    uint64 numPriorityGroups = 0;
+    volatile int64 scheduleBakeTag = -1;                // bake threads wait until this matches bakeTag
     std::vector<GutterTexel> gutterTexels;
+    PagedArray<Float4> feedbackIrradiance;
 
     // Read-only data shared with both bake and render threads
     BVHData sceneBVH;
@@ -124,18 +162,33 @@ private:
     void KillRenderThreads();
     void StartRenderThreads();
 
+    BakeCheckpointData CheckpointData();
+    void ResumeBakeFromCheckpoint();
+    void UpdateBakeCheckpoint();
+
+    BakeResultCacheData ResultCacheData();
+    const Hash& ResultCacheKey();
+    bool BakeResultsCached();
+    bool LoadBakeFromResultCache();
+    void StoreBakeInResultCache();
+
+    bool PrioritizeBakeGroups() const;
+    void UpdateBakeGroupOrder(const Camera& camera);
+
+    void UpdateDistributedBake();
+
+    void UploadBakeTiles(ID3D11DeviceContext* deviceContext);
+    void UploadRenderTiles(ID3D11DeviceContext* deviceContext);
+
     bool initialized = false;
 
     RTCDevice rtcDevice = nullptr;
+    BVHBuilder bvhBuilder;
 
     Random rng;
 
-    static const uint64 NumStagingTextures = 2;
-
     ID3D11Texture2DPtr renderTexture;
     ID3D11ShaderResourceViewPtr renderTextureSRV;
-    ID3D11Texture2DPtr renderStagingTextures[NumStagingTextures];
-    uint64 renderStagingTextureIdx = 0;
 
     std::vector<HANDLE> renderThreads;
     std::vector<RenderThreadData> renderThreadData;
@@ -147,9 +200,16 @@ private:
 
     ID3D11Texture2DPtr bakeTexture;
     ID3D11ShaderResourceViewPtr bakeTextureSRV;
-    uint64 bakeStagingTextureIdx = 0;
-    ID3D11Texture2DPtr bakeStagingTextures[NumStagingTextures];
-    uint64 bakeTextureUpdateIdx = 0;
+    uint64 bakeTextureScale = 1;                    // light map texels per bake texture texel in each direction
+    std::vector<uint8> pendingBakeTiles;
+    uint64 bakeUploadTileRow = 0;
+    int64 uploadedBakeTag = -1;
+    const BakeResultStore* uploadedBakeResults = nullptr;
+    std::vector<uint32> gutterTileStarts;           // gutter texels for each tile, sorted by tile
+    std::vector<uint8> gutterTileDependents;        // neighbors with gutter texels copying from each tile
+    std::vector<Half4> textureUploadScratch;
+    std::vector<Half4> textureDownsampleScratch;
+    std::vector<uint64> textureCoverageScratch;
 
     uint64 numThreads = 0;
     std::vector<HANDLE> bakeThreads;
@@ -159,9 +219,41 @@ private:
     uint64 numBakeSamples = 0;
     StructuredBuffer bakePointBuffer;
     bool bakeThreadsSuspended = false;
+    bool compositeBakeWorldSpace = false;
+
+    BakeResultStore denoisedResults;
+    int64 denoisedBakeTag = -1;
+    bool denoisedBakeComplete = false;
+
+    RadianceCache radianceCache;
+    LightMapFeedbackBuilder feedbackBuilder;
+    int64 feedbackBakeTag = -1;
 
     Float3 sgDirections[AppSettings::MaxSGCount];
     float sgSharpness = 0.0f;
 
     int64 lastTileNum = INT64_MAX;
+
+    BakeCheckpointWriter checkpointWriter;
+    Hash checkpointIdentity;
+    int64 checkpointIdentityTag = -1;
+    int64 checkpointBakeTag = -1;
+    int64 completedCheckpointTag = -1;
+    uint64 lastCheckpointTime = 0;
+
+    std::vector<Float4> bakeGroupBounds;
+    Float4x4 priorityViewProjection;
+    uint64 lastPriorityUpdateTime = 0;
+    bool prioritizedBakeGroupOrder = false;
+    uint64 bakeGroupOrderVersion = 0;
+
+    BakeCoordinator bakeCoordinator;
+    BakeWorker bakeWorker;
+    DistributedBakeModes currDistributedBakeMode = DistributedBakeModes::Disabled;
+    uint32 currDistributedBakePort = 0;
+
+    Hash sceneHash;
+    Hash resultCacheKey;
+    int64 resultCacheKeyTag = -1;
+    int64 resultCacheTag = -1;
 };
\ No newline at end of file
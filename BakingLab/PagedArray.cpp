@@ -0,0 +1,96 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "PagedArray.h"
+
+#include <Exceptions.h>
+
+PagedMemory::~PagedMemory()
+{
+    Shutdown();
+}
+
+void PagedMemory::Init(uint64 newSize, bool onDisk)
+{
+    Shutdown();
+
+    if(newSize == 0)
+        return;
+
+    if(onDisk == false)
+    {
+        // Freshly committed pages are always zeroed
+        data = reinterpret_cast<uint8*>(VirtualAlloc(nullptr, newSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        if(data == nullptr)
+            throw Win32Exception(GetLastError(), L"Failed to allocate paged memory:\n");
+        size = newSize;
+        return;
+    }
+
+    wchar tempDir[MAX_PATH + 1];
+    wchar tempPath[MAX_PATH + 1];
+    Win32Call(GetTempPath(ArraySize_(tempDir), tempDir));
+    Win32Call(GetTempFileName(tempDir, L"BLP", 0, tempPath));
+
+    // The temporary attribute keeps the file in the cache as long as there's memory for it
+    fileHandle = CreateFile(tempPath, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if(fileHandle == INVALID_HANDLE_VALUE)
+    {
+        std::wstring errPrefix = std::wstring(L"Failed to create paging file ") + tempPath + L":\n";
+        throw Win32Exception(GetLastError(), errPrefix.c_str());
+    }
+
+    // Mapping past the end of the file grows it, and the new part of the file reads back as zeroes
+    mappingHandle = CreateFileMapping(fileHandle, nullptr, PAGE_READWRITE, DWORD(newSize >> 32),
+                                      DWORD(newSize & 0xFFFFFFFF), nullptr);
+    if(mappingHandle == nullptr)
+    {
+        const DWORD errorCode = GetLastError();
+        Shutdown();
+        std::wstring errPrefix = std::wstring(L"Failed to map paging file ") + tempPath + L":\n";
+        throw Win32Exception(errorCode, errPrefix.c_str());
+    }
+
+    data = reinterpret_cast<uint8*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if(data == nullptr)
+    {
+        const DWORD errorCode = GetLastError();
+        Shutdown();
+        std::wstring errPrefix = std::wstring(L"Failed to map paging file ") + tempPath + L":\n";
+        throw Win32Exception(errorCode, errPrefix.c_str());
+    }
+
+    size = newSize;
+}
+
+void PagedMemory::Shutdown()
+{
+    if(data != nullptr)
+    {
+        if(fileHandle != INVALID_HANDLE_VALUE)
+            UnmapViewOfFile(data);
+        else
+            VirtualFree(data, 0, MEM_RELEASE);
+    }
+
+    if(mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+
+    if(fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+
+    data = nullptr;
+    size = 0;
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+}
@@ -0,0 +1,106 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+
+using namespace SampleFramework11;
+
+// A block of zero-initialized memory that can either be allocated normally, or backed by a
+// temporary file on disk that's mapped into the address space. With a file behind it, the OS
+// only keeps the pages that were recently touched in physical memory, and writes the rest back
+// to the file when it needs the memory for something else. This lets the baker work on data
+// sets that are much bigger than the available memory, as long as it has decent locality. The
+// file gets deleted as soon as the memory is freed (or the process exits).
+class PagedMemory
+{
+
+public:
+
+    PagedMemory() { }
+    ~PagedMemory();
+
+    void Init(uint64 size, bool onDisk);
+    void Shutdown();
+
+    uint64 Size() const { return size; }
+    bool OnDisk() const { return fileHandle != INVALID_HANDLE_VALUE; }
+
+    uint8* Data() { return data; }
+    const uint8* Data() const { return data; }
+
+    void Swap(PagedMemory& other)
+    {
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(fileHandle, other.fileHandle);
+        std::swap(mappingHandle, other.mappingHandle);
+    }
+
+private:
+
+    PagedMemory(const PagedMemory&);
+    PagedMemory& operator=(const PagedMemory&);
+
+    uint8* data = nullptr;
+    uint64 size = 0;
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+};
+
+// A fixed-size array on top of PagedMemory. The elements start out zeroed and their constructors
+// aren't run, so this should only be used for plain data where all zeroes is a valid value.
+template<typename T> class PagedArray
+{
+
+public:
+
+    void Init(uint64 numElements, bool onDisk)
+    {
+        memory.Init(numElements * sizeof(T), onDisk);
+        size = numElements;
+    }
+
+    void Shutdown()
+    {
+        memory.Shutdown();
+        size = 0;
+    }
+
+    uint64 Size() const { return size; }
+    bool OnDisk() const { return memory.OnDisk(); }
+
+    T* Data() { return reinterpret_cast<T*>(memory.Data()); }
+    const T* Data() const { return reinterpret_cast<const T*>(memory.Data()); }
+
+    T& operator[](uint64 idx)
+    {
+        Assert_(idx < size);
+        return Data()[idx];
+    }
+
+    const T& operator[](uint64 idx) const
+    {
+        Assert_(idx < size);
+        return Data()[idx];
+    }
+
+    void Swap(PagedArray& other)
+    {
+        memory.Swap(other.memory);
+        std::swap(size, other.size);
+    }
+
+private:
+
+    PagedMemory memory;
+    uint64 size = 0;
+};
@@ -11,6 +11,7 @@
 #include "PCH.h"
 
 #include "PathTracer.h"
+#include "RadianceCache.h"
 
 #include <Graphics/BRDF.h>
 #include <Graphics/Sampling.h>
@@ -247,6 +248,35 @@ void GenerateIntegrationSamples(IntegrationSamples& samples, uint64 sqrtNumSampl
     }
 }
 
+// Bilinearly samples the light map feedback irradiance, skipping over texels that aren't covered
+static Float3 SampleFeedbackLightMap(const PathTracerParams& params, Float2 lightMapUV)
+{
+    const int32 lightMapSize = int32(params.FeedbackLightMapSize);
+    const float x = lightMapUV.x * lightMapSize - 0.5f;
+    const float y = lightMapUV.y * lightMapSize - 0.5f;
+    const int32 x0 = int32(std::floor(x));
+    const int32 y0 = int32(std::floor(y));
+    const float fracX = x - x0;
+    const float fracY = y - y0;
+
+    Float3 sum;
+    float weightSum = 0.0f;
+    for(int32 tapY = 0; tapY < 2; ++tapY)
+    {
+        for(int32 tapX = 0; tapX < 2; ++tapX)
+        {
+            const int32 texelX = Clamp(x0 + tapX, 0, lightMapSize - 1);
+            const int32 texelY = Clamp(y0 + tapY, 0, lightMapSize - 1);
+            const Float4& texel = params.FeedbackLightMap[texelY * lightMapSize + texelX];
+            const float weight = (tapX ? fracX : 1.0f - fracX) * (tapY ? fracY : 1.0f - fracY) * texel.w;
+            sum += texel.To3D() * weight;
+            weightSum += weight;
+        }
+    }
+
+    return weightSum > 0.0f ? sum / weightSum : Float3(0.0f);
+}
+
 // Returns the incoming radiance along the ray specified by params.RayDir, computed using unidirectional
 // path tracing
 Float3 PathTrace(const PathTracerParams& params, Random& randomGenerator, float& illuminance, bool& hitSky)
@@ -259,6 +289,14 @@ Float3 PathTrace(const PathTracerParams& params, Random& randomGenerator, float&
     Float3 throughput = 1.0f;
     Float3 irrThroughput = 1.0f;
 
+    // The first vertex past the initial hit feeds its outgoing radiance back into the radiance cache
+    RadianceCache* radianceCache = params.RadianceCache;
+    bool addCacheSample = false;
+    Float3 cacheSamplePosition;
+    Float3 cacheSampleNormal;
+    Float3 cacheSampleRadiance;
+    Float3 cacheSampleThroughput;
+
     // Keep tracing paths until we reach the specified max
     const int64 maxPathLength = params.MaxPathLength;
     for(int64 pathLength = 1; pathLength <= maxPathLength || maxPathLength == -1; ++pathLength)
@@ -323,6 +361,26 @@ Float3 PathTrace(const PathTracerParams& params, Random& randomGenerator, float&
             hitSurface.Tangent = Float3::Normalize(hitSurface.Tangent);
             hitSurface.Bitangent = Float3::Normalize(hitSurface.Bitangent);
 
+            // Entries are only recorded at the first secondary vertex, and they hold radiance that was
+            // gathered with the remaining path budget from there. Looking them up at a deeper vertex
+            // would extend the path past the max path length.
+            if(radianceCache != nullptr && pathLength == 2)
+            {
+                // Terminate the path with the cached outgoing radiance if it's accurate enough
+                Float3 cachedRadiance;
+                if(radianceCache->Lookup(hitSurface.Position, hitSurface.Normal, params.RadianceCacheTag, cachedRadiance))
+                {
+                    radiance += cachedRadiance * throughput;
+                    break;
+                }
+
+                addCacheSample = true;
+                cacheSamplePosition = hitSurface.Position;
+                cacheSampleNormal = hitSurface.Normal;
+                cacheSampleRadiance = radiance;
+                cacheSampleThroughput = throughput;
+            }
+
             // Look up the material data
             const uint64 materialIdx = bvh.MaterialIndices[ray.primID];
 
@@ -364,6 +422,15 @@ Float3 PathTrace(const PathTracerParams& params, Random& randomGenerator, float&
 
             diffuseAlbedo *= enableDiffuse ? 1.0f : 0.0f;
 
+            if(params.FeedbackLightMap != nullptr)
+            {
+                // The light map already has all of the lighting from the previous bounces baked into it,
+                // so we just reflect it off of the surface instead of continuing the path
+                const Float3 feedbackIrradiance = SampleFeedbackLightMap(params, hitSurface.LightMapUV);
+                radiance += feedbackIrradiance * diffuseAlbedo * InvPi * throughput;
+                break;
+            }
+
             if(indirectSpecOnly == false)
             {
                 // Compute direct lighting from the sun
@@ -501,6 +568,16 @@ Float3 PathTrace(const PathTracerParams& params, Random& randomGenerator, float&
             break;
     }
 
+    // Everything that was added to the radiance after the cache vertex was weighted by that
+    // vertex's throughput, so dividing it back out gives the vertex's outgoing radiance
+    const float minCacheThroughput = 0.0001f;
+    if(addCacheSample && cacheSampleThroughput.x > minCacheThroughput && cacheSampleThroughput.y > minCacheThroughput
+       && cacheSampleThroughput.z > minCacheThroughput)
+    {
+        const Float3 outgoingRadiance = (radiance - cacheSampleRadiance) / cacheSampleThroughput;
+        radianceCache->AddSample(cacheSamplePosition, cacheSampleNormal, params.RadianceCacheTag, outgoingRadiance);
+    }
+
     illuminance = ComputeLuminance(irradiance);
     return radiance;
 }
\ No newline at end of file
@@ -20,6 +20,7 @@
 // Forward declarations
 struct __RTCScene;
 typedef __RTCScene* RTCScene;
+class RadianceCache;
 
 using namespace SampleFramework11;
 
@@ -47,6 +48,33 @@ struct BVHData
     std::vector<TextureData<UByte4N>> MaterialRoughnessMaps;
     std::vector<TextureData<UByte4N>> MaterialMetallicMaps;
 
+    // Serializes the flattened geometry and material texels, which is everything that the
+    // embree scene gets built from
+    template<typename TSerializer> void SerializeInput(TSerializer& serializer)
+    {
+        SerializeRawVector(serializer, Triangles);
+        SerializeRawVector(serializer, Vertices);
+        SerializeRawVector(serializer, MaterialIndices);
+        SerializeItem(serializer, MaterialDiffuseMaps);
+        SerializeItem(serializer, MaterialNormalMaps);
+        SerializeItem(serializer, MaterialRoughnessMaps);
+        SerializeItem(serializer, MaterialMetallicMaps);
+    }
+
+    // Exchanges everything with another BVH, including ownership of the embree scene
+    void Swap(BVHData& other)
+    {
+        std::swap(Device, other.Device);
+        std::swap(Scene, other.Scene);
+        Triangles.swap(other.Triangles);
+        Vertices.swap(other.Vertices);
+        MaterialIndices.swap(other.MaterialIndices);
+        MaterialDiffuseMaps.swap(other.MaterialDiffuseMaps);
+        MaterialNormalMaps.swap(other.MaterialNormalMaps);
+        MaterialRoughnessMaps.swap(other.MaterialRoughnessMaps);
+        MaterialMetallicMaps.swap(other.MaterialMetallicMaps);
+    }
+
     ~BVHData()
     {
         if(Scene != nullptr)
@@ -219,6 +247,16 @@ struct PathTracerParams
     const IntegrationSampleSet* SampleSet = nullptr;
     const SkyCache* SkyCache = nullptr;
     const TextureData<Half4>* EnvMaps = nullptr;
+
+    // Optional cache of outgoing radiance used for vertices past the first hit. Entries are
+    // only valid for the tag that they were created with.
+    RadianceCache* RadianceCache = nullptr;
+    int64 RadianceCacheTag = 0;
+
+    // Optional light map holding the irradiance from the previous bounce (with a validity flag
+    // in w). When set, paths end at their first hit and are shaded using the light map.
+    const Float4* FeedbackLightMap = nullptr;
+    uint64 FeedbackLightMapSize = 0;
 };
 
 // Returns the incoming radiance along the ray specified by "RayDir", computed using unidirectional
@@ -0,0 +1,135 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "RadianceCache.h"
+
+#include <MurmurHash.h>
+
+void RadianceCache::Init(uint64 numEntries)
+{
+    Assert_(numEntries > 0 && (numEntries & (numEntries - 1)) == 0);
+    entries.Init(numEntries);
+    entryMask = numEntries - 1;
+}
+
+void RadianceCache::Shutdown()
+{
+    entries.Shutdown();
+    entryMask = 0;
+}
+
+uint64 RadianceCache::ComputeKey(const Float3& position, const Float3& normal) const
+{
+    // Normals are snapped to a coarse grid so that opposite sides of thin walls and
+    // surfaces meeting at a crease end up in different cells
+    const float invCellSize = 1.0f / CellSize;
+    const int32 cell[6] =
+    {
+        int32(std::floor(position.x * invCellSize)),
+        int32(std::floor(position.y * invCellSize)),
+        int32(std::floor(position.z * invCellSize)),
+        int32(std::floor(normal.x * 2.0f + 0.5f)),
+        int32(std::floor(normal.y * 2.0f + 0.5f)),
+        int32(std::floor(normal.z * 2.0f + 0.5f)),
+    };
+
+    // A key of 0 marks an empty entry
+    const uint64 key = GenerateHash(cell, sizeof(cell)).A;
+    return key != 0 ? key : 1;
+}
+
+RadianceCacheEntry* RadianceCache::AcquireEntry(uint64 key, int64 tag, bool claim)
+{
+    // Linear probing, where each entry is guarded by its own spin lock. Entries left over from
+    // a previous tag are treated as empty and re-claimed in place. Since a key always claims the
+    // first free entry along its probe sequence, a search without claiming can stop there.
+    for(uint64 probeIdx = 0; probeIdx < MaxProbes; ++probeIdx)
+    {
+        RadianceCacheEntry* entry = &entries[(key + probeIdx) & entryMask];
+        while(InterlockedCompareExchange64(&entry->Lock, 1, 0) != 0)
+            YieldProcessor();
+
+        if(entry->Key == key && entry->Tag == tag)
+            return entry;
+
+        if(entry->Key == 0 || entry->Tag != tag)
+        {
+            if(claim == false)
+            {
+                ReleaseEntry(entry);
+                return nullptr;
+            }
+
+            entry->Key = key;
+            entry->Tag = tag;
+            entry->RadianceSum = 0.0f;
+            entry->RadianceSqSum = 0.0f;
+            entry->NumSamples = 0;
+            return entry;
+        }
+
+        ReleaseEntry(entry);
+    }
+
+    // The neighborhood is full, so this cell just doesn't get cached
+    return nullptr;
+}
+
+void RadianceCache::ReleaseEntry(RadianceCacheEntry* entry)
+{
+    InterlockedExchange64(&entry->Lock, 0);
+}
+
+bool RadianceCache::Lookup(const Float3& position, const Float3& normal, int64 tag, Float3& radiance)
+{
+    RadianceCacheEntry* entry = AcquireEntry(ComputeKey(position, normal), tag, false);
+    if(entry == nullptr)
+        return false;
+
+    bool converged = false;
+    const uint32 numSamples = entry->NumSamples;
+    if(numSamples >= MinSamples)
+    {
+        // Compare the standard error of the mean against the mean itself for each channel, which
+        // means that channels with no energy at all are always considered converged
+        const float n = float(numSamples);
+        const Float3 mean = entry->RadianceSum / n;
+        const Float3 meanSq = entry->RadianceSqSum / n;
+        converged = true;
+        for(uint64 i = 0; i < 3; ++i)
+        {
+            const float variance = std::max(meanSq[i] - mean[i] * mean[i], 0.0f);
+            if(std::sqrt(variance / n) > ErrorTolerance * mean[i])
+                converged = false;
+        }
+
+        if(converged)
+            radiance = mean;
+    }
+
+    ReleaseEntry(entry);
+
+    return converged;
+}
+
+void RadianceCache::AddSample(const Float3& position, const Float3& normal, int64 tag, const Float3& radiance)
+{
+    RadianceCacheEntry* entry = AcquireEntry(ComputeKey(position, normal), tag, true);
+    if(entry == nullptr)
+        return;
+
+    entry->RadianceSum += radiance;
+    entry->RadianceSqSum += radiance * radiance;
+    entry->NumSamples += 1;
+
+    ReleaseEntry(entry);
+}
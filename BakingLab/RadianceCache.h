@@ -0,0 +1,77 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+
+using namespace SampleFramework11;
+
+// A single cached estimate of the outgoing radiance from a small patch of the scene
+struct RadianceCacheEntry
+{
+    uint64 Key = 0;
+    int64 Tag = -1;
+    volatile int64 Lock = 0;
+    Float3 RadianceSum;
+    Float3 RadianceSqSum;
+    uint32 NumSamples = 0;
+};
+
+// Thread-safe spatial hash of outgoing radiance estimates, keyed on a quantized world-space
+// position and normal. The path tracer feeds it with the outgoing radiance computed at the first
+// secondary vertex of each path, and once a cell's estimate has converged to within the error
+// tolerance it's used in place of tracing the rest of a path that lands in that cell. Lookups
+// only happen at that same vertex, since the cached radiance was gathered with the remaining
+// path budget from there.
+//
+// Entries are tagged with the bake tag that produced them, so changing the lighting or scene
+// invalidates the cache without needing to synchronize with the threads that are using it.
+class RadianceCache
+{
+
+public:
+
+    void Init(uint64 numEntries);
+    void Shutdown();
+
+    bool Initialized() const { return entries.Size() > 0; }
+
+    // Returns true and fills in the cached outgoing radiance if the cell containing the given
+    // point has an estimate whose relative standard error is below the tolerance. This never
+    // claims an entry, so cells only get created by AddSample().
+    bool Lookup(const Float3& position, const Float3& normal, int64 tag, Float3& radiance);
+
+    // Adds a new outgoing radiance sample to the cell containing the given point
+    void AddSample(const Float3& position, const Float3& normal, int64 tag, const Float3& radiance);
+
+    // World-space size of a cache cell
+    float CellSize = 0.1f;
+
+    // Maximum relative standard error of any color channel of a cell's mean before it can be used
+    float ErrorTolerance = 0.05f;
+
+    // A cell always needs at least this many samples before it's used, so that the variance
+    // estimate is somewhat trustworthy
+    uint32 MinSamples = 32;
+
+private:
+
+    uint64 ComputeKey(const Float3& position, const Float3& normal) const;
+    RadianceCacheEntry* AcquireEntry(uint64 key, int64 tag, bool claim);
+    void ReleaseEntry(RadianceCacheEntry* entry);
+
+    static const uint64 MaxProbes = 16;
+
+    FixedArray<RadianceCacheEntry> entries;
+    uint64 entryMask = 0;
+};
@@ -0,0 +1,138 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "RenderResultStore.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+StaticAssert_(sizeof(RenderResultStore::Tile) % RenderResultStore::CacheLineSize == 0);
+
+// F16C needs the OS to save the AVX register state, in addition to the CPU supporting it
+static bool CheckF16CSupport()
+{
+    int32 cpuInfo[4] = { };
+    __cpuid(cpuInfo, 1);
+    const bool f16c = (cpuInfo[2] & (1 << 29)) != 0;
+    const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    if(f16c == false || osxsave == false)
+        return false;
+
+    return (_xgetbv(0) & 0x6) == 0x6;
+}
+
+static const bool F16CSupported = CheckF16CSupport();
+
+// Resolves a row of pixels using F16C to convert 4 channels at a time
+static void ResolvePixelsF16C(const RenderResultStore::Tile& tile, uint64 tilePixelIdx, uint64 numPixels, Half4* dst)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maxValue = _mm_set1_ps(FP16Max);
+    for(uint64 i = 0; i < numPixels; ++i)
+    {
+        const float count = tile.Counts[tilePixelIdx + i];
+        __m128 result = zero;
+        if(count > 0.0f)
+        {
+            result = _mm_div_ps(_mm_loadu_ps(&tile.Sums[tilePixelIdx + i].x), _mm_set1_ps(count));
+            result = _mm_min_ps(_mm_max_ps(result, zero), maxValue);
+        }
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_cvtps_ph(result, 0));
+    }
+}
+
+static Half4 ResolvePixel(const RenderResultStore::Tile& tile, uint64 tilePixelIdx)
+{
+    const float count = tile.Counts[tilePixelIdx];
+    if(count <= 0.0f)
+        return Half4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    return Half4(Float4::Clamp(tile.Sums[tilePixelIdx] / count, 0.0f, FP16Max));
+}
+
+void RenderResultStore::Init(uint64 newWidth, uint64 newHeight)
+{
+    Shutdown();
+
+    Assert_(newWidth > 0 && newHeight > 0);
+    width = newWidth;
+    height = newHeight;
+
+    // Partial tiles along the right and bottom edges are padded out to a full tile
+    numTilesX = (width + (TileSize - 1)) / TileSize;
+    numTilesY = (height + (TileSize - 1)) / TileSize;
+    numTiles = numTilesX * numTilesY;
+
+    tiles = reinterpret_cast<Tile*>(_aligned_malloc(numTiles * sizeof(Tile), CacheLineSize));
+    if(tiles == nullptr)
+        throw Exception(L"Failed to allocate the ground truth render buffer");
+
+    memset(tiles, 0, numTiles * sizeof(Tile));
+
+    // Everything needs to be resolved once, so that the render texture gets cleared
+    dirtyTiles.Init(numTiles, 1);
+}
+
+void RenderResultStore::Shutdown()
+{
+    if(tiles != nullptr)
+    {
+        _aligned_free(tiles);
+        tiles = nullptr;
+    }
+
+    dirtyTiles.Shutdown();
+    width = 0;
+    height = 0;
+    numTilesX = 0;
+    numTilesY = 0;
+    numTiles = 0;
+}
+
+Half4 RenderResultStore::Resolve(uint64 x, uint64 y) const
+{
+    Assert_(x < width && y < height);
+    const Tile& tile = GetTile((y / TileSize) * numTilesX + (x / TileSize));
+    return ResolvePixel(tile, (y % TileSize) * TileSize + (x % TileSize));
+}
+
+void RenderResultStore::ResolveTiles(uint64 tileX, uint64 tileY, uint64 runLength, Half4* dst, uint64 dstRowPitch) const
+{
+    Assert_(tileX + runLength <= numTilesX && tileY < numTilesY);
+
+    const uint64 startX = tileX * TileSize;
+    const uint64 startY = tileY * TileSize;
+    const uint64 numRows = std::min(TileSize, height - startY);
+    const Tile* tileRun = tiles + tileY * numTilesX + tileX;
+    for(uint64 row = 0; row < numRows; ++row)
+    {
+        Half4* dstRow = reinterpret_cast<Half4*>(reinterpret_cast<uint8*>(dst) + row * dstRowPitch);
+        const uint64 tilePixelY = row * TileSize;
+        for(uint64 i = 0; i < runLength; ++i)
+        {
+            const Tile& tile = tileRun[i];
+            const uint64 x = (tileX + i) * TileSize;
+            const uint64 numPixels = std::min(TileSize, width - x);
+            Half4* dstPixels = dstRow + (x - startX);
+            if(F16CSupported)
+            {
+                ResolvePixelsF16C(tile, tilePixelY, numPixels, dstPixels);
+            }
+            else
+            {
+                for(uint64 pixelX = 0; pixelX < numPixels; ++pixelX)
+                    dstPixels[pixelX] = ResolvePixel(tile, tilePixelY + pixelX);
+            }
+        }
+    }
+}
@@ -0,0 +1,97 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <SF11_Math.h>
+#include <Containers.h>
+
+using namespace SampleFramework11;
+
+// Accumulation buffer for the ground truth path tracer. The screen is split into square tiles
+// that match the tiles handed out to the render threads, and each tile keeps a full-precision
+// running sum and sample count for every pixel in one contiguous block. The blocks are aligned
+// to cache lines so that threads working on neighboring tiles never write to the same line.
+// The FP16 image that gets displayed is only produced when a frame is resolved, and only for the
+// tiles that the render threads have touched since the last resolve.
+class RenderResultStore
+{
+
+public:
+
+    static const uint64 TileSize = 16;
+    static const uint64 NumTilePixels = TileSize * TileSize;
+    static const uint64 CacheLineSize = 64;
+
+    struct Tile
+    {
+        Float4 Sums[NumTilePixels];
+        float Counts[NumTilePixels];
+    };
+
+    RenderResultStore() {}
+    ~RenderResultStore() { Shutdown(); }
+
+    void Init(uint64 width, uint64 height);
+    void Shutdown();
+
+    uint64 Width() const { return width; }
+    uint64 Height() const { return height; }
+    uint64 NumTilesX() const { return numTilesX; }
+    uint64 NumTilesY() const { return numTilesY; }
+    uint64 NumTiles() const { return numTiles; }
+
+    Tile& GetTile(uint64 tileIdx)
+    {
+        Assert_(tileIdx < numTiles);
+        return tiles[tileIdx];
+    }
+
+    const Tile& GetTile(uint64 tileIdx) const
+    {
+        Assert_(tileIdx < numTiles);
+        return tiles[tileIdx];
+    }
+
+    // Returns the averaged result for a single pixel
+    Half4 Resolve(uint64 x, uint64 y) const;
+
+    // Writes the averaged results for a horizontal run of tiles out in row-major order, which is
+    // what the render texture expects. Pixels past the edge of the screen are skipped.
+    void ResolveTiles(uint64 tileX, uint64 tileY, uint64 runLength, Half4* dst, uint64 dstRowPitch) const;
+
+    // Called by the render threads once they're done writing to a tile
+    void MarkTileDirty(uint64 tileIdx)
+    {
+        Assert_(tileIdx < numTiles);
+        reinterpret_cast<volatile int64*>(dirtyTiles.Data())[tileIdx] = 1;
+    }
+
+    // Clears a tile's dirty flag, and returns whether it was set
+    bool ClearTileDirty(uint64 tileIdx)
+    {
+        Assert_(tileIdx < numTiles);
+        return InterlockedExchange64(reinterpret_cast<volatile int64*>(dirtyTiles.Data()) + tileIdx, 0) != 0;
+    }
+
+private:
+
+    RenderResultStore(const RenderResultStore& other) {}
+    RenderResultStore& operator=(const RenderResultStore& other) { return *this; }
+
+    uint64 width = 0;
+    uint64 height = 0;
+    uint64 numTilesX = 0;
+    uint64 numTilesY = 0;
+    uint64 numTiles = 0;
+    Tile* tiles = nullptr;
+    FixedArray<int64> dirtyTiles;
+};
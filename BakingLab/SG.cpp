@@ -12,17 +12,18 @@
 
 #define EIGEN_MPL2_ONLY
 #include "../Externals/eigen/Eigen/Dense"
-#include "../Externals/eigen/Eigen/NNLS"
 
 #include "../Externals/eigen/unsupported/Eigen/NonLinearOptimization"
 #include "../Externals/eigen/unsupported/Eigen/NumericalDiff"
 
 #include "SG.h"
 #include <FileIO.h>
+#include <MurmurHash.h>
 #include "AppSettings.h"
 #include <Graphics/Sampling.h>
 
 static SG defaultInitialGuess[AppSettings::MaxSGCount];
+static SGLobes defaultInitialGuessLobes;
 static bool eigenInitialized = false;
 
 // Generate uniform spherical gaussians on the sphere or hemisphere
@@ -95,6 +96,10 @@ void InitializeSGSolver(uint64 numSGs, SGDistribution distribution)
     }
 
 	GenerateUniformSGs(defaultInitialGuess, numSGs, distribution);
+    InitSGLobes(defaultInitialGuessLobes, defaultInitialGuess, numSGs);
+
+    // Any cached factorizations were built with the old lobe directions and sharpness
+    ClearSGSolverCache();
 }
 
 const SG* InitialGuess()
@@ -102,112 +107,561 @@ const SG* InitialGuess()
     return defaultInitialGuess;
 }
 
-// Solve for SG's using non-negative least squares
-static void SolveNNLS(SGSolveParam& params)
+const SGLobes& InitialGuessLobes()
 {
-    Assert_(params.XSamples != nullptr);
-    Assert_(params.YSamples != nullptr);
+    return defaultInitialGuessLobes;
+}
+
+void InitSGLobes(SGLobes& lobes, const SG* sgs, uint64 numSGs)
+{
+    Assert_(numSGs <= uint64(AppSettings::MaxSGCount));
+    lobes.NumSGs = numSGs;
+    lobes.NumVectors = (numSGs + 3) / 4;
+
+    for(uint64 v = 0; v < lobes.NumVectors; ++v)
+    {
+        float axisX[4] = { };
+        float axisY[4] = { };
+        float axisZ[4] = { };
+        float sharpness[4] = { };
+        for(uint64 lane = 0; lane < 4 && v * 4 + lane < numSGs; ++lane)
+        {
+            const SG& sg = sgs[v * 4 + lane];
+            axisX[lane] = sg.Axis.x;
+            axisY[lane] = sg.Axis.y;
+            axisZ[lane] = sg.Axis.z;
+            sharpness[lane] = sg.Sharpness;
+        }
+
+        lobes.AxisX[v] = _mm_loadu_ps(axisX);
+        lobes.AxisY[v] = _mm_loadu_ps(axisY);
+        lobes.AxisZ[v] = _mm_loadu_ps(axisZ);
+        lobes.Sharpness[v] = _mm_loadu_ps(sharpness);
+    }
+}
 
-    // -- Linearly solve for the rgb channels one at a time
-    Eigen::MatrixXf Ar, Ag, Ab;
-    Ar.resize(params.NumSamples, int64(params.NumSGs));
-    Ag.resize(params.NumSamples, int64(params.NumSGs));
-    Ab.resize(params.NumSamples, int64(params.NumSGs));
-    Eigen::VectorXf br(params.NumSamples);
-    Eigen::VectorXf bg(params.NumSamples);
-    Eigen::VectorXf bb(params.NumSamples);
+// Computes exp(x) for 4 values using the range reduction and polynomial from the Cephes expf(),
+// which is accurate to within a couple of ulps. Results that would be denormal are flushed to 0.
+static __m128 FastExp(__m128 x)
+{
+    const __m128 maxX = _mm_set1_ps(88.0f);
+    const __m128 minX = _mm_set1_ps(-87.3365447f);
+    const __m128 underflow = _mm_cmplt_ps(x, minX);
+    x = _mm_min_ps(_mm_max_ps(x, minX), maxX);
+
+    // exp(x) = 2^n * exp(r), with r = x - n * ln(2) in [-ln(2) / 2, ln(2) / 2]
+    const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)));
+    const __m128 nf = _mm_cvtepi32_ps(n);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(0.693359375f)));
+    r = _mm_add_ps(r, _mm_mul_ps(nf, _mm_set1_ps(2.12194440e-4f)));
+
+    __m128 p = _mm_set1_ps(1.9875691500e-4f);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.3981999507e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, _mm_mul_ps(r, r)), _mm_add_ps(r, _mm_set1_ps(1.0f)));
+
+    // Build 2^n directly in the exponent bits
+    const __m128 pow2n = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+
+    return _mm_andnot_ps(underflow, _mm_mul_ps(p, pow2n));
+}
+
+// Shared by both versions of EvaluateSGLobeWeights
+static void EvaluateSGLobeVectors(const SGLobes& lobes, const Float3& dir, float* outWeights, uint64 numVectors)
+{
+    const __m128 dirX = _mm_set1_ps(dir.x);
+    const __m128 dirY = _mm_set1_ps(dir.y);
+    const __m128 dirZ = _mm_set1_ps(dir.z);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for(uint64 v = 0; v < numVectors; ++v)
+    {
+        __m128 dp = _mm_mul_ps(lobes.AxisX[v], dirX);
+        dp = _mm_add_ps(dp, _mm_mul_ps(lobes.AxisY[v], dirY));
+        dp = _mm_add_ps(dp, _mm_mul_ps(lobes.AxisZ[v], dirZ));
+        const __m128 exponent = _mm_mul_ps(lobes.Sharpness[v], _mm_sub_ps(dp, one));
+        _mm_storeu_ps(outWeights + v * 4, FastExp(exponent));
+    }
+}
+
+void EvaluateSGLobeWeights(const SGLobes& lobes, const Float3& dir, float* outWeights)
+{
+    EvaluateSGLobeVectors(lobes, dir, outWeights, lobes.NumVectors);
+}
+
+template<uint64 SGCount> void EvaluateSGLobeWeights(const SGLobes& lobes, const Float3& dir, float* outWeights)
+{
+    Assert_(lobes.NumSGs == SGCount);
+    EvaluateSGLobeVectors(lobes, dir, outWeights, (SGCount + 3) / 4);
+}
+
+// Eigen types for solving a fixed number of SG's. Only the design matrix has a dimension that
+// depends on the sample count, and that always gets mapped onto memory from the scratch arena.
+template<uint64 SGCount> struct SGSolverTypes
+{
+    static const int N = int(SGCount);
+
+    typedef Eigen::Matrix<float, Eigen::Dynamic, N> DesignMatrix;
+    typedef Eigen::Map<DesignMatrix, Eigen::Aligned> DesignMatrixMap;
+    typedef Eigen::Map<const DesignMatrix> ConstDesignMatrixMap;
+    typedef Eigen::Matrix<double, N, N> NormalMatrix;
+    typedef Eigen::Matrix<double, N, 1> Vector;
+    typedef Eigen::Matrix<double, N, 3> RhsMatrix;
+    typedef Eigen::Matrix<float, N, 3> Solution;
+
+    // The subsets of the system that NNLS and the SVD work on can be smaller than N x N
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, N, N> SubMatrix;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, N, 1> SubVector;
+    typedef Eigen::Matrix<float, Eigen::Dynamic, N, 0, N, N> TriangularFactor;
+    typedef Eigen::Matrix<float, Eigen::Dynamic, 3, 0, N, 3> TriangularRhs;
+};
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, 3> SampleMatrix;
+typedef Eigen::Map<SampleMatrix, Eigen::Aligned> SampleMatrixMap;
+
+StaticAssert_(ScratchArena::Alignment % 16 == 0);
+
+// Cached design matrix data for a single set of sample directions. Tangent-space bakes tile the
+// same integration samples across every bake group, so the matrix (and its factorization) only
+// needs to be built once per unique set of directions instead of once per texel.
+struct SGSolverCacheEntry
+{
+    Hash Key;
+    Eigen::MatrixXf A;                  // NumSamples x NumSGs design matrix (NNLS only)
+    Eigen::MatrixXd AtA;                // NumSGs x NumSGs normal matrix (NNLS only)
+    Eigen::MatrixXf PseudoInverse;      // NumSGs x NumSamples (SVD only)
+    uint64 Size = 0;
+    mutable volatile int64 LastUse = 0; // Cache clock value from the last lookup, for LRU eviction
+};
+
+typedef std::shared_ptr<const SGSolverCacheEntry> SGSolverCacheEntryPtr;
+
+static const uint64 SGSolverCacheBudget = 128 * 1024 * 1024;
+static std::map<std::pair<uint64, uint64>, SGSolverCacheEntryPtr> sgSolverCache;
+static uint64 sgSolverCacheSize = 0;
+static volatile int64 sgSolverCacheClock = 0;
+static SRWLOCK sgSolverCacheLock = SRWLOCK_INIT;
+
+void ClearSGSolverCache()
+{
+    AcquireSRWLockExclusive(&sgSolverCacheLock);
+    sgSolverCache.clear();
+    sgSolverCacheSize = 0;
+    ReleaseSRWLockExclusive(&sgSolverCacheLock);
+}
+
+// Fills the NumSamples x NumSGs matrix that maps SG amplitudes to radiance for each sample direction
+template<typename TMatrix> static void BuildDesignMatrix(const SGSolveParam& params, TMatrix& A)
+{
+    Assert_(uint64(A.rows()) == params.NumSamples && uint64(A.cols()) == params.NumSGs);
+
+    SGLobes lobes;
+    InitSGLobes(lobes, params.OutSGs, params.NumSGs);
+
+    float weights[SGLobes::MaxVectors * 4];
     for(uint32 i = 0; i < params.NumSamples; ++i)
     {
-        // compute difference squared from actual observed data
+        EvaluateSGLobeWeights(lobes, params.XSamples[i], weights);
         for(uint32 j = 0; j < params.NumSGs; ++j)
+            A(i, j) = weights[j];
+    }
+}
+
+// Packs the rgb sample values into the columns of a NumSamples x 3 matrix, so that all three
+// channels can be solved in a single pass
+static void BuildSampleMatrix(const SGSolveParam& params, SampleMatrixMap& B)
+{
+    Assert_(uint64(B.rows()) == params.NumSamples);
+
+    for(uint32 i = 0; i < params.NumSamples; ++i)
+    {
+        B(i, 0) = params.YSamples[i].x;
+        B(i, 1) = params.YSamples[i].y;
+        B(i, 2) = params.YSamples[i].z;
+    }
+}
+
+// Computes At * A in double precision. The products are done a column pair at a time so that no
+// double-precision copy of A is needed.
+template<typename TMatrixA, typename TMatrixAtA> static void ComputeNormalMatrix(const TMatrixA& A, TMatrixAtA& AtA)
+{
+    const int64 numSGs = A.cols();
+    AtA.resize(numSGs, numSGs);
+    for(int64 i = 0; i < numSGs; ++i)
+    {
+        for(int64 j = i; j < numSGs; ++j)
         {
-            float exponent = exp((Float3::Dot(params.XSamples[i], params.OutSGs[j].Axis) - 1.0f) *
-                                 params.OutSGs[j].Sharpness);
-            Ar(i,j) = exponent;
-            Ag(i,j) = exponent;
-            Ab(i,j) = exponent;
+            AtA(i, j) = A.col(i).template cast<double>().dot(A.col(j).template cast<double>());
+            AtA(j, i) = AtA(i, j);
         }
-        br(i) = params.YSamples[i].x;
-        bg(i) = params.YSamples[i].y;
-        bb(i) = params.YSamples[i].z;
     }
+}
 
-    Eigen::NNLS<Eigen::MatrixXf> nnlsr(Ar);
-    Eigen::NNLS<Eigen::MatrixXf> nnlsg(Ag);
-    Eigen::NNLS<Eigen::MatrixXf> nnlsb(Ab);
-    nnlsr.solve(br);
-    nnlsg.solve(bg);
-    nnlsb.solve(bb);
-    Eigen::VectorXf rchan = nnlsr.x();
-    Eigen::VectorXf gchan = nnlsg.x();
-    Eigen::VectorXf bchan = nnlsb.x();
+// Computes At * B in double precision for all three color channels
+template<typename TMatrixA, typename TMatrixAtB> static void ComputeAtB(const TMatrixA& A, const SampleMatrixMap& B, TMatrixAtB& AtB)
+{
+    for(int64 i = 0; i < A.cols(); ++i)
+        for(int64 c = 0; c < 3; ++c)
+            AtB(i, c) = A.col(i).template cast<double>().dot(B.col(c).template cast<double>());
+}
 
-    for(uint32 j = 0; j < params.NumSGs; ++j)
+// Inverts the singular values of an SVD of a rows x cols matrix in place. Singular values below
+// max(rows, cols) * eps * sigma_max are treated as zero (the same cutoff that newer versions of
+// JacobiSVD use for solve() and rank()), so that near-singular lobe configurations get truncated
+// instead of blowing up. Both of the SVD solve paths go through this so that they agree.
+template<typename TVector> static void InvertSingularValues(TVector& singularValues, int64 rows, int64 cols)
+{
+    const float maxSingularValue = singularValues.size() > 0 ? singularValues(0) : 0.0f;
+    const float threshold = float(std::max(rows, cols)) * FLT_EPSILON * maxSingularValue;
+    for(int64 i = 0; i < singularValues.size(); ++i)
+        singularValues(i) = singularValues(i) > threshold ? 1.0f / singularValues(i) : 0.0f;
+}
+
+// Computes the pseudo-inverse from the SVD of A
+static void ComputePseudoInverse(const Eigen::MatrixXf& A, Eigen::MatrixXf& pseudoInverse)
+{
+    Eigen::JacobiSVD<Eigen::MatrixXf> svd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    Eigen::VectorXf invSingularValues = svd.singularValues();
+    InvertSingularValues(invSingularValues, A.rows(), A.cols());
+
+    pseudoInverse = svd.matrixV() * invSingularValues.asDiagonal() * svd.matrixU().transpose();
+}
+
+// Drops the least recently used entries until there's room for a new entry of the given size.
+// Must be called with the cache lock held exclusively.
+static void EvictSGSolverCacheEntries(uint64 newEntrySize)
+{
+    while(sgSolverCache.empty() == false && sgSolverCacheSize + newEntrySize > SGSolverCacheBudget)
+    {
+        auto oldest = sgSolverCache.begin();
+        for(auto iter = sgSolverCache.begin(); iter != sgSolverCache.end(); ++iter)
+            if(iter->second->LastUse < oldest->second->LastUse)
+                oldest = iter;
+
+        sgSolverCacheSize -= oldest->second->Size;
+        sgSolverCache.erase(oldest);
+    }
+}
+
+// Returns the cached design matrix data for the sample directions, building it if necessary
+static SGSolverCacheEntryPtr GetCachedFactorization(const SGSolveParam& params, bool svd)
+{
+    const uint32 seed = uint32(params.NumSGs) | (svd ? 0x100 : 0);
+    const Hash key = GenerateHash(params.XSamples, int(params.NumSamples * sizeof(Float3)), seed);
+    const std::pair<uint64, uint64> mapKey(key.A, key.B);
+
+    SGSolverCacheEntryPtr entry;
+    AcquireSRWLockShared(&sgSolverCacheLock);
+    auto iter = sgSolverCache.find(mapKey);
+    if(iter != sgSolverCache.end())
+    {
+        entry = iter->second;
+        InterlockedExchange64(&entry->LastUse, InterlockedIncrement64(&sgSolverCacheClock));
+    }
+    ReleaseSRWLockShared(&sgSolverCacheLock);
+
+    if(entry)
+        return entry;
+
+    std::shared_ptr<SGSolverCacheEntry> newEntry = std::make_shared<SGSolverCacheEntry>();
+    newEntry->Key = key;
+    Eigen::MatrixXf A(params.NumSamples, params.NumSGs);
+    BuildDesignMatrix(params, A);
+    if(svd)
+    {
+        ComputePseudoInverse(A, newEntry->PseudoInverse);
+        newEntry->Size = newEntry->PseudoInverse.size() * sizeof(float);
+    }
+    else
+    {
+        ComputeNormalMatrix(A, newEntry->AtA);
+        newEntry->A = std::move(A);
+        newEntry->Size = newEntry->A.size() * sizeof(float) + newEntry->AtA.size() * sizeof(double);
+    }
+
+    newEntry->LastUse = InterlockedIncrement64(&sgSolverCacheClock);
+
+    // Another thread may have beaten us to it, in which case we just use our own copy
+    AcquireSRWLockExclusive(&sgSolverCacheLock);
+    if(sgSolverCache.find(mapKey) == sgSolverCache.end())
+    {
+        EvictSGSolverCacheEntries(newEntry->Size);
+        sgSolverCache[mapKey] = newEntry;
+        sgSolverCacheSize += newEntry->Size;
+    }
+    ReleaseSRWLockExclusive(&sgSolverCacheLock);
+
+    return newEntry;
+}
+
+// Solves the unconstrained least squares problem restricted to the passive set of variables,
+// with all other variables fixed at 0
+template<uint64 SGCount> static void SolvePassiveSet(const typename SGSolverTypes<SGCount>::NormalMatrix& AtA,
+                                                     const typename SGSolverTypes<SGCount>::Vector& Atb,
+                                                     const bool* passive, typename SGSolverTypes<SGCount>::Vector& z)
+{
+    typedef SGSolverTypes<SGCount> Types;
+
+    int64 indices[SGCount];
+    int64 numPassive = 0;
+    for(int64 j = 0; j < int64(SGCount); ++j)
+        if(passive[j])
+            indices[numPassive++] = j;
+
+    typename Types::SubMatrix subAtA(numPassive, numPassive);
+    typename Types::SubVector subAtb(numPassive);
+    for(int64 r = 0; r < numPassive; ++r)
+    {
+        subAtb(r) = Atb(indices[r]);
+        for(int64 c = 0; c < numPassive; ++c)
+            subAtA(r, c) = AtA(indices[r], indices[c]);
+    }
+
+    typename Types::SubVector subZ = subAtA.ldlt().solve(subAtb);
+
+    z.setZero();
+    for(int64 r = 0; r < numPassive; ++r)
+        z(indices[r]) = subZ(r);
+}
+
+// Lawson-Hanson active set NNLS that works off of the normal equations (AtA * x = Atb). This only
+// needs the k x k normal matrix, which can be shared between all three color channels.
+template<uint64 SGCount> static void SolveNNLSNormalEquations(const typename SGSolverTypes<SGCount>::NormalMatrix& AtA,
+                                                              const typename SGSolverTypes<SGCount>::Vector& Atb,
+                                                              typename SGSolverTypes<SGCount>::Vector& x)
+{
+    typedef SGSolverTypes<SGCount> Types;
+    const int64 n = int64(SGCount);
+
+    x.setZero();
+    bool passive[SGCount] = { };
+
+    const double tolerance = 1e-10 * std::max(1.0, Atb.cwiseAbs().maxCoeff());
+    const uint64 maxIterations = 3 * n;
+
+    typename Types::Vector z;
+    for(uint64 iteration = 0; iteration < maxIterations; ++iteration)
     {
-        params.OutSGs[j].Amplitude.x = rchan[j];
-        params.OutSGs[j].Amplitude.y = gchan[j];
-        params.OutSGs[j].Amplitude.z = bchan[j];
+        // Find the most promising variable that's currently clamped to 0
+        typename Types::Vector w = Atb;
+        w.noalias() -= AtA * x;
+        int64 maxIdx = -1;
+        double maxW = tolerance;
+        for(int64 j = 0; j < n; ++j)
+        {
+            if(passive[j] == false && w(j) > maxW)
+            {
+                maxW = w(j);
+                maxIdx = j;
+            }
+        }
+
+        if(maxIdx < 0)
+            break;
+
+        passive[maxIdx] = true;
+
+        while(true)
+        {
+            SolvePassiveSet<SGCount>(AtA, Atb, passive, z);
+
+            // Step as far towards the unconstrained solution as we can while staying feasible
+            double alpha = 1.0;
+            bool feasible = true;
+            for(int64 j = 0; j < n; ++j)
+            {
+                if(passive[j] && z(j) <= 0.0)
+                {
+                    feasible = false;
+                    alpha = std::min(alpha, x(j) / (x(j) - z(j)));
+                }
+            }
+
+            if(feasible)
+            {
+                x = z;
+                break;
+            }
+
+            x += alpha * (z - x);
+
+            int64 numPassive = 0;
+            for(int64 j = 0; j < n; ++j)
+            {
+                if(passive[j] && x(j) <= tolerance * 1e-6)
+                {
+                    passive[j] = false;
+                    x(j) = 0.0;
+                }
+                numPassive += passive[j] ? 1 : 0;
+            }
+
+            if(numPassive == 0)
+                break;
+        }
     }
 }
 
+// Applies the Householder reflection H = I - tau * v * vt to a single column, where v is 1 followed
+// by the essential part. This is the same thing Eigen's applyHouseholderOnTheLeft does, but done a
+// column at a time it never needs a temporary for the outer product.
+template<typename TEssential, typename TColumn> static void ApplyHouseholderToColumn(const TEssential& essential, float tau, TColumn column)
+{
+    const int64 tailSize = column.size() - 1;
+    const float dp = tau * (column(0) + essential.dot(column.tail(tailSize)));
+    column(0) -= dp;
+    column.tail(tailSize) -= dp * essential;
+}
+
+// Finds the minimum-norm least squares solution for A * X = B. A is first reduced to a small
+// triangular matrix with Householder reflections that are also applied to B, and then that
+// matrix gets an SVD. This is the same thing JacobiSVD does with its QR preconditioner, except
+// that the reduction happens in place so the only full-size matrices are the ones passed in.
+// Both A and B are overwritten.
+template<uint64 SGCount> static void SolveLeastSquaresSVD(typename SGSolverTypes<SGCount>::DesignMatrixMap& A, SampleMatrixMap& B,
+                                                          typename SGSolverTypes<SGCount>::Solution& X)
+{
+    typedef SGSolverTypes<SGCount> Types;
+
+    const int64 numRows = A.rows();
+    const int64 numCols = int64(SGCount);
+    const int64 numReflections = std::min(numRows, numCols);
+
+    for(int64 j = 0; j < numReflections; ++j)
+    {
+        const int64 remainingRows = numRows - j;
+        float tau = 0.0f;
+        float beta = 0.0f;
+        A.col(j).tail(remainingRows).makeHouseholderInPlace(tau, beta);
+        A(j, j) = beta;
+
+        auto essential = A.col(j).tail(remainingRows - 1);
+        for(int64 k = j + 1; k < numCols; ++k)
+            ApplyHouseholderToColumn(essential, tau, A.col(k).tail(remainingRows));
+        for(int64 c = 0; c < 3; ++c)
+            ApplyHouseholderToColumn(essential, tau, B.col(c).tail(remainingRows));
+    }
+
+    typename Types::TriangularFactor R = A.topRows(numReflections).template triangularView<Eigen::Upper>();
+    typename Types::TriangularRhs QtB = B.topRows(numReflections);
+
+    // JacobiSVD::solve() in this version of Eigen only skips singular values that are exactly zero,
+    // so the solve is done by hand with the same cutoff as the cached pseudo-inverse
+    typedef Eigen::JacobiSVD<typename Types::TriangularFactor> SVD;
+    SVD svd(R, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    typename SVD::SingularValuesType invSingularValues = svd.singularValues();
+    InvertSingularValues(invSingularValues, numRows, numCols);
+
+    const int64 rank = invSingularValues.size();
+    X = svd.matrixV().leftCols(rank) * invSingularValues.asDiagonal() * (svd.matrixU().leftCols(rank).transpose() * QtB);
+}
+
+template<uint64 SGCount> static void StoreAmplitudes(SGSolveParam& params, const typename SGSolverTypes<SGCount>::Solution& X)
+{
+    for(uint64 j = 0; j < SGCount; ++j)
+    {
+        params.OutSGs[j].Amplitude.x = X(j, 0);
+        params.OutSGs[j].Amplitude.y = X(j, 1);
+        params.OutSGs[j].Amplitude.z = X(j, 2);
+    }
+}
+
+uint64 SGSolveScratchSize(uint64 numSamples, uint64 numSGs)
+{
+    return ScratchArena::AllocationSize<float>(numSamples * 3) + ScratchArena::AllocationSize<float>(numSamples * numSGs);
+}
+
+// Solve for SG's using non-negative least squares
+template<uint64 SGCount> static void SolveNNLS(SGSolveParam& params)
+{
+    typedef SGSolverTypes<SGCount> Types;
+
+    Assert_(params.XSamples != nullptr);
+    Assert_(params.YSamples != nullptr);
+    Assert_(params.Scratch != nullptr);
+
+    ScratchArena& scratch = *params.Scratch;
+    ScratchScope scratchScope(scratch);
+
+    const int64 numSamples = int64(params.NumSamples);
+    SampleMatrixMap B(scratch.Allocate<float>(numSamples * 3), numSamples, 3);
+    BuildSampleMatrix(params, B);
+
+    // All three channels share the same normal matrix, only At * b differs
+    typename Types::NormalMatrix AtA;
+    typename Types::RhsMatrix AtB;
+    if(params.CacheFactorization)
+    {
+        SGSolverCacheEntryPtr cacheEntry = GetCachedFactorization(params, false);
+        AtA = cacheEntry->AtA;
+        ComputeAtB(typename Types::ConstDesignMatrixMap(cacheEntry->A.data(), numSamples, SGCount), B, AtB);
+    }
+    else
+    {
+        typename Types::DesignMatrixMap A(scratch.Allocate<float>(numSamples * SGCount), numSamples, SGCount);
+        BuildDesignMatrix(params, A);
+        ComputeNormalMatrix(A, AtA);
+        ComputeAtB(A, B, AtB);
+    }
+
+    typename Types::Solution X;
+    typename Types::Vector x;
+    for(int64 c = 0; c < 3; ++c)
+    {
+        SolveNNLSNormalEquations<SGCount>(AtA, AtB.col(c), x);
+        X.col(c) = x.template cast<float>();
+    }
+
+    StoreAmplitudes<SGCount>(params, X);
+}
+
 // Solve for SG's using singular value decomposition
-static void SolveSVD(SGSolveParam& params)
-{
-	// -- Linearly solve for the rgb channels one at a time
-	Eigen::MatrixXf Ar, Ag, Ab;
-
-	Ar.resize(params.NumSamples, params.NumSGs);
-	Ag.resize(params.NumSamples, params.NumSGs);
-	Ab.resize(params.NumSamples, params.NumSGs);
-	Eigen::VectorXf br(params.NumSamples);
-	Eigen::VectorXf bg(params.NumSamples);
-	Eigen::VectorXf bb(params.NumSamples);
-	for(uint32 i = 0; i < params.NumSamples; ++i)
-	{
-		// compute difference squared from actual observed data
-		for(uint32 j = 0; j < params.NumSGs; ++j)
-		{
-			float exponent = std::exp((Float3::Dot(params.XSamples[i], params.OutSGs[j].Axis) - 1.0f) *
-				                      params.OutSGs[j].Sharpness);
-			Ar(i, j) = exponent;
-			Ag(i, j) = exponent;
-			Ab(i, j) = exponent;
-		}
-		br(i) = params.YSamples[i].x;
-		bg(i) = params.YSamples[i].y;
-		bb(i) = params.YSamples[i].z;
-	}
-
-	Eigen::VectorXf rchan = Ar.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(br);
-	Eigen::VectorXf gchan = Ag.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(bg);
-	Eigen::VectorXf bchan = Ab.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(bb);
-
-	for(uint32 j = 0; j < params.NumSGs; ++j) {
-		params.OutSGs[j].Amplitude.x = rchan[j];
-		params.OutSGs[j].Amplitude.y = gchan[j];
-		params.OutSGs[j].Amplitude.z = bchan[j];
-	}
+template<uint64 SGCount> static void SolveSVD(SGSolveParam& params)
+{
+    typedef SGSolverTypes<SGCount> Types;
+
+    Assert_(params.XSamples != nullptr);
+    Assert_(params.YSamples != nullptr);
+    Assert_(params.Scratch != nullptr);
+
+    ScratchArena& scratch = *params.Scratch;
+    ScratchScope scratchScope(scratch);
+
+    const int64 numSamples = int64(params.NumSamples);
+    SampleMatrixMap B(scratch.Allocate<float>(numSamples * 3), numSamples, 3);
+    BuildSampleMatrix(params, B);
+
+    // Solve the rgb channels together as a single system with 3 right-hand sides
+    typename Types::Solution X;
+    if(params.CacheFactorization)
+    {
+        SGSolverCacheEntryPtr cacheEntry = GetCachedFactorization(params, true);
+        X.noalias() = cacheEntry->PseudoInverse.lazyProduct(B);
+    }
+    else
+    {
+        typename Types::DesignMatrixMap A(scratch.Allocate<float>(numSamples * SGCount), numSamples, SGCount);
+        BuildDesignMatrix(params, A);
+        SolveLeastSquaresSVD<SGCount>(A, B, X);
+    }
+
+    StoreAmplitudes<SGCount>(params, X);
 }
 
 // Project sample onto SGs
-void ProjectOntoSGs(const Float3& dir, const Float3& color, SG* outSGs, uint64 numSGs)
+template<uint64 SGCount> void ProjectOntoSGs(const Float3& dir, const Float3& color, const SGLobes& lobes, SG* outSGs)
 {
-    for(uint64 i = 0; i < numSGs; ++i)
-    {
-        SG sg1;
-        SG sg2;
-        sg1.Amplitude = outSGs[i].Amplitude;
-        sg1.Axis = outSGs[i].Axis;
-        sg1.Sharpness = outSGs[i].Sharpness;
-        sg2.Amplitude = color;
-        sg2.Axis = Float3::Normalize(dir);
+    float weights[SGLobes::MaxVectors * 4];
+    EvaluateSGLobeWeights<SGCount>(lobes, Float3::Normalize(dir), weights);
 
-        if(Float3::Dot(dir, sg1.Axis) > 0.0f)
+    for(uint64 i = 0; i < SGCount; ++i)
+    {
+        if(Float3::Dot(dir, outSGs[i].Axis) > 0.0f)
         {
-            float dot = Float3::Dot(sg1.Axis, sg2.Axis);
-            float factor = (dot - 1.0f) * sg1.Sharpness;
-            float wgt = exp(factor);
-            outSGs[i].Amplitude += sg2.Amplitude * wgt;
+            outSGs[i].Amplitude += color * weights[i];
             Assert_(outSGs[i].Amplitude.x >= 0.0f);
             Assert_(outSGs[i].Amplitude.y >= 0.0f);
             Assert_(outSGs[i].Amplitude.z >= 0.0f);
@@ -216,40 +670,39 @@ void ProjectOntoSGs(const Float3& dir, const Float3& color, SG* outSGs, uint64 n
 }
 
 // Do a projection of the colors onto the SG's
-static void SolveProjection(SGSolveParam& params)
+template<uint64 SGCount> static void SolveProjection(SGSolveParam& params)
 {
     Assert_(params.XSamples != nullptr);
     Assert_(params.YSamples != nullptr);
 
+    SGLobes lobes;
+    InitSGLobes(lobes, params.OutSGs, SGCount);
+
     // Project color samples onto the SGs
     for(uint32 i = 0; i < params.NumSamples; ++i)
-        ProjectOntoSGs(params.XSamples[i], params.YSamples[i], params.OutSGs, params.NumSGs);
+        ProjectOntoSGs<SGCount>(params.XSamples[i], params.YSamples[i], lobes, params.OutSGs);
 
     // Weight the samples by the monte carlo factor for uniformly sampling the hemisphere
     float monteCarloFactor = ((2.0f * Pi) / params.NumSamples);
-    for(uint32 i = 0; i < params.NumSGs; ++i)
+    for(uint32 i = 0; i < SGCount; ++i)
         params.OutSGs[i].Amplitude *= monteCarloFactor;
 }
 
 // Accumulates a single sample for computing a set of SG's using a running average. This technique and the code it's based
 // on was provided by Thomas Roughton in the following article: http://torust.me/rendering/irradiance-caching/spherical-gaussians/2018/09/21/spherical-gaussians.html
-void SGRunningAverage(const Float3& dir, const Float3& color, SG* outSGs, uint64 numSGs, float sampleIdx, float* lobeWeights, bool nonNegative)
+template<uint64 SGCount, bool NonNegative> void SGRunningAverage(const Float3& dir, const Float3& color, const SGLobes& lobes, SG* outSGs,
+                                                                 float sampleIdx, float* lobeWeights)
 {
 	float sampleWeightScale = 1.0f / (sampleIdx + 1);
 
-    float sampleLobeWeights[AppSettings::MaxSGCount] = { };
-    Float3 currentEstimate;
+    float sampleLobeWeights[SGLobes::MaxVectors * 4];
+    EvaluateSGLobeWeights<SGCount>(lobes, dir, sampleLobeWeights);
 
-    for(uint64 lobeIdx = 0; lobeIdx < numSGs; ++lobeIdx)
-    {
-        float dotProduct = Float3::Dot(outSGs[lobeIdx].Axis, dir);
-        float weight = exp(outSGs[lobeIdx].Sharpness * (dotProduct - 1.0f));
-		currentEstimate += outSGs[lobeIdx].Amplitude * weight;
-
-        sampleLobeWeights[lobeIdx] = weight;
-    }
+    Float3 currentEstimate;
+    for(uint64 lobeIdx = 0; lobeIdx < SGCount; ++lobeIdx)
+		currentEstimate += outSGs[lobeIdx].Amplitude * sampleLobeWeights[lobeIdx];
 
-    for(uint64 lobeIdx = 0; lobeIdx < numSGs; ++lobeIdx)
+    for(uint64 lobeIdx = 0; lobeIdx < SGCount; ++lobeIdx)
     {
         float weight = sampleLobeWeights[lobeIdx];
         if(weight == 0.0f)
@@ -267,7 +720,7 @@ void SGRunningAverage(const Float3& dir, const Float3& color, SG* outSGs, uint64
 
         outSGs[lobeIdx].Amplitude += (newValue - outSGs[lobeIdx].Amplitude) * sampleWeightScale;
 
-        if(nonNegative)
+        if(NonNegative)
         {
             outSGs[lobeIdx].Amplitude.x = Max(outSGs[lobeIdx].Amplitude.x, 0.0f);
             outSGs[lobeIdx].Amplitude.y = Max(outSGs[lobeIdx].Amplitude.y, 0.0f);
@@ -276,33 +729,152 @@ void SGRunningAverage(const Float3& dir, const Float3& color, SG* outSGs, uint64
     }
 }
 
-static void SolveRunningAverage(SGSolveParam& params, bool nonNegative)
+template<uint64 SGCount, bool NonNegative> static void SolveRunningAverage(SGSolveParam& params)
 {
     Assert_(params.XSamples != nullptr);
     Assert_(params.YSamples != nullptr);
 
-    float lobeWeights[AppSettings::MaxSGCount] = { };
+    float lobeWeights[SGCount] = { };
+
+    SGLobes lobes;
+    InitSGLobes(lobes, params.OutSGs, SGCount);
 
     // Project color samples onto the SGs
     for(uint32 i = 0; i < params.NumSamples; ++i)
-        SGRunningAverage(params.XSamples[i], params.YSamples[i], params.OutSGs, params.NumSGs, (float)i, lobeWeights, nonNegative);
+        SGRunningAverage<SGCount, NonNegative>(params.XSamples[i], params.YSamples[i], lobes, params.OutSGs, (float)i, lobeWeights);
 }
 
 // Solve the set of spherical gaussians based on input set of data
-void SolveSGs(SGSolveParam& params)
+template<uint64 SGCount, SolveModes SolveMode> void SolveSGs(SGSolveParam& params)
 {
-    Assert_(params.NumSGs <= uint64(AppSettings::MaxSGCount));
-    for(uint64 i = 0; i < params.NumSGs; ++i)
+    Assert_(params.NumSGs == SGCount);
+    for(uint64 i = 0; i < SGCount; ++i)
         params.OutSGs[i] = defaultInitialGuess[i];
 
-    if(AppSettings::SolveMode == SolveModes::NNLS)
-        SolveNNLS(params);
-    else if(AppSettings::SolveMode == SolveModes::SVD)
-        SolveSVD(params);
-    else if(AppSettings::SolveMode == SolveModes::RunningAverage)
-        SolveRunningAverage(params, false);
-    else if(AppSettings::SolveMode == SolveModes::RunningAverageNN)
-        SolveRunningAverage(params, true);
+    if(SolveMode == SolveModes::NNLS)
+        SolveNNLS<SGCount>(params);
+    else if(SolveMode == SolveModes::SVD)
+        SolveSVD<SGCount>(params);
+    else if(SolveMode == SolveModes::RunningAverage)
+        SolveRunningAverage<SGCount, false>(params);
+    else if(SolveMode == SolveModes::RunningAverageNN)
+        SolveRunningAverage<SGCount, true>(params);
+    else
+        SolveProjection<SGCount>(params);
+}
+
+// Relative size of the ridge term that's added to the diagonal of the normal matrix for streaming SVD solves
+static const double StreamingSolveRidge = 1e-6;
+
+void InitSGNormalEquations(SGNormalEquations& equations, uint64 numSGs)
+{
+    Assert_(numSGs <= uint64(AppSettings::MaxSGCount));
+    equations.NumSGs = numSGs;
+    equations.NumSamples = 0;
+
+    for(uint64 i = 0; i < numSGs; ++i)
+    {
+        for(uint64 j = 0; j < numSGs; ++j)
+            equations.AtA[i][j] = 0.0;
+        equations.Atb[i][0] = equations.Atb[i][1] = equations.Atb[i][2] = 0.0;
+    }
+}
+
+template<uint64 SGCount> void AccumulateSGNormalEquations(SGNormalEquations& equations, const Float3& dir, const Float3& color, const SGLobes& lobes)
+{
+    Assert_(equations.NumSGs == SGCount);
+
+    float weights[SGLobes::MaxVectors * 4];
+    EvaluateSGLobeWeights<SGCount>(lobes, dir, weights);
+
+    double row[SGCount];
+    for(uint64 j = 0; j < SGCount; ++j)
+        row[j] = weights[j];
+
+    // Only the upper triangle is accumulated, the solve fills in the rest
+    for(uint64 i = 0; i < SGCount; ++i)
+    {
+        for(uint64 j = i; j < SGCount; ++j)
+            equations.AtA[i][j] += row[i] * row[j];
+
+        equations.Atb[i][0] += row[i] * color.x;
+        equations.Atb[i][1] += row[i] * color.y;
+        equations.Atb[i][2] += row[i] * color.z;
+    }
+
+    ++equations.NumSamples;
+}
+
+template<uint64 SGCount> void SolveSGNormalEquations(const SGNormalEquations& equations, SG* outSGs, bool nonNegative)
+{
+    typedef SGSolverTypes<SGCount> Types;
+    Assert_(equations.NumSGs == SGCount);
+
+    typename Types::NormalMatrix AtA;
+    typename Types::RhsMatrix AtB;
+    for(uint64 i = 0; i < SGCount; ++i)
+    {
+        for(uint64 j = i; j < SGCount; ++j)
+        {
+            AtA(i, j) = equations.AtA[i][j];
+            AtA(j, i) = equations.AtA[i][j];
+        }
+
+        for(uint64 c = 0; c < 3; ++c)
+            AtB(i, c) = equations.Atb[i][c];
+    }
+
+    typename Types::RhsMatrix X;
+    if(nonNegative)
+    {
+        typename Types::Vector x;
+        for(int64 c = 0; c < 3; ++c)
+        {
+            SolveNNLSNormalEquations<SGCount>(AtA, AtB.col(c), x);
+            X.col(c) = x;
+        }
+    }
     else
-        SolveProjection(params);
-}
\ No newline at end of file
+    {
+        // Going through the normal equations squares the condition number of the design matrix, so
+        // for badly conditioned lobe sets this can't match a dense SVD solve of the full system.
+        // A small ridge term relative to the average diagonal keeps AtA positive definite, which
+        // lets Cholesky solve it stably at the cost of slightly damping near-degenerate lobes.
+        const double ridge = StreamingSolveRidge * AtA.trace() / double(SGCount);
+        if(ridge > 0.0)
+        {
+            AtA.diagonal().array() += ridge;
+            X = AtA.llt().solve(AtB);
+        }
+        else
+        {
+            X.setZero();
+        }
+    }
+
+    for(uint64 j = 0; j < SGCount; ++j)
+    {
+        outSGs[j].Amplitude.x = float(X(j, 0));
+        outSGs[j].Amplitude.y = float(X(j, 1));
+        outSGs[j].Amplitude.z = float(X(j, 2));
+    }
+}
+
+// The bakers only use these lobe counts, so the templates are instantiated here for each of them
+#define InstantiateSGFunctions_(SGCount)                                                                                    \
+    template void EvaluateSGLobeWeights<SGCount>(const SGLobes&, const Float3&, float*);                                   \
+    template void ProjectOntoSGs<SGCount>(const Float3&, const Float3&, const SGLobes&, SG*);                              \
+    template void SGRunningAverage<SGCount, false>(const Float3&, const Float3&, const SGLobes&, SG*, float, float*);      \
+    template void SGRunningAverage<SGCount, true>(const Float3&, const Float3&, const SGLobes&, SG*, float, float*);       \
+    template void AccumulateSGNormalEquations<SGCount>(SGNormalEquations&, const Float3&, const Float3&, const SGLobes&);  \
+    template void SolveSGNormalEquations<SGCount>(const SGNormalEquations&, SG*, bool);                                    \
+    template void SolveSGs<SGCount, SolveModes::Projection>(SGSolveParam&);                                                \
+    template void SolveSGs<SGCount, SolveModes::SVD>(SGSolveParam&);                                                       \
+    template void SolveSGs<SGCount, SolveModes::NNLS>(SGSolveParam&);                                                      \
+    template void SolveSGs<SGCount, SolveModes::RunningAverage>(SGSolveParam&);                                            \
+    template void SolveSGs<SGCount, SolveModes::RunningAverageNN>(SGSolveParam&);
+
+InstantiateSGFunctions_(5)
+InstantiateSGFunctions_(6)
+InstantiateSGFunctions_(9)
+InstantiateSGFunctions_(12)
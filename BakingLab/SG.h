@@ -13,6 +13,9 @@
 #include <PCH.h>
 #include <SF11_Math.h>
 
+#include "AppSettings.h"
+#include "ScratchArena.h"
+
 using namespace SampleFramework11;
 
 // SphericalGaussian(dir) := Amplitude * exp(Sharpness * (dot(Axis, Direction) - 1.0f))
@@ -90,6 +93,27 @@ inline Float3 SGIrradianceFitted(const SG& lightingLobe, const Float3& normal)
     return normalizedIrradiance * ApproximateSGIntegral(lightingLobe);
 }
 
+// Structure-of-arrays copy of the axes and sharpness for a set of SG lobes, which lets us
+// evaluate 4 lobes at a time with SSE. Unused lanes have zero sharpness.
+struct SGLobes
+{
+    static const uint64 MaxVectors = (AppSettings::MaxSGCount + 3) / 4;
+
+    __m128 AxisX[MaxVectors];
+    __m128 AxisY[MaxVectors];
+    __m128 AxisZ[MaxVectors];
+    __m128 Sharpness[MaxVectors];
+    uint64 NumSGs = 0;
+    uint64 NumVectors = 0;
+};
+
+void InitSGLobes(SGLobes& lobes, const SG* sgs, uint64 numSGs);
+
+// Computes exp(Sharpness * (dot(Axis, dir) - 1.0f)) for all lobes at once. outWeights needs
+// room for SGLobes::MaxVectors * 4 floats.
+void EvaluateSGLobeWeights(const SGLobes& lobes, const Float3& dir, float* outWeights);
+template<uint64 SGCount> void EvaluateSGLobeWeights(const SGLobes& lobes, const Float3& dir, float* outWeights);
+
 // Input parameters for the solve
 struct SGSolveParam
 {
@@ -101,6 +125,23 @@ struct SGSolveParam
     uint64 NumSGs = 0;                              // number of SG's we want to solve for
 
     SG* OutSGs;                                     // output of final SG's we solve for
+
+    // When set, the design matrix built from XSamples (and its SVD/normal-equation factorization)
+    // is cached and shared with any other solve that uses the exact same set of directions.
+    bool CacheFactorization = false;
+
+    // Working memory for the NNLS and SVD solves, which needs SGSolveScratchSize() bytes free
+    ScratchArena* Scratch = nullptr;
+};
+
+// Running sums of the normal equations (AtA * x = Atb) for a least squares fit of the SG amplitudes.
+// Samples are folded in one at a time, so the memory needed doesn't depend on the sample count.
+struct SGNormalEquations
+{
+    double AtA[AppSettings::MaxSGCount][AppSettings::MaxSGCount];
+    double Atb[AppSettings::MaxSGCount][3];
+    uint64 NumSGs = 0;
+    uint64 NumSamples = 0;
 };
 
 enum class SGDistribution : uint32
@@ -111,10 +152,28 @@ enum class SGDistribution : uint32
 
 void InitializeSGSolver(uint64 numSGs, SGDistribution distribution);
 const SG* InitialGuess();
+const SGLobes& InitialGuessLobes();
+
+// Frees all cached design-matrix factorizations
+void ClearSGSolverCache();
+
+// The functions below are templated on the number of SG's so that every matrix in the solve has a
+// fixed size. They're only instantiated for the lobe counts used by the bake modes (5, 6, 9 and 12).
 
 // Solve for k-number of SG's based on a hemisphere of radiance
-void SolveSGs(SGSolveParam& params);
+template<uint64 SGCount, SolveModes SolveMode> void SolveSGs(SGSolveParam& params);
+
+// Returns how much scratch memory SolveSGs can use for a given number of samples and SG's
+uint64 SGSolveScratchSize(uint64 numSamples, uint64 numSGs);
+
+template<uint64 SGCount> void ProjectOntoSGs(const Float3& dir, const Float3& color, const SGLobes& lobes, SG* outSGs);
+
+template<uint64 SGCount, bool NonNegative> void SGRunningAverage(const Float3& dir, const Float3& color, const SGLobes& lobes, SG* outSGs,
+                                                                 float sampleIdx, float* lobeWeights);
+
+void InitSGNormalEquations(SGNormalEquations& equations, uint64 numSGs);
 
-void ProjectOntoSGs(const Float3& dir, const Float3& color, SG* outSGs, uint64 numSGs);
+template<uint64 SGCount> void AccumulateSGNormalEquations(SGNormalEquations& equations, const Float3& dir, const Float3& color, const SGLobes& lobes);
 
-void SGRunningAverage(const Float3& dir, const Float3& color, SG* outSGs, uint64 numSGs, float sampleIdx, float* lobeWeights, bool nonNegative);
+// Solves the accumulated normal equations for the SG amplitudes, using NNLS if nonNegative is set
+template<uint64 SGCount> void SolveSGNormalEquations(const SGNormalEquations& equations, SG* outSGs, bool nonNegative);
\ No newline at end of file
@@ -0,0 +1,372 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "SceneCache.h"
+
+#include <FileIO.h>
+#include <Serialization.h>
+#include <MurmurHash.h>
+#include <Utility.h>
+#include <Timer.h>
+#include <Graphics/Textures.h>
+
+static const uint32 SceneCacheMagic = 0x48435342;   // "BSCH"
+
+// Bump this whenever the Assimp import flags, the mesh format or the BVH input change
+static const uint32 SceneCacheVersion = 1;
+
+static const wchar* SceneCacheDirectory = L"SceneCache";
+
+struct SceneCacheHeader
+{
+    uint32 Magic = SceneCacheMagic;
+    uint32 Version = SceneCacheVersion;
+    uint64 FileSize = 0;
+    uint64 SourceTimestamp = 0;
+    uint64 BVHInputOffset = 0;
+};
+
+// The textures that the cached materials were loaded from, along with their timestamps. A
+// timestamp of 0 means that the file didn't exist, and the material used a default texture.
+struct SceneCacheDependencies
+{
+    std::vector<std::wstring> FilePaths;
+    std::vector<uint64> Timestamps;
+
+    void Add(const std::wstring& directory, const std::wstring& fileName)
+    {
+        if(fileName.length() <= 1)
+            return;
+
+        const std::wstring filePath = directory + fileName;
+        FilePaths.push_back(filePath);
+        Timestamps.push_back(FileExists(filePath.c_str()) ? GetFileTimestamp(filePath.c_str()) : 0);
+    }
+
+    bool UpToDate() const
+    {
+        for(uint64 i = 0; i < FilePaths.size(); ++i)
+        {
+            const wchar* filePath = FilePaths[i].c_str();
+            const uint64 timestamp = FileExists(filePath) ? GetFileTimestamp(filePath) : 0;
+            if(timestamp != Timestamps[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, FilePaths);
+        SerializeRawVector(serializer, Timestamps);
+    }
+};
+
+static std::wstring SceneCachePath(const std::wstring& scenePath)
+{
+    const Hash pathHash = GenerateHash(scenePath.data(), int(scenePath.length() * sizeof(wchar)), SceneCacheVersion);
+    return std::wstring(SceneCacheDirectory) + L"\\" + pathHash.ToString() + L".scenecache";
+}
+
+// Reads and validates the header at the start of a cache file
+static bool ReadHeader(FileReadSerializer& serializer, SceneCacheHeader& header)
+{
+    const uint64 fileSize = serializer.Size();
+    if(fileSize < sizeof(SceneCacheHeader))
+        return false;
+
+    SerializeRawArray(serializer, &header, 1);
+    return header.Magic == SceneCacheMagic && header.Version == SceneCacheVersion &&
+           header.FileSize == fileSize && header.BVHInputOffset <= fileSize;
+}
+
+void SceneCache::Initialize(ID3D11Device* device, const wchar* scenePath_, Model& model, bool forceSRGB)
+{
+    Assert_(FileExists(scenePath_));
+
+    scenePath = scenePath_;
+    cachePath = SceneCachePath(scenePath);
+    sourceTimestamp = GetFileTimestamp(scenePath_);
+    valid = false;
+
+    if(LoadModel(device, model, forceSRGB))
+    {
+        valid = true;
+        return;
+    }
+
+    model.CreateWithAssimp(device, scenePath_, forceSRGB);
+
+    try
+    {
+        WriteCacheFile(device, model);
+        valid = true;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to write scene cache for %ls: %ls", scenePath.c_str(), e.GetMessage().c_str());
+    }
+}
+
+bool SceneCache::LoadModel(ID3D11Device* device, Model& model, bool forceSRGB)
+{
+    if(FileExists(cachePath.c_str()) == false)
+        return false;
+
+    try
+    {
+        Timer timer;
+
+        FileReadSerializer serializer(cachePath.c_str());
+
+        SceneCacheHeader header;
+        if(ReadHeader(serializer, header) == false || header.SourceTimestamp != sourceTimestamp)
+            return false;
+
+        SceneCacheDependencies dependencies;
+        SerializeItem(serializer, dependencies);
+        if(dependencies.UpToDate() == false)
+            return false;
+
+        model.Serialize(serializer, device, forceSRGB);
+        if(serializer.Offset() != header.BVHInputOffset)
+            throw Exception(L"The model data doesn't match the size stored in the header");
+
+        timer.Update();
+        PrintStringW(L"Loaded %ls from the scene cache (%fs)", scenePath.c_str(), timer.DeltaSecondsF());
+
+        return true;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to load scene cache for %ls: %ls", scenePath.c_str(), e.GetMessage().c_str());
+
+        // Start over with an empty model so that the import doesn't append to a partial one
+        model = Model();
+        return false;
+    }
+}
+
+void SceneCache::WriteCacheFile(ID3D11Device* device, Model& model)
+{
+    BVHData bvhInput;
+    ExtractBVHInput(model, device, bvhInput);
+
+    const std::wstring directory = GetDirectoryFromFilePath(scenePath.c_str());
+    SceneCacheDependencies dependencies;
+    for(uint64 i = 0; i < model.Materials().size(); ++i)
+    {
+        const MeshMaterial& material = model.Materials()[i];
+        dependencies.Add(directory, material.DiffuseMapName);
+        dependencies.Add(directory, material.NormalMapName);
+        dependencies.Add(directory, material.RoughnessMapName);
+        dependencies.Add(directory, material.MetallicMapName);
+    }
+
+    // Figure out where everything goes before writing, so that the header can go first
+    SceneCacheHeader header;
+    header.SourceTimestamp = sourceTimestamp;
+
+    ComputeSizeSerializer sizeSerializer;
+    SerializeRawArray(sizeSerializer, &header, 1);
+    SerializeItem(sizeSerializer, dependencies);
+    model.Serialize(sizeSerializer, device);
+    header.BVHInputOffset = sizeSerializer.Size();
+    bvhInput.SerializeInput(sizeSerializer);
+    header.FileSize = sizeSerializer.Size();
+
+    if(DirectoryExists(SceneCacheDirectory) == false)
+        Win32Call(CreateDirectory(SceneCacheDirectory, nullptr));
+
+    // Write to a temporary file first, so that a partially-written cache never gets loaded
+    const std::wstring tempPath = cachePath + L".tmp";
+    try
+    {
+        {
+            FileWriteSerializer serializer(tempPath.c_str());
+            SerializeRawArray(serializer, &header, 1);
+            SerializeItem(serializer, dependencies);
+            model.Serialize(serializer, device);
+            bvhInput.SerializeInput(serializer);
+            serializer.Close();
+        }
+
+        Win32Call(MoveFileEx(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING));
+    }
+    catch(Exception e)
+    {
+        DeleteFile(tempPath.c_str());
+        throw;
+    }
+}
+
+bool SceneCache::LoadBVHInput(BVHData& bvhData) const
+{
+    if(valid == false || FileExists(cachePath.c_str()) == false)
+        return false;
+
+    try
+    {
+        FileReadSerializer serializer(cachePath.c_str());
+
+        SceneCacheHeader header;
+        if(ReadHeader(serializer, header) == false || header.SourceTimestamp != sourceTimestamp)
+            return false;
+
+        serializer.Seek(header.BVHInputOffset);
+        bvhData.SerializeInput(serializer);
+
+        return true;
+    }
+    catch(Exception e)
+    {
+        PrintStringW(L"Failed to load BVH data from the scene cache for %ls: %ls", scenePath.c_str(), e.GetMessage().c_str());
+        return false;
+    }
+}
+
+// Where a material map comes from, and where its decoded texels go
+struct MaterialMapSource
+{
+    const std::wstring* FileName;
+    ID3D11ShaderResourceView* SRV;
+    const wchar* DefaultFileName;
+    TextureData<UByte4N>* Output;
+};
+
+// Returns the file that Model::LoadMaterialResources loaded a material map from
+static std::wstring MaterialMapFilePath(const std::wstring& directory, const std::wstring& fileName,
+                                        const wchar* defaultFileName)
+{
+    const std::wstring filePath = directory + fileName;
+    if(fileName.length() > 1 && FileExists(filePath.c_str()))
+        return filePath;
+
+    return std::wstring(L"..\\Content\\Textures\\") + defaultFileName;
+}
+
+void ExtractBVHInput(const Model& model, ID3D11Device* device, BVHData& bvhData)
+{
+    // Count the total number of vertices and triangles
+    uint32 totalNumVertices = 0;
+    uint32 totalNumTriangles = 0;
+    for(uint64 i = 0; i < model.Meshes().size(); ++i)
+    {
+        const Mesh& mesh = model.Meshes()[i];
+        Assert_(mesh.VertexStride() == sizeof(Vertex));
+        totalNumVertices += mesh.NumVertices();
+        totalNumTriangles += mesh.NumIndices() / 3;
+    }
+
+    bvhData.Triangles.resize(totalNumTriangles);
+    bvhData.Vertices.resize(totalNumVertices);
+    bvhData.MaterialIndices.resize(totalNumTriangles);
+
+    uint32 vtxOffset = 0;
+    uint32 triOffset = 0;
+
+    // Add the data for each mesh
+    for(uint64 meshIdx = 0; meshIdx < model.Meshes().size(); ++meshIdx)
+    {
+        const Mesh& mesh = model.Meshes()[meshIdx];
+        const Vertex* vertexData = reinterpret_cast<const Vertex*>(mesh.Vertices());
+        const uint8* indexData = mesh.Indices();
+        const uint32 numVertices = mesh.NumVertices();
+        const uint32 numIndices = mesh.NumIndices();
+        const uint32 indexSize = mesh.IndexSize();
+
+        // Prepare the triangles
+        const uint32 numTriangles = numIndices / 3;
+        for(uint64 partIdx = 0; partIdx < mesh.MeshParts().size(); ++partIdx)
+        {
+            const MeshPart& meshPart = mesh.MeshParts()[partIdx];
+            const uint32 startTriangle = meshPart.IndexStart / 3;
+            const uint32 endTriangle = (meshPart.IndexStart + meshPart.IndexCount) / 3;
+            for(uint32 i = startTriangle; i < endTriangle; ++i)
+            {
+                const uint32 idx0 = GetIndex(indexData, i * 3 + 0, indexSize) + vtxOffset;
+                const uint32 idx1 = GetIndex(indexData, i * 3 + 1, indexSize) + vtxOffset;
+                const uint32 idx2 = GetIndex(indexData, i * 3 + 2, indexSize) + vtxOffset;
+
+                bvhData.Triangles[i + triOffset] = Uint3(idx0, idx1, idx2);
+                bvhData.MaterialIndices[i + triOffset] = meshPart.MaterialIdx;
+            }
+        }
+
+        // Prepare the vertices
+        memcpy(bvhData.Vertices.data() + vtxOffset, vertexData, numVertices * sizeof(Vertex));
+
+        triOffset += numTriangles;
+        vtxOffset += numVertices;
+    }
+
+    // Load the material texture data
+    const uint64 numMaterials = model.Materials().size();
+    bvhData.MaterialDiffuseMaps.resize(numMaterials);
+    bvhData.MaterialNormalMaps.resize(numMaterials);
+    bvhData.MaterialRoughnessMaps.resize(numMaterials);
+    bvhData.MaterialMetallicMaps.resize(numMaterials);
+
+    // DDS maps get decoded on the CPU, everything else goes through GetTextureData
+    std::vector<DDSTextureDecode> ddsDecodes;
+    std::vector<ID3D11ShaderResourceView*> ddsDecodeSRVs;
+    std::vector<ID3D11ShaderResourceView*> gpuDecodeSRVs;
+    std::vector<TextureData<UByte4N>*> gpuDecodeOutputs;
+    for(uint64 i = 0; i < numMaterials; ++i)
+    {
+        const MeshMaterial& material = model.Materials()[i];
+        const MaterialMapSource sources[] =
+        {
+            { &material.DiffuseMapName, material.DiffuseMap, L"Default.dds", &bvhData.MaterialDiffuseMaps[i] },
+            { &material.NormalMapName, material.NormalMap, L"DefaultNormalMap.dds", &bvhData.MaterialNormalMaps[i] },
+            { &material.RoughnessMapName, material.RoughnessMap, L"DefaultRoughness.dds", &bvhData.MaterialRoughnessMaps[i] },
+            { &material.MetallicMapName, material.MetallicMap, L"DefaultBlack.dds", &bvhData.MaterialMetallicMaps[i] },
+        };
+
+        for(uint64 mapIdx = 0; mapIdx < ArraySize_(sources); ++mapIdx)
+        {
+            const MaterialMapSource& source = sources[mapIdx];
+            const std::wstring filePath = MaterialMapFilePath(model.FileDirectory(), *source.FileName, source.DefaultFileName);
+            const std::wstring extension = GetFileExtension(filePath.c_str());
+            if(extension == L"DDS" || extension == L"dds")
+            {
+                D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+                source.SRV->GetDesc(&srvDesc);
+
+                DDSTextureDecode decode;
+                decode.FilePath = filePath;
+                decode.ForceSRGB = IsSRGB(srvDesc.Format);
+                decode.Output = source.Output;
+                ddsDecodes.push_back(decode);
+                ddsDecodeSRVs.push_back(source.SRV);
+            }
+            else
+            {
+                gpuDecodeSRVs.push_back(source.SRV);
+                gpuDecodeOutputs.push_back(source.Output);
+            }
+        }
+    }
+
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    const uint64 numDecodeThreads = std::max<uint64>(sysInfo.dwNumberOfProcessors, 1);
+    DecodeDDSTextures(ddsDecodes.data(), ddsDecodes.size(), numDecodeThreads);
+
+    for(uint64 i = 0; i < ddsDecodes.size(); ++i)
+        if(ddsDecodes[i].Decoded == false)
+            GetTextureData(device, ddsDecodeSRVs[i], *ddsDecodes[i].Output);
+
+    for(uint64 i = 0; i < gpuDecodeSRVs.size(); ++i)
+        GetTextureData(device, gpuDecodeSRVs[i], *gpuDecodeOutputs[i]);
+}
@@ -0,0 +1,51 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+#include <Graphics/Model.h>
+
+#include "PathTracer.h"
+
+using namespace SampleFramework11;
+
+// Caches everything that's generated from a scene file at startup: the meshes and materials
+// produced by the Assimp import, plus the flattened geometry and decoded material texels that the
+// BVH gets built from. The cache file is named after a hash of the scene path, and is thrown out
+// whenever the timestamp of the scene file or any of its textures no longer matches. Loading
+// goes through a memory-mapped view of the file, so there are no per-item reads.
+class SceneCache
+{
+
+public:
+
+    // Loads the model from the cache file if it's up to date. Otherwise the scene gets imported
+    // with Assimp and a new cache file is written.
+    void Initialize(ID3D11Device* device, const wchar* scenePath, Model& model, bool forceSRGB);
+
+    // Reads the flattened geometry and material texels into the BVH data. Returns false if there's
+    // no usable cache file, in which case they need to be extracted from the model instead.
+    bool LoadBVHInput(BVHData& bvhData) const;
+
+private:
+
+    bool LoadModel(ID3D11Device* device, Model& model, bool forceSRGB);
+    void WriteCacheFile(ID3D11Device* device, Model& model);
+
+    std::wstring scenePath;
+    std::wstring cachePath;
+    uint64 sourceTimestamp = 0;
+    bool valid = false;
+};
+
+// Flattens the meshes of a model into the triangle, vertex and material index arrays of the BVH
+// data, and decodes the material textures so that the path tracer can sample them
+void ExtractBVHInput(const Model& model, ID3D11Device* device, BVHData& bvhData);
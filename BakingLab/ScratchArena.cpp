@@ -0,0 +1,38 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "ScratchArena.h"
+
+void ScratchArena::Init(uint64 newCapacity)
+{
+    Shutdown();
+
+    capacity = newCapacity;
+    if(capacity > 0)
+    {
+        memory = reinterpret_cast<uint8*>(_aligned_malloc(capacity, Alignment));
+        if(memory == nullptr)
+            throw Exception(L"Failed to allocate scratch memory");
+    }
+}
+
+void ScratchArena::Shutdown()
+{
+    if(memory != nullptr)
+    {
+        _aligned_free(memory);
+        memory = nullptr;
+    }
+
+    capacity = 0;
+    offset = 0;
+}
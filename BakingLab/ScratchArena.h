@@ -0,0 +1,87 @@
+//=================================================================================================
+//
+//  Baking Lab
+//  by MJP and David Neubelt
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+
+// Bump allocator for temporary per-thread memory. Allocating just moves an offset forward, and
+// everything allocated after a mark gets released at once by rewinding back to it. Each bake
+// thread owns its own arena, so there's no locking and no trips through the heap while baking.
+class ScratchArena
+{
+
+public:
+
+    static const uint64 Alignment = 16;
+
+    ScratchArena() {}
+    ~ScratchArena() { Shutdown(); }
+
+    void Init(uint64 capacity);
+    void Shutdown();
+
+    uint64 Capacity() const { return capacity; }
+    uint64 Mark() const { return offset; }
+
+    void Reset(uint64 mark = 0)
+    {
+        Assert_(mark <= offset);
+        offset = mark;
+    }
+
+    void* Allocate(uint64 size)
+    {
+        const uint64 start = (offset + (Alignment - 1)) & ~(Alignment - 1);
+        if(start + size > capacity)
+            throw Exception(L"Ran out of scratch memory");
+
+        offset = start + size;
+        return memory + start;
+    }
+
+    template<typename T> T* Allocate(uint64 count)
+    {
+        return reinterpret_cast<T*>(Allocate(count * sizeof(T)));
+    }
+
+    // Returns how many bytes an allocation can take up, including its alignment padding
+    template<typename T> static uint64 AllocationSize(uint64 count)
+    {
+        return count * sizeof(T) + (Alignment - 1);
+    }
+
+private:
+
+    ScratchArena(const ScratchArena& other) {}
+    ScratchArena& operator=(const ScratchArena& other) { return *this; }
+
+    uint8* memory = nullptr;
+    uint64 capacity = 0;
+    uint64 offset = 0;
+};
+
+// Rewinds an arena back to where it was when the scope was entered
+class ScratchScope
+{
+
+public:
+
+    explicit ScratchScope(ScratchArena& arena) : arena(arena), mark(arena.Mark()) {}
+    ~ScratchScope() { arena.Reset(mark); }
+
+private:
+
+    ScratchScope(const ScratchScope& other);
+    ScratchScope& operator=(const ScratchScope& other);
+
+    ScratchArena& arena;
+    uint64 mark;
+};
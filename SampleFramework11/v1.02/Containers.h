@@ -89,6 +89,12 @@ public:
         for(uint64 i = 0; i < size; ++i)
             data[i] = value;
     }
+
+    void Swap(FixedArray& other)
+    {
+        std::swap(size, other.size);
+        std::swap(data, other.data);
+    }
 };
 
 template<typename T> class FixedList
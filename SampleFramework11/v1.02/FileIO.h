@@ -59,6 +59,9 @@ public:
     void Read(uint64 size, void* data) const;
     void Write(uint64 size, const void* data) const;
 
+    // Moves the file pointer to an offset from the start of the file
+    void Seek(uint64 offset) const;
+
     template<typename T> void Read(T& data) const;
     template<typename T> void Write(const T& data) const;
 
@@ -66,6 +69,36 @@ public:
     uint64 Size() const;
 };
 
+// Read-only view of an entire file, mapped into the address space of the process
+class MemoryMappedFile
+{
+
+private:
+
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+    const uint8* data;
+    uint64 size;
+
+    MemoryMappedFile(const MemoryMappedFile&);
+    MemoryMappedFile& operator=(const MemoryMappedFile&);
+
+public:
+
+    // Lifetime
+    MemoryMappedFile();
+    explicit MemoryMappedFile(const wchar* filePath);
+    ~MemoryMappedFile();
+
+    // Explicit Open and close
+    void Open(const wchar* filePath);
+    void Close();
+
+    // Accessors
+    const uint8* Data() const { return data; }
+    uint64 Size() const { return size; }
+};
+
 // == File ========================================================================================
 
 template<typename T> void File::Read(T& data) const
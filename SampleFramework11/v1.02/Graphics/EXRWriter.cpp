@@ -0,0 +1,374 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "EXRWriter.h"
+#include "..\\Exceptions.h"
+#include "..\\SF11_Math.h"
+#include "..\\TinyEXR.h"
+
+namespace SampleFramework11
+{
+
+static const int32 EXRMagic = 20000630;
+static const int32 EXRVersion = 2;
+static const int32 EXRTiledFlag = 0x200;
+static const int32 EXRMultiPartFlag = 0x1000;
+
+static const int32 EXRPixelTypeHalf = 1;
+static const uint8 EXRCompressionZIP = 3;
+static const uint8 EXRLineOrderIncreasingY = 0;
+static const uint8 EXRLevelModeOneLevel = 0;
+
+// Tiles that get compressed before the main thread writes them out, which bounds how much
+// compressed data is held in memory at once
+static const uint64 EXRTilesPerBatch = 512;
+
+// Channels need to be sorted by name, which puts alpha first
+struct EXRChannel
+{
+    const char* Name;
+    uint32 Component;
+};
+
+static const EXRChannel EXRChannels[] = { { "A", 3 }, { "B", 2 }, { "G", 1 }, { "R", 0 } };
+
+static const EXRChannel* FirstEXRChannel(uint32 numChannels)
+{
+    Assert_(numChannels == 3 || numChannels == 4);
+    return EXRChannels + (4 - numChannels);
+}
+
+// == Header writing ==============================================================================
+
+static void AppendBytes(std::vector<uint8>& data, const void* bytes, uint64 size)
+{
+    const uint8* src = reinterpret_cast<const uint8*>(bytes);
+    data.insert(data.end(), src, src + size);
+}
+
+template<typename T> static void AppendValue(std::vector<uint8>& data, const T& value)
+{
+    AppendBytes(data, &value, sizeof(T));
+}
+
+static void AppendString(std::vector<uint8>& data, const char* str)
+{
+    AppendBytes(data, str, strlen(str) + 1);
+}
+
+static void AppendAttribute(std::vector<uint8>& data, const char* name, const char* type,
+                            const void* value, uint64 size)
+{
+    AppendString(data, name);
+    AppendString(data, type);
+    AppendValue(data, int32(size));
+    AppendBytes(data, value, size);
+}
+
+template<typename T> static void AppendAttribute(std::vector<uint8>& data, const char* name,
+                                                 const char* type, const T& value)
+{
+    AppendAttribute(data, name, type, &value, sizeof(T));
+}
+
+static void AppendPartHeader(std::vector<uint8>& data, const EXRPartDesc& part, bool multiPart,
+                             uint64 numChunks)
+{
+    std::vector<uint8> channelList;
+    const EXRChannel* channels = FirstEXRChannel(part.NumChannels);
+    for(uint32 i = 0; i < part.NumChannels; ++i)
+    {
+        AppendString(channelList, channels[i].Name);
+        AppendValue(channelList, EXRPixelTypeHalf);
+        AppendValue(channelList, uint32(0));            // pLinear + reserved
+        AppendValue(channelList, int32(1));             // xSampling
+        AppendValue(channelList, int32(1));             // ySampling
+    }
+    AppendValue(channelList, uint8(0));
+    AppendAttribute(data, "channels", "chlist", channelList.data(), channelList.size());
+
+    AppendAttribute(data, "compression", "compression", EXRCompressionZIP);
+
+    const int32 window[4] = { 0, 0, int32(part.Width) - 1, int32(part.Height) - 1 };
+    AppendAttribute(data, "dataWindow", "box2i", window);
+    AppendAttribute(data, "displayWindow", "box2i", window);
+    AppendAttribute(data, "lineOrder", "lineOrder", EXRLineOrderIncreasingY);
+    AppendAttribute(data, "pixelAspectRatio", "float", 1.0f);
+
+    const float windowCenter[2] = { 0.0f, 0.0f };
+    AppendAttribute(data, "screenWindowCenter", "v2f", windowCenter);
+    AppendAttribute(data, "screenWindowWidth", "float", 1.0f);
+
+    uint8 tileDesc[9];
+    const uint32 tileSize = EXRWriter::TileSize;
+    memcpy(tileDesc + 0, &tileSize, sizeof(uint32));
+    memcpy(tileDesc + 4, &tileSize, sizeof(uint32));
+    tileDesc[8] = EXRLevelModeOneLevel;
+    AppendAttribute(data, "tiles", "tiledesc", tileDesc);
+
+    if(multiPart)
+    {
+        AppendAttribute(data, "name", "string", part.Name.c_str(), part.Name.length());
+        AppendAttribute(data, "type", "string", "tiledimage", strlen("tiledimage"));
+        AppendAttribute(data, "chunkCount", "int", int32(numChunks));
+    }
+
+    AppendValue(data, uint8(0));
+}
+
+static uint64 NumEXRTiles(const EXRPartDesc& part, uint64& numTilesX)
+{
+    const uint64 tileSize = EXRWriter::TileSize;
+    numTilesX = (part.Width + tileSize - 1) / tileSize;
+    const uint64 numTilesY = (part.Height + tileSize - 1) / tileSize;
+    return numTilesX * numTilesY;
+}
+
+// == Tile compression ============================================================================
+
+struct EXRTileBatch
+{
+    const uint8* Texels = nullptr;
+    uint64 RowPitch = 0;
+    bool FloatTexels = false;
+    const EXRPartDesc* Part = nullptr;
+    int32 PartNumber = -1;              // -1 for single-part files, which don't store it
+    uint64 NumTilesX = 0;
+    uint64 FirstTile = 0;
+    std::vector<std::vector<uint8>> Chunks;
+    volatile int64 CurrTile = 0;
+};
+
+// Converts a tile to FP16 scanlines with the channels split apart, and compresses it into a
+// complete chunk that's ready to be written to the file
+static void EncodeTile(EXRTileBatch& batch, uint64 batchTileIdx)
+{
+    const EXRPartDesc& part = *batch.Part;
+    const uint64 tileIdx = batch.FirstTile + batchTileIdx;
+    const uint32 tileX = uint32(tileIdx % batch.NumTilesX);
+    const uint32 tileY = uint32(tileIdx / batch.NumTilesX);
+    const uint32 tileSize = EXRWriter::TileSize;
+    const uint32 startX = tileX * tileSize;
+    const uint32 startY = tileY * tileSize;
+    const uint32 tileWidth = std::min(tileSize, part.Width - startX);
+    const uint32 tileHeight = std::min(tileSize, part.Height - startY);
+
+    const EXRChannel* channels = FirstEXRChannel(part.NumChannels);
+    std::vector<uint16> pixels(tileWidth * tileHeight * part.NumChannels);
+    uint16* dst = pixels.data();
+
+    Half4 rowTexels[EXRWriter::TileSize];
+    for(uint32 y = 0; y < tileHeight; ++y)
+    {
+        const uint8* srcRow = batch.Texels + (startY + y) * batch.RowPitch;
+        if(batch.FloatTexels)
+        {
+            const Float4* src = reinterpret_cast<const Float4*>(srcRow) + startX;
+            for(uint32 x = 0; x < tileWidth; ++x)
+                rowTexels[x] = Half4(src[x]);
+        }
+        else
+            memcpy(rowTexels, reinterpret_cast<const Half4*>(srcRow) + startX, tileWidth * sizeof(Half4));
+
+        for(uint32 c = 0; c < part.NumChannels; ++c)
+        {
+            const uint32 component = channels[c].Component;
+            for(uint32 x = 0; x < tileWidth; ++x)
+                *dst++ = (&rowTexels[x].x)[component];
+        }
+    }
+
+    const unsigned long rawSize = static_cast<unsigned long>(pixels.size() * sizeof(uint16));
+    std::vector<uint8> compressed(size_t(CompressBoundEXRZip(rawSize)));
+    const uint64 compressedSize = CompressEXRZip(compressed.data(), reinterpret_cast<const uint8*>(pixels.data()), rawSize);
+
+    // Chunks that don't get any smaller are stored uncompressed, which readers detect by the size
+    const bool storeRaw = compressedSize >= rawSize;
+    const uint8* data = storeRaw ? reinterpret_cast<const uint8*>(pixels.data()) : compressed.data();
+    const int32 dataSize = int32(storeRaw ? rawSize : compressedSize);
+
+    std::vector<uint8>& chunk = batch.Chunks[batchTileIdx];
+    chunk.clear();
+    if(batch.PartNumber >= 0)
+        AppendValue(chunk, batch.PartNumber);
+    AppendValue(chunk, int32(tileX));
+    AppendValue(chunk, int32(tileY));
+    AppendValue(chunk, int32(0));       // level x
+    AppendValue(chunk, int32(0));       // level y
+    AppendValue(chunk, dataSize);
+    AppendBytes(chunk, data, dataSize);
+}
+
+static uint32 __stdcall EncodeTileThread(void* data)
+{
+    EXRTileBatch* batch = reinterpret_cast<EXRTileBatch*>(data);
+    const int64 numTiles = int64(batch->Chunks.size());
+
+    while(true)
+    {
+        const int64 tileIdx = InterlockedIncrement64(&batch->CurrTile) - 1;
+        if(tileIdx >= numTiles)
+            break;
+
+        EncodeTile(*batch, uint64(tileIdx));
+    }
+
+    return 0;
+}
+
+// == EXRWriter ===================================================================================
+
+EXRWriter::EXRWriter()
+{
+}
+
+EXRWriter::~EXRWriter()
+{
+}
+
+void EXRWriter::Open(const wchar* filePath_, const EXRPartDesc* parts_, uint64 numParts, uint64 numThreads_)
+{
+    Assert_(open == false);
+    Assert_(numParts > 0);
+
+    filePath = filePath_;
+    parts.assign(parts_, parts_ + numParts);
+    chunkOffsets.resize(numParts);
+    currPart = 0;
+
+    numThreads = numThreads_;
+    if(numThreads == 0)
+    {
+        SYSTEM_INFO sysInfo;
+        GetSystemInfo(&sysInfo);
+        numThreads = std::max<uint64>(sysInfo.dwNumberOfProcessors, 1);
+    }
+
+    const bool multiPart = numParts > 1;
+    std::vector<uint8> header;
+    AppendValue(header, EXRMagic);
+    AppendValue(header, EXRVersion | (multiPart ? EXRMultiPartFlag : EXRTiledFlag));
+
+    uint64 totalNumChunks = 0;
+    for(uint64 i = 0; i < numParts; ++i)
+    {
+        EXRPartDesc& part = parts[i];
+        Assert_(part.Width > 0 && part.Height > 0);
+        if(part.NumChannels != 3 && part.NumChannels != 4)
+            throw Exception(L"EXR parts need to have either 3 or 4 channels");
+
+        if(multiPart && part.Name.length() == 0)
+            part.Name = "Part" + ToAnsiString(i);
+
+        uint64 numTilesX = 0;
+        const uint64 numChunks = NumEXRTiles(part, numTilesX);
+        chunkOffsets[i].resize(numChunks, 0);
+        totalNumChunks += numChunks;
+
+        AppendPartHeader(header, part, multiPart, numChunks);
+    }
+
+    // An empty header ends the list of parts
+    if(multiPart)
+        AppendValue(header, uint8(0));
+
+    file.Open(filePath.c_str(), FileOpenMode::Write);
+    file.Write(header.size(), header.data());
+
+    // The offset tables get filled in once all of the chunks have been written
+    offsetTablesStart = header.size();
+    const std::vector<uint64> emptyOffsets(size_t(totalNumChunks), 0);
+    file.Write(emptyOffsets.size() * sizeof(uint64), emptyOffsets.data());
+    currOffset = offsetTablesStart + emptyOffsets.size() * sizeof(uint64);
+
+    open = true;
+}
+
+void EXRWriter::WritePart(const Half4* texels, uint64 rowPitch)
+{
+    WritePart(texels, rowPitch, false);
+}
+
+void EXRWriter::WritePart(const Float4* texels, uint64 rowPitch)
+{
+    WritePart(texels, rowPitch, true);
+}
+
+void EXRWriter::WritePart(const void* texels, uint64 rowPitch, bool floatTexels)
+{
+    Assert_(open);
+    Assert_(currPart < parts.size());
+    Assert_(texels != nullptr);
+
+    const EXRPartDesc& part = parts[currPart];
+    Assert_(rowPitch >= part.Width * (floatTexels ? sizeof(Float4) : sizeof(Half4)));
+
+    EXRTileBatch batch;
+    batch.Texels = reinterpret_cast<const uint8*>(texels);
+    batch.RowPitch = rowPitch;
+    batch.FloatTexels = floatTexels;
+    batch.Part = &part;
+    batch.PartNumber = parts.size() > 1 ? int32(currPart) : -1;
+
+    std::vector<uint64>& offsets = chunkOffsets[currPart];
+    const uint64 numTiles = NumEXRTiles(part, batch.NumTilesX);
+    for(uint64 firstTile = 0; firstTile < numTiles; firstTile += EXRTilesPerBatch)
+    {
+        batch.FirstTile = firstTile;
+        batch.Chunks.resize(size_t(std::min(EXRTilesPerBatch, numTiles - firstTile)));
+        batch.CurrTile = 0;
+
+        const uint64 numBatchThreads = std::min<uint64>(numThreads, batch.Chunks.size());
+        std::vector<HANDLE> threads(numBatchThreads);
+        for(uint64 i = 0; i < numBatchThreads; ++i)
+        {
+            threads[i] = HANDLE(_beginthreadex(nullptr, 0, EncodeTileThread, &batch, 0, nullptr));
+            if(threads[i] == 0)
+            {
+                AssertFail_("Failed to create thread for EXR compression");
+                throw Exception(L"Failed to create thread for EXR compression");
+            }
+        }
+
+        for(uint64 i = 0; i < numBatchThreads; ++i)
+        {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+
+        // Write out the chunks in order, so that the tiles end up in increasing-Y order
+        for(uint64 i = 0; i < batch.Chunks.size(); ++i)
+        {
+            const std::vector<uint8>& chunk = batch.Chunks[i];
+            file.Write(chunk.size(), chunk.data());
+            offsets[firstTile + i] = currOffset;
+            currOffset += chunk.size();
+        }
+    }
+
+    ++currPart;
+}
+
+void EXRWriter::Close()
+{
+    Assert_(open);
+    if(currPart != parts.size())
+        throw Exception(L"Not all of the parts of " + filePath + L" were written");
+
+    file.Seek(offsetTablesStart);
+    for(uint64 i = 0; i < chunkOffsets.size(); ++i)
+        file.Write(chunkOffsets[i].size() * sizeof(uint64), chunkOffsets[i].data());
+
+    file.Close();
+    open = false;
+}
+
+}
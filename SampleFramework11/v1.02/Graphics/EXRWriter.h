@@ -0,0 +1,73 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\FileIO.h"
+
+namespace SampleFramework11
+{
+
+struct Float4;
+struct Half4;
+
+struct EXRPartDesc
+{
+    std::string Name;           // Only used for multi-part files
+    uint32 Width = 0;
+    uint32 Height = 0;
+    uint32 NumChannels = 3;     // RGB or RGBA
+};
+
+// Writes half-precision, ZIP-compressed, tiled OpenEXR files. Files with more than one part are
+// written as multi-part files, which lets every slice of a texture array go into a single file.
+// Parts are written one at a time and in order, with the tiles of each part being converted and
+// compressed on a pool of threads and then streamed out in batches. This means that the only
+// copy of the source data that ever exists is the batch of tiles currently being written.
+class EXRWriter
+{
+
+public:
+
+    static const uint32 TileSize = 64;
+
+    EXRWriter();
+    ~EXRWriter();
+
+    // Writes the headers, and reserves space for the chunk offset tables
+    void Open(const wchar* filePath, const EXRPartDesc* parts, uint64 numParts, uint64 numThreads);
+
+    // Writes out the texels of the next part. The row pitch is in bytes.
+    void WritePart(const Half4* texels, uint64 rowPitch);
+    void WritePart(const Float4* texels, uint64 rowPitch);
+
+    // Fills in the offset tables. Every part needs to have been written first.
+    void Close();
+
+private:
+
+    EXRWriter(const EXRWriter&);
+    EXRWriter& operator=(const EXRWriter&);
+
+    void WritePart(const void* texels, uint64 rowPitch, bool floatTexels);
+
+    File file;
+    std::wstring filePath;
+    std::vector<EXRPartDesc> parts;
+    std::vector<std::vector<uint64>> chunkOffsets;
+    uint64 offsetTablesStart = 0;
+    uint64 currOffset = 0;
+    uint64 currPart = 0;
+    uint64 numThreads = 1;
+    bool open = false;
+};
+
+}
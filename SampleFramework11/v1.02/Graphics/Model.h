@@ -189,6 +189,8 @@ public:
     std::vector<Mesh>& Meshes() { return meshes; }
     const std::vector<Mesh>& Meshes() const { return meshes; }
 
+    const std::wstring& FileDirectory() const { return fileDirectory; }
+
     // Serialization
     template<typename TSerializer>
     void Serialize(TSerializer& serializer, ID3D11Device* device, bool forceSRGB = false)
@@ -107,6 +107,75 @@ Float3 EvalSH9Cosine(const Float3& dir, const SH9Color& sh)
     return result;
 }
 
+// Loads up to 4 floats, padding the remaining lanes with zeros
+static __m128 LoadSamples(const float* src, uint64 count)
+{
+    if(count >= 4)
+        return _mm_loadu_ps(src);
+
+    Float4Align float padded[4] = { };
+    for(uint64 i = 0; i < count; ++i)
+        padded[i] = src[i];
+    return _mm_load_ps(padded);
+}
+
+void ProjectOntoSH4Color(const float* dirX, const float* dirY, const float* dirZ, const float* colorR,
+                         const float* colorG, const float* colorB, uint64 numSamples, SH4ColorAccumulator& sh)
+{
+    // Padded lanes have a color of 0, so they don't contribute anything
+    for(uint64 i = 0; i < numSamples; i += 4)
+    {
+        const uint64 count = numSamples - i;
+        const __m128 x = LoadSamples(dirX + i, count);
+        const __m128 y = LoadSamples(dirY + i, count);
+        const __m128 z = LoadSamples(dirZ + i, count);
+
+        __m128 basis[4];
+
+        // Band 0
+        basis[0] = _mm_set1_ps(0.282095f);
+
+        // Band 1
+        basis[1] = _mm_mul_ps(_mm_set1_ps(-0.488603f), y);
+        basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), z);
+        basis[3] = _mm_mul_ps(_mm_set1_ps(-0.488603f), x);
+
+        sh.Accumulate(basis, LoadSamples(colorR + i, count), LoadSamples(colorG + i, count), LoadSamples(colorB + i, count));
+    }
+}
+
+void ProjectOntoSH9Color(const float* dirX, const float* dirY, const float* dirZ, const float* colorR,
+                         const float* colorG, const float* colorB, uint64 numSamples, SH9ColorAccumulator& sh)
+{
+    // Padded lanes have a color of 0, so they don't contribute anything
+    for(uint64 i = 0; i < numSamples; i += 4)
+    {
+        const uint64 count = numSamples - i;
+        const __m128 x = LoadSamples(dirX + i, count);
+        const __m128 y = LoadSamples(dirY + i, count);
+        const __m128 z = LoadSamples(dirZ + i, count);
+
+        __m128 basis[9];
+
+        // Band 0
+        basis[0] = _mm_set1_ps(0.282095f);
+
+        // Band 1
+        basis[1] = _mm_mul_ps(_mm_set1_ps(-0.488603f), y);
+        basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), z);
+        basis[3] = _mm_mul_ps(_mm_set1_ps(-0.488603f), x);
+
+        // Band 2
+        basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(x, y));
+        basis[5] = _mm_mul_ps(_mm_set1_ps(-1.092548f), _mm_mul_ps(y, z));
+        basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(z, z)), _mm_set1_ps(1.0f)));
+        basis[7] = _mm_mul_ps(_mm_set1_ps(-1.092548f), _mm_mul_ps(x, z));
+        basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+        sh.Accumulate(basis, LoadSamples(colorR + i, count), LoadSamples(colorG + i, count), LoadSamples(colorB + i, count));
+    }
+}
+
 H4 ProjectOntoH4(const Float3& dir)
 {
     H4 result;
@@ -191,6 +191,89 @@ typedef SH<Float3, 4> H4Color;
 typedef SH<float, 6> H6;
 typedef SH<Float3, 6> H6Color;
 
+// SIMD accumulator for SH<Float3, N>. Samples are buffered in SoA form and projected 4 at a time,
+// with each SSE lane keeping its own partial sums until Resolve() adds them together.
+template<uint64 N> class SHColorAccumulator
+{
+
+public:
+
+    __m128 R[N];
+    __m128 G[N];
+    __m128 B[N];
+
+    SHColorAccumulator()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for(uint64 i = 0; i < N; ++i)
+            R[i] = G[i] = B[i] = _mm_setzero_ps();
+        NumPending = 0;
+    }
+
+    // Adds the projected contribution for a single set of basis values for 4 samples
+    void Accumulate(const __m128* basis, __m128 r, __m128 g, __m128 b)
+    {
+        for(uint64 i = 0; i < N; ++i)
+        {
+            R[i] = _mm_add_ps(R[i], _mm_mul_ps(basis[i], r));
+            G[i] = _mm_add_ps(G[i], _mm_mul_ps(basis[i], g));
+            B[i] = _mm_add_ps(B[i], _mm_mul_ps(basis[i], b));
+        }
+    }
+
+    void AddSample(const Float3& dir, const Float3& color)
+    {
+        PendingDirX[NumPending] = dir.x;
+        PendingDirY[NumPending] = dir.y;
+        PendingDirZ[NumPending] = dir.z;
+        PendingR[NumPending] = color.x;
+        PendingG[NumPending] = color.y;
+        PendingB[NumPending] = color.z;
+        if(++NumPending == 4)
+            Flush();
+    }
+
+    void Flush();
+
+    SH<Float3, N> Resolve()
+    {
+        Flush();
+
+        SH<Float3, N> result;
+        Float4Align float r[4];
+        Float4Align float g[4];
+        Float4Align float b[4];
+        for(uint64 i = 0; i < N; ++i)
+        {
+            _mm_store_ps(r, R[i]);
+            _mm_store_ps(g, G[i]);
+            _mm_store_ps(b, B[i]);
+            result.Coefficients[i] = Float3(r[0] + r[1] + r[2] + r[3],
+                                            g[0] + g[1] + g[2] + g[3],
+                                            b[0] + b[1] + b[2] + b[3]);
+        }
+
+        return result;
+    }
+
+private:
+
+    float PendingDirX[4];
+    float PendingDirY[4];
+    float PendingDirZ[4];
+    float PendingR[4];
+    float PendingG[4];
+    float PendingB[4];
+    uint64 NumPending = 0;
+};
+
+typedef SHColorAccumulator<4> SH4ColorAccumulator;
+typedef SHColorAccumulator<9> SH9ColorAccumulator;
+
 // For proper alignment with shader constant buffers
 struct ShaderSH9Color
 {
@@ -215,6 +298,30 @@ SH9 ProjectOntoSH9(const Float3& dir);
 SH9Color ProjectOntoSH9Color(const Float3& dir, const Float3& color);
 Float3 EvalSH9Cosine(const Float3& dir, const SH9Color& sh);
 
+// Batched projection of numSamples radiance samples, with the directions and colors passed in SoA form
+void ProjectOntoSH4Color(const float* dirX, const float* dirY, const float* dirZ, const float* colorR,
+                         const float* colorG, const float* colorB, uint64 numSamples, SH4ColorAccumulator& sh);
+void ProjectOntoSH9Color(const float* dirX, const float* dirY, const float* dirZ, const float* colorR,
+                         const float* colorG, const float* colorB, uint64 numSamples, SH9ColorAccumulator& sh);
+
+template<> inline void SHColorAccumulator<4>::Flush()
+{
+    if(NumPending == 0)
+        return;
+
+    ProjectOntoSH4Color(PendingDirX, PendingDirY, PendingDirZ, PendingR, PendingG, PendingB, NumPending, *this);
+    NumPending = 0;
+}
+
+template<> inline void SHColorAccumulator<9>::Flush()
+{
+    if(NumPending == 0)
+        return;
+
+    ProjectOntoSH9Color(PendingDirX, PendingDirY, PendingDirZ, PendingR, PendingG, PendingB, NumPending, *this);
+    NumPending = 0;
+}
+
 // H-basis functions
 H4 ProjectOntoH4(const Float3& dir);
 H4Color ProjectOntoH4Color(const Float3& dir, const Float3& color);
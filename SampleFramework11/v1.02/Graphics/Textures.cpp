@@ -17,7 +17,7 @@
 #include "..\\FileIO.h"
 #include "ShaderCompilation.h"
 #include "GraphicsTypes.h"
-#include "TinyEXR.h"
+#include "EXRWriter.h"
 
 namespace SampleFramework11
 {
@@ -196,6 +196,302 @@ void GetTextureData(ID3D11Device* device, ID3D11ShaderResourceView* textureSRV,
     GetTextureData(device, textureSRV, DXGI_FORMAT_R8G8B8A8_UNORM, textureData);
 }
 
+// == CPU DDS Decoding ============================================================================
+
+// Rows of 4x4 blocks (or rows of texels for uncompressed formats) handed out to a thread at once
+static const uint32 DDSDecodeRowsPerJob = 8;
+
+// Describes where the channels of an uncompressed 8-bit format live within a texel. An offset of
+// -1 means that the channel isn't stored, and reads as 0 for color or 1 for alpha like it does
+// when sampled on the GPU.
+struct DDSTexelLayout
+{
+    uint32 BytesPerTexel = 0;
+    int32 Offsets[4];
+};
+
+static bool GetDDSTexelLayout(DXGI_FORMAT format, DDSTexelLayout& layout)
+{
+    layout.Offsets[0] = layout.Offsets[1] = layout.Offsets[2] = layout.Offsets[3] = -1;
+
+    switch(format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        layout.BytesPerTexel = 4;
+        layout.Offsets[0] = 0;
+        layout.Offsets[1] = 1;
+        layout.Offsets[2] = 2;
+        layout.Offsets[3] = 3;
+        return true;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        layout.BytesPerTexel = 4;
+        layout.Offsets[0] = 2;
+        layout.Offsets[1] = 1;
+        layout.Offsets[2] = 0;
+        layout.Offsets[3] = 3;
+        return true;
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        layout.BytesPerTexel = 4;
+        layout.Offsets[0] = 2;
+        layout.Offsets[1] = 1;
+        layout.Offsets[2] = 0;
+        return true;
+    case DXGI_FORMAT_R8G8_UNORM:
+        layout.BytesPerTexel = 2;
+        layout.Offsets[0] = 0;
+        layout.Offsets[1] = 1;
+        return true;
+    case DXGI_FORMAT_R8_UNORM:
+        layout.BytesPerTexel = 1;
+        layout.Offsets[0] = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool IsDecodableBCFormat(DXGI_FORMAT format)
+{
+    switch(format)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The top mip of a single slice of a DDS file, along with where its texels end up
+struct DDSDecodeSlice
+{
+    const Image* SrcImage = nullptr;
+    UByte4N* DstTexels = nullptr;
+    uint64 TextureIdx = 0;
+    DDSTexelLayout Layout;
+    bool Compressed = false;
+    bool ConvertToLinear = false;
+};
+
+struct DDSDecodeJob
+{
+    uint64 SliceIdx = 0;
+    uint32 StartRow = 0;
+    uint32 NumRows = 0;
+};
+
+struct DDSDecodeContext
+{
+    std::vector<DDSDecodeSlice> Slices;
+    std::vector<DDSDecodeJob> Jobs;
+    std::vector<int64> FailedJobs;
+    uint8 SRGBToLinear[256];
+    volatile int64 CurrJob = 0;
+};
+
+static void StoreDecodedTexel(const DDSDecodeContext& context, const DDSDecodeSlice& slice,
+                              const uint8* rgba, UByte4N& dst)
+{
+    uint32 r = rgba[0];
+    uint32 g = rgba[1];
+    uint32 b = rgba[2];
+    if(slice.ConvertToLinear)
+    {
+        r = context.SRGBToLinear[r];
+        g = context.SRGBToLinear[g];
+        b = context.SRGBToLinear[b];
+    }
+
+    dst.Bits = r | (g << 8) | (b << 16) | (uint32(rgba[3]) << 24);
+}
+
+static bool DecodeDDSRows(const DDSDecodeContext& context, const DDSDecodeJob& job)
+{
+    const DDSDecodeSlice& slice = context.Slices[job.SliceIdx];
+    const Image& srcImage = *slice.SrcImage;
+    const uint32 width = uint32(srcImage.width);
+    const uint32 height = uint32(srcImage.height);
+
+    if(slice.Compressed)
+    {
+        // Decompress just this job's rows of blocks, by pointing an image at them
+        const uint32 startY = job.StartRow * 4;
+        const uint32 endY = std::min(startY + job.NumRows * 4, height);
+
+        Image rows = srcImage;
+        rows.height = endY - startY;
+        rows.slicePitch = srcImage.rowPitch * job.NumRows;
+        rows.pixels = srcImage.pixels + job.StartRow * srcImage.rowPitch;
+
+        // Keep the decoded values in sRGB space, the conversion to linear happens below
+        const DXGI_FORMAT decodeFormat = IsSRGB(srcImage.format) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+                                                                  : DXGI_FORMAT_R8G8B8A8_UNORM;
+        ScratchImage decoded;
+        if(FAILED(Decompress(rows, decodeFormat, decoded)))
+            return false;
+
+        const Image& decodedImage = *decoded.GetImage(0, 0, 0);
+        for(uint32 y = startY; y < endY; ++y)
+        {
+            const uint8* srcRow = decodedImage.pixels + (y - startY) * decodedImage.rowPitch;
+            UByte4N* dstRow = slice.DstTexels + uint64(y) * width;
+            for(uint32 x = 0; x < width; ++x)
+                StoreDecodedTexel(context, slice, srcRow + x * 4, dstRow[x]);
+        }
+    }
+    else
+    {
+        const DDSTexelLayout& layout = slice.Layout;
+        const uint32 endY = std::min(job.StartRow + job.NumRows, height);
+        for(uint32 y = job.StartRow; y < endY; ++y)
+        {
+            const uint8* srcRow = srcImage.pixels + y * srcImage.rowPitch;
+            UByte4N* dstRow = slice.DstTexels + uint64(y) * width;
+            for(uint32 x = 0; x < width; ++x)
+            {
+                const uint8* srcTexel = srcRow + x * layout.BytesPerTexel;
+                uint8 rgba[4] = { 0, 0, 0, 255 };
+                for(uint32 c = 0; c < 4; ++c)
+                    if(layout.Offsets[c] >= 0)
+                        rgba[c] = srcTexel[layout.Offsets[c]];
+
+                StoreDecodedTexel(context, slice, rgba, dstRow[x]);
+            }
+        }
+    }
+
+    return true;
+}
+
+static uint32 __stdcall DDSDecodeThread(void* data)
+{
+    DDSDecodeContext* context = reinterpret_cast<DDSDecodeContext*>(data);
+    const int64 numJobs = int64(context->Jobs.size());
+
+    while(true)
+    {
+        const int64 jobIdx = InterlockedIncrement64(&context->CurrJob) - 1;
+        if(jobIdx >= numJobs)
+            break;
+
+        const DDSDecodeJob& job = context->Jobs[jobIdx];
+        if(DecodeDDSRows(*context, job) == false)
+            InterlockedIncrement64(&context->FailedJobs[context->Slices[job.SliceIdx].TextureIdx]);
+    }
+
+    return 0;
+}
+
+// Decodes the top mip of a batch of DDS files on the CPU, without going through DecodeTextureCS
+void DecodeDDSTextures(DDSTextureDecode* textures, uint64 numTextures, uint64 numThreads)
+{
+    if(numTextures == 0)
+        return;
+
+    DDSDecodeContext context;
+    context.FailedJobs.resize(numTextures, 0);
+
+    // Matches what the hardware does when sampling an sRGB texture into a UNORM target
+    for(uint32 i = 0; i < 256; ++i)
+    {
+        const float linear = SRGBToLinear(Float3(i / 255.0f)).x;
+        context.SRGBToLinear[i] = uint8(Saturate(linear) * 255.0f + 0.5f);
+    }
+
+    // Load the files up front, and split every slice into jobs
+    std::vector<ScratchImage> images(numTextures);
+    for(uint64 texIdx = 0; texIdx < numTextures; ++texIdx)
+    {
+        DDSTextureDecode& texture = textures[texIdx];
+        texture.Decoded = false;
+        Assert_(texture.Output != nullptr);
+
+        TexMetadata metadata;
+        if(FAILED(LoadFromDDSFile(texture.FilePath.c_str(), DDS_FLAGS_NONE, &metadata, images[texIdx])))
+            continue;
+
+        if(metadata.dimension != TEX_DIMENSION_TEXTURE2D)
+            continue;
+
+        DDSDecodeSlice slice;
+        slice.TextureIdx = texIdx;
+        slice.Compressed = IsCompressed(metadata.format);
+        if(slice.Compressed ? IsDecodableBCFormat(metadata.format) == false
+                            : GetDDSTexelLayout(metadata.format, slice.Layout) == false)
+            continue;
+
+        // The DDS loader switches to the sRGB variant of the format when asked to
+        slice.ConvertToLinear = IsSRGB(metadata.format) ||
+                                (texture.ForceSRGB && MakeSRGB(metadata.format) != metadata.format);
+
+        const uint32 width = uint32(metadata.width);
+        const uint32 height = uint32(metadata.height);
+        const uint32 numSlices = uint32(metadata.arraySize);
+        texture.Output->Init(width, height, numSlices);
+
+        const uint32 numRows = slice.Compressed ? (height + 3) / 4 : height;
+        for(uint32 sliceIdx = 0; sliceIdx < numSlices; ++sliceIdx)
+        {
+            slice.SrcImage = images[texIdx].GetImage(0, sliceIdx, 0);
+            slice.DstTexels = texture.Output->Texels.data() + uint64(width) * height * sliceIdx;
+
+            for(uint32 startRow = 0; startRow < numRows; startRow += DDSDecodeRowsPerJob)
+            {
+                DDSDecodeJob job;
+                job.SliceIdx = context.Slices.size();
+                job.StartRow = startRow;
+                job.NumRows = std::min(DDSDecodeRowsPerJob, numRows - startRow);
+                context.Jobs.push_back(job);
+            }
+
+            context.Slices.push_back(slice);
+        }
+
+        texture.Decoded = true;
+    }
+
+    if(context.Jobs.size() > 0)
+    {
+        numThreads = Clamp<uint64>(numThreads, 1, context.Jobs.size());
+        std::vector<HANDLE> threads(numThreads);
+        for(uint64 i = 0; i < numThreads; ++i)
+        {
+            threads[i] = HANDLE(_beginthreadex(nullptr, 0, DDSDecodeThread, &context, 0, nullptr));
+            if(threads[i] == 0)
+            {
+                AssertFail_("Failed to create thread for texture decoding");
+                throw Exception(L"Failed to create thread for texture decoding");
+            }
+        }
+
+        for(uint64 i = 0; i < numThreads; ++i)
+        {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+
+    for(uint64 texIdx = 0; texIdx < numTextures; ++texIdx)
+    {
+        if(context.FailedJobs[texIdx] > 0)
+        {
+            textures[texIdx].Decoded = false;
+            *textures[texIdx].Output = TextureData<UByte4N>();
+        }
+    }
+}
+
 template<typename T>
 static ID3D11ShaderResourceViewPtr CreateSRVFromTextureData(ID3D11Device* device, const TextureData<T>& textureData)
 {
@@ -295,41 +591,26 @@ void SaveTextureAsEXR(const TextureData<Float4>& texture, const wchar* filePath)
 {
     Assert_(texture.Texels.size() > 0);
     Assert_(texture.Width > 0 && texture.Height > 0);
-    Assert_(texture.NumSlices == 1);
-
-    const uint64 numTexels = texture.Texels.size();
-    std::vector<float> channelDataR;
-    std::vector<float> channelDataG;
-    std::vector<float> channelDataB;
-    channelDataR.resize(numTexels);
-    channelDataG.resize(numTexels);
-    channelDataB.resize(numTexels);
-    for(uint64 i = 0; i < numTexels; ++i)
+
+    // Array slices each get their own part in the file
+    const uint64 numSlices = std::max<uint64>(texture.NumSlices, 1);
+    std::vector<EXRPartDesc> parts(numSlices);
+    for(uint64 i = 0; i < numSlices; ++i)
     {
-        channelDataR[i] = texture.Texels[i].x;
-        channelDataG[i] = texture.Texels[i].y;
-        channelDataB[i] = texture.Texels[i].z;
+        parts[i].Name = "Slice" + ToAnsiString(i);
+        parts[i].Width = texture.Width;
+        parts[i].Height = texture.Height;
+        parts[i].NumChannels = 3;
     }
 
-    float* imageChannels[3] = { channelDataB.data(), channelDataG.data(), channelDataR.data() };
-    const char* channelNames[3] = { "B", "G", "R" };
-
-    EXRImage exrImage;
-    exrImage.num_channels = 3;
-    exrImage.width = texture.Width;
-    exrImage.height = texture.Height;
-    exrImage.channel_names = channelNames;
-    exrImage.images = imageChannels;
+    EXRWriter writer;
+    writer.Open(filePath, parts.data(), numSlices, 0);
 
-    std::string filePathAnsi = WStringToAnsi(filePath);
+    const uint64 sliceSize = uint64(texture.Width) * texture.Height;
+    for(uint64 i = 0; i < numSlices; ++i)
+        writer.WritePart(texture.Texels.data() + i * sliceSize, texture.Width * sizeof(Float4));
 
-    const char* errorString = nullptr;
-    int returnCode = SaveMultiChannelEXR(&exrImage, filePathAnsi.c_str(), &errorString);
-    if(returnCode != 0)
-    {
-        AssertFail_("%s", errorString);
-        throw Exception(AnsiToWString(errorString));
-    }
+    writer.Close();
 }
 
 void SaveTextureAsPNG(ID3D11ShaderResourceView* srv, const wchar* filePath)
@@ -59,6 +59,21 @@ void GetTextureData(ID3D11Device* device, ID3D11ShaderResourceView* textureSRV,
 void GetTextureData(ID3D11Device* device, ID3D11ShaderResourceView* textureSRV,
                     TextureData<Float4>& textureData);
 
+// A DDS file to be decoded on the CPU by DecodeDDSTextures
+struct DDSTextureDecode
+{
+    std::wstring FilePath;
+    bool ForceSRGB = false;
+    TextureData<UByte4N>* Output = nullptr;
+    bool Decoded = false;
+};
+
+// Decodes the top mip of a batch of DDS files on the CPU, spreading rows of blocks from all of
+// the files across the given number of threads. The output matches what GetTextureData returns
+// for the same file loaded with LoadTexture. Files that can't be loaded or that use a format
+// without a CPU decoder are left with Decoded set to false.
+void DecodeDDSTextures(DDSTextureDecode* textures, uint64 numTextures, uint64 numThreads);
+
 ID3D11ShaderResourceViewPtr CreateSRVFromTextureData(ID3D11Device* device,
                                                      const TextureData<UByte4N>& textureData);
 
@@ -17,56 +17,155 @@
 namespace SampleFramework11
 {
 
+// Reads from a block of memory, such as the contents of a memory-mapped file
+class MemoryReadSerializer
+{
+
+private:
+
+    const uint8* data = nullptr;
+    uint64 size = 0;
+    uint64 offset = 0;
+
+public:
+
+    MemoryReadSerializer(const void* data_, uint64 size_) : data(reinterpret_cast<const uint8*>(data_)), size(size_)
+    {
+    }
+
+    template<typename T> void SerializeItem(T& item)
+    {
+        SerializeData(sizeof(T), &item);
+    }
+
+    void SerializeData(uint64 numBytes, void* dst)
+    {
+        if(numBytes > size - offset)
+            throw Exception(L"Tried to read past the end of the serialized data");
+
+        memcpy(dst, data + offset, numBytes);
+        offset += numBytes;
+    }
+
+    uint64 Offset() const { return offset; }
+    uint64 Size() const { return size; }
+
+    void Seek(uint64 newOffset)
+    {
+        if(newOffset > size)
+            throw Exception(L"Tried to seek past the end of the serialized data");
+        offset = newOffset;
+    }
+
+    static bool IsReadSerializer() { return true; }
+    static bool IsWriteSerializer() { return false; }
+};
+
+// Reads through a memory-mapped view of the file, so that reading an item is a copy out of the
+// mapping instead of a call to ReadFile
 class FileReadSerializer
 {
 
 private:
 
-    File file;
+    MemoryMappedFile file;
+    MemoryReadSerializer reader;
 
 public:
 
-    explicit FileReadSerializer(const wchar* path)
+    explicit FileReadSerializer(const wchar* path) : file(path), reader(file.Data(), file.Size())
     {
-        file.Open(path, FileOpenMode::Read);
     }
 
     template<typename T> void SerializeItem(T& data)
     {
-        file.Read(data);
+        reader.SerializeItem(data);
     }
 
     void SerializeData(uint64 size, void* data)
     {
-        file.Read(size, data);
+        reader.SerializeData(size, data);
     }
 
+    uint64 Offset() const { return reader.Offset(); }
+    uint64 Size() const { return reader.Size(); }
+    void Seek(uint64 newOffset) { reader.Seek(newOffset); }
+
     static bool IsReadSerializer() { return true; }
     static bool IsWriteSerializer() { return false; }
 };
 
+// Collects writes into a large buffer, so that the file only gets written in big blocks. Close()
+// needs to be called to find out whether everything made it to the file, since the destructor has
+// no way of reporting a failed write.
 class FileWriteSerializer
 {
 
 private:
 
+    static const uint64 BufferSize = 1024 * 1024;
+
     File file;
+    std::vector<uint8> buffer;
+    uint64 bufferedBytes = 0;
+
+    FileWriteSerializer(const FileWriteSerializer&);
+    FileWriteSerializer& operator=(const FileWriteSerializer&);
 
 public:
 
     explicit FileWriteSerializer(const wchar* path)
     {
         file.Open(path, FileOpenMode::Write);
+        buffer.resize(BufferSize);
+    }
+
+    ~FileWriteSerializer()
+    {
+        try
+        {
+            Close();
+        }
+        catch(Exception e)
+        {
+        }
     }
 
     template<typename T> void SerializeItem(const T& data)
     {
-        file.Write(data);
+        SerializeData(sizeof(T), &data);
     }
 
     void SerializeData(uint64 size, const void* data)
     {
-        file.Write(size, data);
+        if(bufferedBytes + size > BufferSize)
+            Flush();
+
+        // Large blocks skip the buffer
+        if(size >= BufferSize)
+        {
+            file.Write(size, data);
+            return;
+        }
+
+        memcpy(buffer.data() + bufferedBytes, data, size);
+        bufferedBytes += size;
+    }
+
+    void Flush()
+    {
+        if(bufferedBytes == 0)
+            return;
+
+        file.Write(bufferedBytes, buffer.data());
+        bufferedBytes = 0;
+    }
+
+    // Writes out whatever is still buffered, and closes the file
+    void Close()
+    {
+        Flush();
+        file.Close();
     }
 
     static bool IsReadSerializer() { return false; }
@@ -98,6 +197,49 @@ public:
     uint64 Size() const { return numBytes; }
 };
 
+// Appends everything that gets serialized to a byte array
+class ByteArraySerializer
+{
+
+public:
+
+    std::vector<uint8> Bytes;
+
+    template<typename T> void SerializeItem(const T& data)
+    {
+        SerializeData(sizeof(T), &data);
+    }
+
+    void SerializeData(uint64 size, const void* data)
+    {
+        const uint8* bytes = reinterpret_cast<const uint8*>(data);
+        Bytes.insert(Bytes.end(), bytes, bytes + size);
+    }
+
+    static bool IsReadSerializer() { return false; }
+    static bool IsWriteSerializer() { return true; }
+};
+
+// Element counts come straight out of the data, so the read serializers check them against the
+// number of bytes that are left before anything gets allocated. Dividing instead of multiplying
+// keeps a corrupt count from overflowing. The other serializers have nothing to check.
+template<typename TSerializer>
+void CheckArrayCount(TSerializer& serializer, uint64 numElements, uint64 minElementSize)
+{
+}
+
+inline void CheckArrayCount(MemoryReadSerializer& serializer, uint64 numElements, uint64 minElementSize)
+{
+    if(numElements > (serializer.Size() - serializer.Offset()) / minElementSize)
+        throw Exception(L"Serialized data has an invalid element count");
+}
+
+inline void CheckArrayCount(FileReadSerializer& serializer, uint64 numElements, uint64 minElementSize)
+{
+    if(numElements > (serializer.Size() - serializer.Offset()) / minElementSize)
+        throw Exception(L"Serialized data has an invalid element count");
+}
+
 
 // Forward declares
 template<typename TSerializer, typename TString>
@@ -202,8 +344,10 @@ void SerializeRawArray(TSerializer& serializer, TValue* array, uint64 numElement
 template<typename TSerializer, typename TVector>
 void SerializeItem(TSerializer& serializer, std::vector<TVector>& vec)
 {
+    // Elements can serialize themselves into any number of bytes, but never less than one
     uint64 numElements = vec.size();
     SerializeItem(serializer, numElements);
+    CheckArrayCount(serializer, numElements, 1);
     if(vec.size() != numElements)
         vec.resize(numElements);
 
@@ -218,6 +362,7 @@ void SerializeRawVector(TSerializer& serializer, std::vector<TVector>& vec)
 {
     uint64 numElements = vec.size();
     SerializeItem(serializer, numElements);
+    CheckArrayCount(serializer, numElements, sizeof(TVector));
     if(vec.size() != numElements)
         vec.resize(numElements);
 
@@ -232,6 +377,7 @@ void SerializeItem(TSerializer& serializer, std::basic_string<TString>& str)
 {
     uint64 numChars = str.length();
     SerializeItem(serializer, numChars);
+    CheckArrayCount(serializer, numChars, sizeof(TString));
     if(str.length() != numChars)
         str.resize(numChars);
 
@@ -254,6 +400,7 @@ void SerializeToFile(const wchar* filePath, const T& item)
 {
     FileWriteSerializer serializer(filePath);
     SerializeItem(serializer, item);
+    serializer.Close();
 }
 
 }
\ No newline at end of file
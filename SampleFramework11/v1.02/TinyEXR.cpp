@@ -7537,6 +7537,18 @@ int SaveEXR(const float *in_rgba, int width, int height, const char *filename,
 }
 #endif
 
+unsigned long long CompressEXRZip(unsigned char *dst,
+                                  const unsigned char *src,
+                                  unsigned long srcSize) {
+  unsigned long long compressedSize = 0;
+  CompressZip(dst, compressedSize, src, srcSize);
+  return compressedSize;
+}
+
+unsigned long long CompressBoundEXRZip(unsigned long srcSize) {
+  return miniz::mz_compressBound(srcSize);
+}
+
 int SaveMultiChannelEXR(const EXRImage *exrImage, const char *filename,
                         const char **err) {
   if (exrImage == NULL || filename == NULL) {
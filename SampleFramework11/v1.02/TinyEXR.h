@@ -77,6 +77,16 @@ extern int LoadMultiChannelEXR(EXRImage *image, const char *filename,
 extern int SaveMultiChannelEXR(const EXRImage *image, const char *filename,
                                const char **err);
 
+// Compresses a block of pixel data with the reordering, predictor and deflate
+// steps used by ZIP compression, so that it can be stored as a chunk.
+// `dst` must have room for `CompressBoundEXRZip(srcSize)` bytes.
+// Can be called from multiple threads at once.
+// Returns the compressed size
+extern unsigned long long CompressEXRZip(unsigned char *dst,
+                                         const unsigned char *src,
+                                         unsigned long srcSize);
+extern unsigned long long CompressBoundEXRZip(unsigned long srcSize);
+
 // Loads single-frame OpenEXR deep image.
 // Application must free memory of variables in DeepImage(image, offset_table)
 // Return 0 if success